@@ -0,0 +1,573 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterAISoakBenchmark.h"
+#include "ShooterNPC.h"
+#include "ShooterNPCPool.h"
+#include "MultiplayerGameMode.h"
+#include "GameFramework/DefaultPawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerStart.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Dom/JsonObject.h"
+#include "Dom/JsonValue.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+#include "ShooterStatsCollector.h"
+
+/** Report names of the timed systems */
+static const TCHAR* const ShooterAISoakSystemNames[ShooterAISoakNumSystems] =
+{
+	TEXT("StateTree"),
+	TEXT("Perception"),
+	TEXT("CharacterMovement"),
+	TEXT("SceneQueries"),
+	TEXT("Projectiles")
+};
+
+#if STATS
+
+/** Stats summed into each system, as inclusive times. A system can sum several stats, as long as they don't nest */
+static TArray<FShooterStatsCollector::FSystemStat> MakeShooterAISoakSystemStats()
+{
+	return {
+		{ 0, FName(TEXT("STAT_StateTree_Tick")) },
+		{ 1, FName(TEXT("STAT_AI_PerceptionSys")) },
+		{ 2, FName(TEXT("STAT_CharacterMovement")) },
+		{ 3, FName(TEXT("STAT_Collision_SceneQueryTotal")) },
+		{ 4, FName(TEXT("STAT_ShooterProjectileSimulation")) },
+		{ 4, FName(TEXT("STAT_ShooterHitscanBatch")) }
+	};
+}
+
+#endif
+
+static FAutoConsoleCommandWithWorldAndArgs ShooterAISoakStartCommand(
+	TEXT("Shooter.AISoak.Start"),
+	TEXT("Starts the AI soak benchmark. Optional args: comma separated NPC counts, seconds recorded per step, number of targets"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UShooterAISoakBenchmarkSubsystem* Benchmark = World ? World->GetSubsystem<UShooterAISoakBenchmarkSubsystem>() : nullptr)
+		{
+			FShooterAISoakSettings SoakSettings;
+
+			if (Args.Num() > 0)
+			{
+				TArray<FString> Steps;
+				Args[0].ParseIntoArray(Steps, TEXT(","));
+
+				SoakSettings.Steps.Reset();
+
+				for (const FString& Step : Steps)
+				{
+					SoakSettings.Steps.Add(FCString::Atoi(*Step));
+				}
+			}
+
+			SoakSettings.Duration = Args.Num() > 1 ? FCString::Atof(*Args[1]) : SoakSettings.Duration;
+			SoakSettings.NumTargets = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : SoakSettings.NumTargets;
+
+			Benchmark->StartBenchmark(SoakSettings);
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorld ShooterAISoakStopCommand(
+	TEXT("Shooter.AISoak.Stop"),
+	TEXT("Stops the AI soak benchmark and writes the report for the finished steps"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UShooterAISoakBenchmarkSubsystem* Benchmark = World ? World->GetSubsystem<UShooterAISoakBenchmarkSubsystem>() : nullptr)
+		{
+			Benchmark->StopBenchmark();
+		}
+	})
+);
+
+FShooterAISoakSettings FShooterAISoakSettings::FromCommandLine()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	FShooterAISoakSettings SoakSettings;
+
+	FString Steps;
+
+	if (FParse::Value(CommandLine, TEXT("AISoakSteps="), Steps, false))
+	{
+		TArray<FString> StepStrings;
+		Steps.ParseIntoArray(StepStrings, TEXT(","));
+
+		SoakSettings.Steps.Reset();
+
+		for (const FString& Step : StepStrings)
+		{
+			SoakSettings.Steps.Add(FCString::Atoi(*Step));
+		}
+	}
+
+	FParse::Value(CommandLine, TEXT("AISoakWarmup="), SoakSettings.WarmupTime);
+	FParse::Value(CommandLine, TEXT("AISoakDuration="), SoakSettings.Duration);
+	FParse::Value(CommandLine, TEXT("AISoakTargets="), SoakSettings.NumTargets);
+	FParse::Value(CommandLine, TEXT("AISoakTargetTag="), SoakSettings.TargetTag);
+	FParse::Value(CommandLine, TEXT("AISoakTargetRadius="), SoakSettings.TargetRadius);
+	FParse::Value(CommandLine, TEXT("AISoakSpawnRadius="), SoakSettings.SpawnRadius);
+	FParse::Value(CommandLine, TEXT("AISoakNPC="), SoakSettings.NPCClassPath);
+	SoakSettings.bExitWhenDone = true;
+
+	return SoakSettings;
+}
+
+void UShooterAISoakBenchmarkSubsystem::StartBenchmark(const FShooterAISoakSettings& InSettings)
+{
+	if (bRunning)
+	{
+		StopBenchmark();
+	}
+
+	// NPCs are only spawned by the server
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogFPS251106, Warning, TEXT("ShooterAISoakBenchmark: can't run on a client"));
+		return;
+	}
+
+	Settings = InSettings;
+	Settings.Steps.RemoveAll([](int32 Step) { return Step < 0; });
+	Settings.Duration = FMath::Max(Settings.Duration, 1.0f);
+	Settings.WarmupTime = FMath::Max(Settings.WarmupTime, 0.0f);
+
+	NPCClass = ResolveNPCClass();
+
+	if (!NPCClass || Settings.Steps.Num() == 0)
+	{
+		UE_LOG(LogFPS251106, Error, TEXT("ShooterAISoakBenchmark: no NPC class or no steps to run"));
+
+		if (Settings.bExitWhenDone)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+
+		return;
+	}
+
+	bRunning = true;
+	bPendingStart = false;
+	RunTime = 0.0f;
+	StepReports.Reset();
+
+#if STATS
+	// collect stats without drawing them. The collector lives on until the stats thread lets go of it
+	StatsPrimaryEnableAdd();
+
+	StatsCollector = MakeShared<FShooterStatsCollector, ESPMode::ThreadSafe>(ShooterAISoakNumSystems, MakeShooterAISoakSystemStats());
+	StatsCollector->Start();
+#endif
+
+	// center the targets and NPCs on the first player start
+	TActorIterator<APlayerStart> It(GetWorld());
+
+	if (It)
+	{
+		Center = It->GetActorLocation();
+
+	} else {
+
+		Center = FVector::ZeroVector;
+
+	}
+
+	RemoveLocalPawn();
+	SpawnTargets();
+
+	UE_LOG(LogFPS251106, Log, TEXT("ShooterAISoakBenchmark: running %d steps of %s against %d targets"), Settings.Steps.Num(), *GetNameSafe(NPCClass), Targets.Num());
+
+	BeginStep(0);
+}
+
+void UShooterAISoakBenchmarkSubsystem::StopBenchmark()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bRunning = false;
+
+#if STATS
+	StatsCollector->Stop();
+	StatsCollector.Reset();
+
+	StatsPrimaryEnableSubtract();
+#endif
+
+	WriteReport();
+
+	// put the NPCs back in the pool and remove the targets
+	SetNumNPCs(0);
+
+	for (const TWeakObjectPtr<APawn>& Target : Targets)
+	{
+		if (Target.IsValid())
+		{
+			Target->Destroy();
+		}
+	}
+
+	Targets.Reset();
+	StepReports.Reset();
+
+	if (Settings.bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void UShooterAISoakBenchmarkSubsystem::Deinitialize()
+{
+	// write whatever we have if the world goes away mid run
+	if (bRunning)
+	{
+		Settings.bExitWhenDone = false;
+		StopBenchmark();
+	}
+
+	Super::Deinitialize();
+}
+
+void UShooterAISoakBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// only runs started from the command line are handled here. The player is spawned after this, so start on the first tick
+	bPendingStart = FParse::Param(FCommandLine::Get(), TEXT("ShooterAISoak")) && InWorld.GetNetMode() != NM_Client;
+}
+
+void UShooterAISoakBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (bPendingStart)
+	{
+		bPendingStart = false;
+		StartBenchmark(FShooterAISoakSettings::FromCommandLine());
+		return;
+	}
+
+	if (!bRunning)
+	{
+		return;
+	}
+
+	RunTime += DeltaTime;
+	StepTime += DeltaTime;
+
+	MoveTargets();
+
+	if (StepTime <= Settings.WarmupTime)
+	{
+#if STATS
+		// drop the times recorded while the step settles
+		double WarmupSums[ShooterAISoakNumSystems] = {};
+		int32 WarmupFrames = 0;
+		StatsCollector->Drain(WarmupSums, WarmupFrames);
+#endif
+
+		return;
+	}
+
+	RecordFrame(DeltaTime);
+
+	if (StepTime >= Settings.WarmupTime + Settings.Duration)
+	{
+		FinishStep();
+		BeginStep(StepIndex + 1);
+	}
+}
+
+TStatId UShooterAISoakBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterAISoakBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterAISoakBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TSubclassOf<AShooterNPC> UShooterAISoakBenchmarkSubsystem::ResolveNPCClass() const
+{
+	if (!Settings.NPCClassPath.IsEmpty())
+	{
+		return LoadClass<AShooterNPC>(nullptr, *Settings.NPCClassPath);
+	}
+
+	const AMultiplayerGameMode* GM = Cast<AMultiplayerGameMode>(GetWorld()->GetAuthGameMode());
+
+	return GM ? GM->GetNPCClass() : nullptr;
+}
+
+void UShooterAISoakBenchmarkSubsystem::RemoveLocalPawn()
+{
+	APlayerController* PC = GetWorld()->GetFirstPlayerController();
+	APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+
+	if (!Pawn)
+	{
+		return;
+	}
+
+	// without player pawns every NPC stays at the high significance tier, which is the worst case we want to measure
+	PC->UnPossess();
+	Pawn->Destroy();
+}
+
+void UShooterAISoakBenchmarkSubsystem::SpawnTargets()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	for (int32 i = 0; i < Settings.NumTargets; ++i)
+	{
+		const FVector Location = Center + FVector(Settings.TargetRadius, 0.0f, 0.0f).RotateAngleAxis(360.0f * i / Settings.NumTargets, FVector::UpVector);
+
+		if (ADefaultPawn* Target = GetWorld()->SpawnActor<ADefaultPawn>(ADefaultPawn::StaticClass(), Location, FRotator::ZeroRotator, SpawnParams))
+		{
+			// the NPCs sense their targets by tag. Damage is ignored by the default pawn, so the targets never die
+			Target->Tags.Add(Settings.TargetTag);
+			Targets.Add(Target);
+		}
+	}
+}
+
+void UShooterAISoakBenchmarkSubsystem::MoveTargets()
+{
+	// walk the targets around the circle, so the NPCs keep chasing and turning
+	static constexpr float AngularSpeed = 15.0f;
+
+	for (int32 i = 0; i < Targets.Num(); ++i)
+	{
+		APawn* Target = Targets[i].Get();
+
+		if (!Target)
+		{
+			continue;
+		}
+
+		const float Angle = 360.0f * i / Targets.Num() + RunTime * AngularSpeed;
+		const FVector Offset = FVector(Settings.TargetRadius, 0.0f, 0.0f).RotateAngleAxis(Angle, FVector::UpVector);
+
+		Target->SetActorLocationAndRotation(FVector(Center.X + Offset.X, Center.Y + Offset.Y, Target->GetActorLocation().Z), FRotator(0.0f, Angle + 90.0f, 0.0f));
+	}
+}
+
+void UShooterAISoakBenchmarkSubsystem::SetNumNPCs(int32 NumNPCs)
+{
+	UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>();
+
+	SoakNPCs.RemoveAll([](const TWeakObjectPtr<AShooterNPC>& NPC) { return !NPC.IsValid(); });
+
+	// release the newest NPCs first
+	while (SoakNPCs.Num() > NumNPCs)
+	{
+		AShooterNPC* NPC = SoakNPCs.Pop(EAllowShrinking::No).Get();
+
+		if (Pool)
+		{
+			Pool->ReleaseNPC(NPC);
+
+		} else {
+
+			NPC->Destroy();
+
+		}
+	}
+
+	if (!Pool || !NPCClass)
+	{
+		return;
+	}
+
+	const float HalfHeight = NPCClass->GetDefaultObject<AShooterNPC>()->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+	while (SoakNPCs.Num() < NumNPCs)
+	{
+		const FVector Location = GetSpawnLocation(SoakNPCs.Num(), HalfHeight);
+		const FRotator Rotation = (Center - Location).GetSafeNormal2D().Rotation();
+
+		AShooterNPC* NPC = Pool->AcquireNPC(NPCClass, FTransform(Rotation, Location));
+
+		if (!NPC)
+		{
+			UE_LOG(LogFPS251106, Warning, TEXT("ShooterAISoakBenchmark: could only spawn %d of %d NPCs"), SoakNPCs.Num(), NumNPCs);
+			break;
+		}
+
+		SoakNPCs.Add(NPC);
+	}
+}
+
+FVector UShooterAISoakBenchmarkSubsystem::GetSpawnLocation(int32 Index, float HalfHeight) const
+{
+	// spread the NPCs over a few staggered rings, so they don't overlap each other
+	static constexpr int32 NPCsPerRing = 40;
+	static constexpr float RingSpacing = 250.0f;
+
+	const int32 Ring = Index / NPCsPerRing;
+	const float Angle = 360.0f * (Index % NPCsPerRing) / NPCsPerRing + Ring * 4.5f;
+
+	const FVector Location = Center + FVector(Settings.SpawnRadius + Ring * RingSpacing, 0.0f, 0.0f).RotateAngleAxis(Angle, FVector::UpVector);
+
+	// drop it on the ground, ignoring pawns
+	FHitResult Hit;
+
+	if (GetWorld()->LineTraceSingleByObjectType(Hit, Location + FVector(0.0f, 0.0f, 1000.0f), Location - FVector(0.0f, 0.0f, 10000.0f), FCollisionObjectQueryParams(ECC_WorldStatic)))
+	{
+		return Hit.ImpactPoint + FVector(0.0f, 0.0f, HalfHeight + 5.0f);
+	}
+
+	return Location;
+}
+
+void UShooterAISoakBenchmarkSubsystem::BeginStep(int32 Index)
+{
+	if (!Settings.Steps.IsValidIndex(Index))
+	{
+		StopBenchmark();
+		return;
+	}
+
+	StepIndex = Index;
+	StepTime = 0.0f;
+
+	FrameTimes.Reset();
+	GameThreadTimes.Reset();
+	NumStatsFrames = 0;
+
+	for (double& Sum : SystemTimeSums)
+	{
+		Sum = 0.0;
+	}
+
+	SetNumNPCs(Settings.Steps[StepIndex]);
+
+	UE_LOG(LogFPS251106, Log, TEXT("ShooterAISoakBenchmark: step %d, %d NPCs"), StepIndex, SoakNPCs.Num());
+}
+
+void UShooterAISoakBenchmarkSubsystem::RecordFrame(float DeltaTime)
+{
+	FrameTimes.Add(DeltaTime * 1000.0f);
+
+	// the game thread time of the last finished frame, without waiting on the render thread
+	GameThreadTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+
+#if STATS
+	StatsCollector->Drain(SystemTimeSums, NumStatsFrames);
+#endif
+}
+
+void UShooterAISoakBenchmarkSubsystem::FinishStep()
+{
+	// adds the average, 95th percentile and max of the given times to the report, and returns the 95th percentile
+	auto Summarize = [](TArray<float>& Times, const FString& Prefix, FJsonObject& Report)
+	{
+		double Sum = 0.0;
+
+		for (const float Time : Times)
+		{
+			Sum += Time;
+		}
+
+		Times.Sort();
+
+		const int32 P95Index = FMath::Clamp(FMath::CeilToInt32(Times.Num() * 0.95f) - 1, 0, Times.Num() - 1);
+
+		Report.SetNumberField(Prefix + TEXT("AvgMs"), Times.Num() > 0 ? Sum / Times.Num() : 0.0);
+		Report.SetNumberField(Prefix + TEXT("P95Ms"), Times.Num() > 0 ? Times[P95Index] : 0.0);
+		Report.SetNumberField(Prefix + TEXT("MaxMs"), Times.Num() > 0 ? Times.Last() : 0.0);
+
+		return Times.Num() > 0 ? Times[P95Index] : 0.0f;
+	};
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+
+	SoakNPCs.RemoveAll([](const TWeakObjectPtr<AShooterNPC>& NPC) { return !NPC.IsValid(); });
+
+	Report->SetNumberField(TEXT("RequestedNPCs"), Settings.Steps[StepIndex]);
+	Report->SetNumberField(TEXT("NPCs"), SoakNPCs.Num());
+	Report->SetNumberField(TEXT("Frames"), FrameTimes.Num());
+
+	Summarize(FrameTimes, TEXT("Frame"), *Report);
+	const float GameThreadP95 = Summarize(GameThreadTimes, TEXT("GameThread"), *Report);
+
+	// a step holds 60 Hz if nearly every frame fits in its budget
+	Report->SetBoolField(TEXT("Holds60Hz"), GameThreadP95 <= 1000.0f / 60.0f);
+
+	// average time per frame of each system, or -1 without stats
+	TSharedRef<FJsonObject> Systems = MakeShared<FJsonObject>();
+
+	for (int32 i = 0; i < ShooterAISoakNumSystems; ++i)
+	{
+		Systems->SetNumberField(ShooterAISoakSystemNames[i], NumStatsFrames > 0 ? SystemTimeSums[i] / NumStatsFrames : -1.0);
+	}
+
+	Report->SetObjectField(TEXT("SystemAvgMs"), Systems);
+
+	StepReports.Add(MakeShared<FJsonValueObject>(Report));
+
+	UE_LOG(LogFPS251106, Log, TEXT("ShooterAISoakBenchmark: %d NPCs, game thread avg %.2fms p95 %.2fms"),
+		SoakNPCs.Num(), Report->GetNumberField(TEXT("GameThreadAvgMs")), GameThreadP95);
+}
+
+void UShooterAISoakBenchmarkSubsystem::WriteReport()
+{
+	// the largest step that held 60 Hz
+	int32 MaxNPCsAt60Hz = 0;
+
+	for (const TSharedPtr<FJsonValue>& StepReport : StepReports)
+	{
+		const TSharedPtr<FJsonObject>& Step = StepReport->AsObject();
+
+		if (Step->GetBoolField(TEXT("Holds60Hz")))
+		{
+			MaxNPCsAt60Hz = FMath::Max(MaxNPCsAt60Hz, static_cast<int32>(Step->GetNumberField(TEXT("NPCs"))));
+		}
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Map"), GetWorld()->GetMapName());
+	Root->SetStringField(TEXT("NPCClass"), GetPathNameSafe(NPCClass));
+	Root->SetStringField(TEXT("BuildConfiguration"), LexToString(FApp::GetBuildConfiguration()));
+	Root->SetStringField(TEXT("Date"), FDateTime::Now().ToIso8601());
+	Root->SetNumberField(TEXT("Targets"), Targets.Num());
+	Root->SetNumberField(TEXT("WarmupSeconds"), Settings.WarmupTime);
+	Root->SetNumberField(TEXT("StepSeconds"), Settings.Duration);
+	Root->SetBoolField(TEXT("StatsEnabled"), STATS != 0);
+	Root->SetNumberField(TEXT("MaxNPCsAt60Hz"), MaxNPCsAt60Hz);
+	Root->SetArrayField(TEXT("Steps"), StepReports);
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	const FString ReportPath = FPaths::ProfilingDir() / TEXT("AISoak") / FString::Printf(TEXT("AISoak_%s_%s.json"), *GetWorld()->GetMapName(), *FDateTime::Now().ToString());
+
+	if (FFileHelper::SaveStringToFile(Json, *ReportPath))
+	{
+		UE_LOG(LogFPS251106, Log, TEXT("ShooterAISoakBenchmark: saved %d steps to %s, max NPCs at 60 Hz: %d"), StepReports.Num(), *ReportPath, MaxNPCsAt60Hz);
+
+	} else {
+
+		UE_LOG(LogFPS251106, Error, TEXT("ShooterAISoakBenchmark: failed to save %s"), *ReportPath);
+
+	}
+}
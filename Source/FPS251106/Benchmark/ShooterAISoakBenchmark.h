@@ -0,0 +1,179 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterAISoakBenchmark.generated.h"
+
+class AShooterNPC;
+class APawn;
+class FJsonValue;
+class FShooterStatsCollector;
+
+/**
+ *  Number of game thread systems the soak benchmark times separately
+ */
+static constexpr int32 ShooterAISoakNumSystems = 5;
+
+/**
+ *  Settings for an AI soak run, read from the command line
+ */
+struct FShooterAISoakSettings
+{
+	/** NPC counts to run, in order */
+	TArray<int32> Steps = { 10, 25, 50, 100, 200 };
+
+	/** Time in seconds each step runs before recording, so spawning and the first perception pass settle */
+	float WarmupTime = 5.0f;
+
+	/** Time in seconds each step records for */
+	float Duration = 20.0f;
+
+	/** Number of scripted targets the NPCs fight */
+	int32 NumTargets = 4;
+
+	/** Tag the NPCs sense their targets by */
+	FName TargetTag = FName("Player");
+
+	/** Radius of the circle the targets walk on */
+	float TargetRadius = 1200.0f;
+
+	/** Radius of the ring the NPCs are spawned on */
+	float SpawnRadius = 3000.0f;
+
+	/** Path of the NPC class to spawn. Uses the multiplayer game mode NPC class if empty */
+	FString NPCClassPath;
+
+	/** If true, the process exits once the run is over */
+	bool bExitWhenDone = false;
+
+	/** Reads the settings from the command line */
+	static FShooterAISoakSettings FromCommandLine();
+};
+
+/**
+ *  World subsystem that measures how many NPCs the server can run at 60 Hz
+ *  Started from the command line with -ShooterAISoak, meant for a -nullrhi -game run on a test map, or with the
+ *  Shooter.AISoak.Start console command. The local player pawn is removed, and invulnerable scripted targets walk
+ *  in a circle while the NPCs fight them. Each NPC count step warms up, then records frame time, game thread time
+ *  and the inclusive time of the StateTree, perception, character movement, scene query and projectile stats.
+ *  The results of every step are written to a JSON report.
+ */
+UCLASS()
+class FPS251106_API UShooterAISoakBenchmarkSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Settings for the current run */
+	FShooterAISoakSettings Settings;
+
+	/** NPC class being spawned */
+	UPROPERTY(Transient)
+	TSubclassOf<AShooterNPC> NPCClass;
+
+	/** NPCs spawned for the run */
+	TArray<TWeakObjectPtr<AShooterNPC>> SoakNPCs;
+
+	/** Scripted targets */
+	TArray<TWeakObjectPtr<APawn>> Targets;
+
+	/** Center of the target circle and the NPC ring */
+	FVector Center = FVector::ZeroVector;
+
+	/** Reports of the finished steps */
+	TArray<TSharedPtr<FJsonValue>> StepReports;
+
+	/** Index of the running step */
+	int32 StepIndex = 0;
+
+	/** Time since the step started */
+	float StepTime = 0.0f;
+
+	/** Time since the run started */
+	float RunTime = 0.0f;
+
+	/** Frame times recorded during this step, in ms */
+	TArray<float> FrameTimes;
+
+	/** Game thread times recorded during this step, in ms */
+	TArray<float> GameThreadTimes;
+
+	/** Sum of the per-system times recorded during this step, in ms */
+	double SystemTimeSums[ShooterAISoakNumSystems] = {};
+
+	/** Number of stats frames summed into the system times */
+	int32 NumStatsFrames = 0;
+
+#if STATS
+	/** Sums the system times on the stats thread */
+	TSharedPtr<FShooterStatsCollector, ESPMode::ThreadSafe> StatsCollector;
+#endif
+
+	/** If true, the run starts on the next tick, once the player has been spawned */
+	bool bPendingStart = false;
+
+	/** If true, we're running */
+	bool bRunning = false;
+
+public:
+
+	/** Starts a run with the given settings */
+	void StartBenchmark(const FShooterAISoakSettings& InSettings);
+
+	/** Stops the run, writes the report and releases the NPCs and targets */
+	void StopBenchmark();
+
+	/** Returns true if we're running */
+	bool IsRunning() const { return bRunning; }
+
+	//~Begin USubsystem interface
+	virtual void Deinitialize() override;
+	//~End USubsystem interface
+
+	//~Begin UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	//~End UWorldSubsystem interface
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Resolves the NPC class from the settings or the game mode */
+	TSubclassOf<AShooterNPC> ResolveNPCClass() const;
+
+	/** Removes the local player pawn, so the NPCs only fight the scripted targets */
+	void RemoveLocalPawn();
+
+	/** Spawns the scripted targets around the center */
+	void SpawnTargets();
+
+	/** Walks the scripted targets around their circle */
+	void MoveTargets();
+
+	/** Acquires or releases NPCs until the given number are running */
+	void SetNumNPCs(int32 NumNPCs);
+
+	/** Returns a spawn location on the ground on the NPC ring */
+	FVector GetSpawnLocation(int32 Index, float HalfHeight) const;
+
+	/** Starts the step at the given index, or finishes the run */
+	void BeginStep(int32 Index);
+
+	/** Records the frame and the system times collected since the last one into the current step */
+	void RecordFrame(float DeltaTime);
+
+	/** Summarizes the current step into its report */
+	void FinishStep();
+
+	/** Writes the JSON report */
+	void WriteReport();
+};
@@ -0,0 +1,405 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterNetBenchmark.h"
+#include "ShooterCharacter.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "Net/NetworkObjectList.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+/** Set once the server has launched its clients, so a map reload doesn't launch them again */
+static bool GShooterNetBenchClientsLaunched = false;
+
+static FAutoConsoleCommandWithWorldAndArgs ShooterNetBenchStartCommand(
+	TEXT("Shooter.NetBench.Start"),
+	TEXT("Starts recording network benchmark metrics to a CSV. Optional args: duration in seconds, sample interval in seconds"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UShooterNetBenchmarkSubsystem* Benchmark = World ? World->GetSubsystem<UShooterNetBenchmarkSubsystem>() : nullptr)
+		{
+			FShooterNetBenchmarkSettings BenchSettings;
+			BenchSettings.Duration = Args.Num() > 0 ? FCString::Atof(*Args[0]) : BenchSettings.Duration;
+			BenchSettings.SampleInterval = Args.Num() > 1 ? FCString::Atof(*Args[1]) : BenchSettings.SampleInterval;
+
+			Benchmark->StartBenchmark(BenchSettings);
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorld ShooterNetBenchStopCommand(
+	TEXT("Shooter.NetBench.Stop"),
+	TEXT("Stops the network benchmark and saves the CSV"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UShooterNetBenchmarkSubsystem* Benchmark = World ? World->GetSubsystem<UShooterNetBenchmarkSubsystem>() : nullptr)
+		{
+			Benchmark->StopBenchmark();
+		}
+	})
+);
+
+FShooterNetBenchmarkSettings FShooterNetBenchmarkSettings::FromCommandLine()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	FShooterNetBenchmarkSettings BenchSettings;
+	FParse::Value(CommandLine, TEXT("NetBenchDuration="), BenchSettings.Duration);
+	FParse::Value(CommandLine, TEXT("NetBenchInterval="), BenchSettings.SampleInterval);
+	FParse::Value(CommandLine, TEXT("NetBenchClients="), BenchSettings.NumClients);
+	BenchSettings.bDriveLocalPawn = !FParse::Param(CommandLine, TEXT("NetBenchNoScript"));
+	BenchSettings.bExitWhenDone = true;
+
+	// forward the packet simulation settings so every client sees the same network conditions
+	static const TCHAR* PacketSimulationKeys[] = { TEXT("PktLag"), TEXT("PktLagVariance"), TEXT("PktLoss"), TEXT("PktDup"), TEXT("PktOrder") };
+
+	for (const TCHAR* Key : PacketSimulationKeys)
+	{
+		FString Value;
+
+		if (FParse::Value(CommandLine, *FString::Printf(TEXT("%s="), Key), Value))
+		{
+			BenchSettings.PacketSimulationArgs += FString::Printf(TEXT(" -%s=%s"), Key, *Value);
+		}
+	}
+
+	return BenchSettings;
+}
+
+void UShooterNetBenchmarkSubsystem::StartBenchmark(const FShooterNetBenchmarkSettings& InSettings)
+{
+	if (bRunning)
+	{
+		StopBenchmark();
+	}
+
+	Settings = InSettings;
+	Settings.SampleInterval = FMath::Max(Settings.SampleInterval, 0.1f);
+
+	RunTime = 0.0f;
+	SampleTime = 0.0f;
+	SampleFrames = 0;
+	SampleFrameTimeSum = 0.0f;
+	SampleFrameTimeMax = 0.0f;
+	SampleCorrections = 0;
+	bScriptFiring = false;
+	bRunning = true;
+
+	// corrections are applied by the movement component on its next tick, so check right after the packets are received
+	PostTickDispatchHandle = GetWorld()->OnPostTickDispatch().AddUObject(this, &UShooterNetBenchmarkSubsystem::CountCorrections);
+
+	// one file per process, so a server and its clients can run side by side
+	CsvPath = FPaths::ProfilingDir() / TEXT("NetBench") / FString::Printf(TEXT("NetBench_%s_%s_%u.csv"), *GetRoleName(), *FDateTime::Now().ToString(), FPlatformProcess::GetCurrentProcessId());
+
+	CsvRows.Reset();
+	CsvRows.Add(TEXT("Time,Role,Connection,OutBytesPerSec,InBytesPerSec,OutLossPct,InLossPct,PingMs,ReplicatedActors,AvgFrameMs,MaxFrameMs,Corrections"));
+
+	UE_LOG(LogFPS251106, Log, TEXT("ShooterNetBenchmark: recording %s for %.0fs to %s"), *GetRoleName(), Settings.Duration, *CsvPath);
+}
+
+void UShooterNetBenchmarkSubsystem::StopBenchmark()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	bRunning = false;
+
+	GetWorld()->OnPostTickDispatch().Remove(PostTickDispatchHandle);
+	PostTickDispatchHandle.Reset();
+
+	// let go of the trigger
+	if (bScriptFiring)
+	{
+		APlayerController* PC = GetWorld()->GetFirstPlayerController();
+
+		if (AShooterCharacter* Character = PC ? Cast<AShooterCharacter>(PC->GetPawn()) : nullptr)
+		{
+			Character->DoStopFiring();
+		}
+
+		bScriptFiring = false;
+	}
+
+	if (FFileHelper::SaveStringArrayToFile(CsvRows, *CsvPath))
+	{
+		UE_LOG(LogFPS251106, Log, TEXT("ShooterNetBenchmark: saved %d samples to %s"), CsvRows.Num() - 1, *CsvPath);
+
+	} else {
+
+		UE_LOG(LogFPS251106, Error, TEXT("ShooterNetBenchmark: failed to save %s"), *CsvPath);
+
+	}
+
+	CsvRows.Empty();
+
+	if (Settings.bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void UShooterNetBenchmarkSubsystem::Deinitialize()
+{
+	// save whatever we have if the world goes away mid run
+	if (bRunning)
+	{
+		Settings.bExitWhenDone = false;
+		StopBenchmark();
+	}
+
+	Super::Deinitialize();
+}
+
+void UShooterNetBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// only runs started from the command line are handled here
+	if (!FParse::Param(FCommandLine::Get(), TEXT("ShooterNetBench")))
+	{
+		return;
+	}
+
+	// wait until we're in a networked session. Clients start in a standalone map before they travel
+	if (InWorld.GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	const FShooterNetBenchmarkSettings BenchSettings = FShooterNetBenchmarkSettings::FromCommandLine();
+
+	StartBenchmark(BenchSettings);
+
+	// the server brings up the clients
+	if (InWorld.GetNetMode() != NM_Client && BenchSettings.NumClients > 0 && !GShooterNetBenchClientsLaunched)
+	{
+		GShooterNetBenchClientsLaunched = true;
+		LaunchClients();
+	}
+}
+
+void UShooterNetBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!bRunning)
+	{
+		return;
+	}
+
+	RunTime += DeltaTime;
+	SampleTime += DeltaTime;
+
+	// accumulate the game thread time of the last finished frame. The delta time would include render thread
+	// waits and the frame rate limit, which hide the cost of replication
+	const float FrameMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+
+	++SampleFrames;
+	SampleFrameTimeSum += FrameMs;
+	SampleFrameTimeMax = FMath::Max(SampleFrameTimeMax, FrameMs);
+
+	if (Settings.bDriveLocalPawn)
+	{
+		DriveLocalPawn(DeltaTime);
+	}
+
+	if (SampleTime >= Settings.SampleInterval)
+	{
+		RecordSample();
+
+		SampleTime = 0.0f;
+		SampleFrames = 0;
+		SampleFrameTimeSum = 0.0f;
+		SampleFrameTimeMax = 0.0f;
+		SampleCorrections = 0;
+	}
+
+	if (RunTime >= Settings.Duration)
+	{
+		StopBenchmark();
+	}
+}
+
+TStatId UShooterNetBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterNetBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterNetBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterNetBenchmarkSubsystem::LaunchClients()
+{
+	const FString Executable = FPlatformProcess::ExecutablePath();
+
+	FString Args;
+
+#if WITH_EDITOR
+	// editor builds need to be told which project to run
+	Args += FString::Printf(TEXT("\"%s\" "), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()));
+#endif
+
+	Args += FString::Printf(TEXT("127.0.0.1:%d -game -ShooterNetBench -NetBenchDuration=%f -NetBenchInterval=%f -nullrhi -nosound -unattended -log"),
+		GetWorld()->URL.Port, Settings.Duration, Settings.SampleInterval);
+
+	Args += Settings.PacketSimulationArgs;
+
+	if (!Settings.bDriveLocalPawn)
+	{
+		Args += TEXT(" -NetBenchNoScript");
+	}
+
+	for (int32 i = 0; i < Settings.NumClients; ++i)
+	{
+		FProcHandle Handle = FPlatformProcess::CreateProc(*Executable, *Args, true, true, true, nullptr, 0, nullptr, nullptr);
+
+		if (!Handle.IsValid())
+		{
+			UE_LOG(LogFPS251106, Error, TEXT("ShooterNetBenchmark: failed to launch client %d"), i);
+			continue;
+		}
+
+		FPlatformProcess::CloseProc(Handle);
+	}
+
+	UE_LOG(LogFPS251106, Log, TEXT("ShooterNetBenchmark: launched %d clients with args: %s"), Settings.NumClients, *Args);
+}
+
+void UShooterNetBenchmarkSubsystem::DriveLocalPawn(float DeltaTime)
+{
+	APlayerController* PC = GetWorld()->GetFirstPlayerController();
+	AShooterCharacter* Character = PC ? Cast<AShooterCharacter>(PC->GetPawn()) : nullptr;
+
+	if (!Character || Character->IsDead())
+	{
+		return;
+	}
+
+	// strafe along a slow figure eight while turning, so every client keeps moving through the grid
+	Character->DoMove(FMath::Sin(RunTime * 0.7f), FMath::Cos(RunTime * 0.4f));
+	Character->DoAim(45.0f * DeltaTime, FMath::Sin(RunTime) * 5.0f * DeltaTime);
+
+	// fire in one second bursts
+	const bool bShouldFire = FMath::FloorToInt32(RunTime) % 2 == 0;
+
+	if (bShouldFire != bScriptFiring)
+	{
+		bScriptFiring = bShouldFire;
+
+		if (bScriptFiring)
+		{
+			Character->DoStartFiring();
+
+		} else {
+
+			Character->DoStopFiring();
+
+		}
+	}
+}
+
+void UShooterNetBenchmarkSubsystem::CountCorrections()
+{
+	APlayerController* PC = GetWorld()->GetFirstPlayerController();
+	ACharacter* Character = PC ? Cast<ACharacter>(PC->GetPawn()) : nullptr;
+	UCharacterMovementComponent* Movement = Character ? Character->GetCharacterMovement() : nullptr;
+
+	if (!Movement || !Movement->HasPredictionData_Client())
+	{
+		return;
+	}
+
+	// the movement component flags a pending position update when the server corrects it
+	const FNetworkPredictionData_Client_Character* ClientData = Movement->GetPredictionData_Client_Character();
+
+	if (ClientData && ClientData->bUpdatePosition)
+	{
+		++SampleCorrections;
+	}
+}
+
+void UShooterNetBenchmarkSubsystem::RecordSample()
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+
+	const int32 NumReplicatedActors = NetDriver ? NetDriver->GetNetworkObjectList().GetActiveObjects().Num() : 0;
+	const float AvgFrameMs = SampleFrames > 0 ? SampleFrameTimeSum / SampleFrames : 0.0f;
+
+	if (!NetDriver)
+	{
+		RecordConnection(nullptr, INDEX_NONE, NumReplicatedActors, AvgFrameMs);
+		return;
+	}
+
+	// clients only have the server connection
+	if (NetDriver->ServerConnection)
+	{
+		RecordConnection(NetDriver->ServerConnection, 0, NumReplicatedActors, AvgFrameMs);
+		return;
+	}
+
+	if (NetDriver->ClientConnections.Num() == 0)
+	{
+		RecordConnection(nullptr, INDEX_NONE, NumReplicatedActors, AvgFrameMs);
+		return;
+	}
+
+	for (int32 i = 0; i < NetDriver->ClientConnections.Num(); ++i)
+	{
+		RecordConnection(NetDriver->ClientConnections[i], i, NumReplicatedActors, AvgFrameMs);
+	}
+}
+
+void UShooterNetBenchmarkSubsystem::RecordConnection(UNetConnection* Connection, int32 ConnectionIndex, int32 NumReplicatedActors, float AvgFrameMs)
+{
+	int32 OutBytesPerSecond = 0;
+	int32 InBytesPerSecond = 0;
+	float OutLoss = 0.0f;
+	float InLoss = 0.0f;
+	float PingMs = 0.0f;
+
+	if (Connection)
+	{
+		OutBytesPerSecond = Connection->OutBytesPerSecond;
+		InBytesPerSecond = Connection->InBytesPerSecond;
+		OutLoss = Connection->GetOutLossPercentage().GetAvgLossPercentage() * 100.0f;
+		InLoss = Connection->GetInLossPercentage().GetAvgLossPercentage() * 100.0f;
+		PingMs = Connection->AvgLag * 1000.0f;
+	}
+
+	CsvRows.Add(FString::Printf(TEXT("%.2f,%s,%d,%d,%d,%.2f,%.2f,%.1f,%d,%.2f,%.2f,%d"),
+		RunTime, *GetRoleName(), ConnectionIndex, OutBytesPerSecond, InBytesPerSecond, OutLoss, InLoss, PingMs,
+		NumReplicatedActors, AvgFrameMs, SampleFrameTimeMax, SampleCorrections));
+}
+
+FString UShooterNetBenchmarkSubsystem::GetRoleName() const
+{
+	switch (GetWorld()->GetNetMode())
+	{
+		case NM_DedicatedServer:
+			return TEXT("DedicatedServer");
+
+		case NM_ListenServer:
+			return TEXT("ListenServer");
+
+		case NM_Client:
+			return TEXT("Client");
+
+		default:
+			return TEXT("Standalone");
+	}
+}
@@ -0,0 +1,134 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterNetBenchmark.generated.h"
+
+class UNetConnection;
+
+/**
+ *  Settings for a network benchmark run, read from the command line
+ */
+struct FShooterNetBenchmarkSettings
+{
+	/** Time in seconds to record for */
+	float Duration = 60.0f;
+
+	/** Time in seconds between samples */
+	float SampleInterval = 1.0f;
+
+	/** Number of client processes the server launches on localhost */
+	int32 NumClients = 0;
+
+	/** If true, the locally controlled pawn is driven by the benchmark script */
+	bool bDriveLocalPawn = true;
+
+	/** If true, the process exits once the run is over */
+	bool bExitWhenDone = false;
+
+	/** Packet simulation arguments forwarded to the launched clients */
+	FString PacketSimulationArgs;
+
+	/** Reads the settings from the command line */
+	static FShooterNetBenchmarkSettings FromCommandLine();
+};
+
+/**
+ *  World subsystem that records replication metrics under simulated network conditions
+ *  Started from the command line with -ShooterNetBench, or with the Shooter.NetBench.Start console command.
+ *  The server can launch headless clients on localhost that forward the packet lag, loss and jitter settings.
+ *  While running, the local pawn moves, turns and fires on a fixed script, and every sample writes
+ *  per connection bandwidth, packet loss, ping, replicated actor count, frame time and movement corrections to a CSV.
+ */
+UCLASS()
+class FPS251106_API UShooterNetBenchmarkSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Settings for the current run */
+	FShooterNetBenchmarkSettings Settings;
+
+	/** Rows recorded so far, including the header */
+	TArray<FString> CsvRows;
+
+	/** File the rows are saved to */
+	FString CsvPath;
+
+	/** Time since the run started */
+	float RunTime = 0.0f;
+
+	/** Time since the last sample */
+	float SampleTime = 0.0f;
+
+	/** Frames ticked since the last sample */
+	int32 SampleFrames = 0;
+
+	/** Sum of the game thread frame times since the last sample, in ms */
+	float SampleFrameTimeSum = 0.0f;
+
+	/** Longest game thread frame time since the last sample, in ms */
+	float SampleFrameTimeMax = 0.0f;
+
+	/** Movement corrections received since the last sample */
+	int32 SampleCorrections = 0;
+
+	/** Handle to the post network receive callback used to count corrections */
+	FDelegateHandle PostTickDispatchHandle;
+
+	/** If true, the benchmark script is holding the trigger */
+	bool bScriptFiring = false;
+
+	/** If true, we're recording */
+	bool bRunning = false;
+
+public:
+
+	/** Starts recording with the given settings */
+	void StartBenchmark(const FShooterNetBenchmarkSettings& InSettings);
+
+	/** Stops recording and saves the CSV */
+	void StopBenchmark();
+
+	/** Returns true if we're recording */
+	bool IsRunning() const { return bRunning; }
+
+	//~Begin USubsystem interface
+	virtual void Deinitialize() override;
+	//~End USubsystem interface
+
+	//~Begin UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	//~End UWorldSubsystem interface
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Launches the headless clients on localhost */
+	void LaunchClients();
+
+	/** Moves, turns and fires the locally controlled pawn on a fixed script */
+	void DriveLocalPawn(float DeltaTime);
+
+	/** Counts the movement corrections the local pawn received in this frame's network receive */
+	void CountCorrections();
+
+	/** Records a row for every connection */
+	void RecordSample();
+
+	/** Records a row for a single connection */
+	void RecordConnection(UNetConnection* Connection, int32 ConnectionIndex, int32 NumReplicatedActors, float AvgFrameMs);
+
+	/** Returns a readable name for this machine's net role */
+	FString GetRoleName() const;
+};
@@ -20,7 +20,12 @@ public class FPS251106 : ModuleRules
 			"UMG",
 			"Slate",
 			"Kismet",
-			"OnlineSubsystem"
+			"OnlineSubsystem",
+			"NetCore",
+			"ReplicationGraph",
+			"MassEntity",
+			"Json",
+			"NavigationSystem"
 		});
 
 		PrivateDependencyModuleNames.AddRange(new string[] { });
@@ -33,7 +38,8 @@ public class FPS251106 : ModuleRules
 			"FPS251106/Variant_Shooter/AI",
 			"FPS251106/Variant_Shooter/UI",
 			"FPS251106/Variant_Shooter/Weapons",
-			"FPS251106/Menu"
+			"FPS251106/Menu",
+			"FPS251106/Benchmark"
 		});
 
 		// Uncomment if you are using Slate UI
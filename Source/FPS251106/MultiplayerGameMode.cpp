@@ -7,16 +7,25 @@
 #include "Variant_Shooter/AI/ShooterAIController.h"
 #include "Variant_Shooter/ShooterPlayerController.h"
 #include "Variant_Shooter/ShooterCharacter.h"
-#include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "TimerManager.h"
 #include "GameFramework/PlayerStart.h"
+#include "Variant_Shooter/ShooterSpawnRegistry.h"
+#include "Variant_Shooter/AI/ShooterNPCPool.h"
+#include "Variant_Shooter/ShooterWaveSpawner.h"
+#include "Variant_Shooter/ShooterGameState.h"
 #include "FPS251106.h"
 
 AMultiplayerGameMode::AMultiplayerGameMode()
 {
 	// Enable replication
 	bReplicates = true;
+
+	// create the wave spawner. Waves are configured in BP
+	WaveSpawner = CreateDefaultSubobject<UShooterWaveSpawnerComponent>(TEXT("WaveSpawner"));
+
+	// the game state replicates the wave progress to clients
+	GameStateClass = AShooterGameState::StaticClass();
 	
 	// Note: PlayerControllerClass and DefaultPawnClass should be set in blueprint
 	// AShooterPlayerController is abstract and cannot be directly instantiated
@@ -110,158 +119,63 @@ float AMultiplayerGameMode::GetRemainingMatchTime() const
 
 void AMultiplayerGameMode::SpawnInitialEnemies()
 {
-	if (!NPCClass)
+	if (!NPCClass || InitialEnemyCount <= 0)
 	{
 		return;
 	}
 
-	// Find all player starts in the world
-	TArray<AActor*> PlayerStarts;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), APlayerStart::StaticClass(), PlayerStarts);
+	// spawning them all in one frame stalls it, so let the wave spawner slice them.
+	// They come before the waves defined in BP
+	FShooterWaveDefinition Wave;
+	Wave.Delay = 0.0f;
 
-	if (PlayerStarts.Num() == 0)
-	{
-		UE_LOG(LogFPS251106, Warning, TEXT("No PlayerStart found in the world. Cannot spawn enemies."));
-		return;
-	}
+	FShooterWaveGroup& Group = Wave.Groups.AddDefaulted_GetRef();
+	Group.NPCClass = NPCClass;
+	Group.Count = InitialEnemyCount;
 
-	// Get the player's starting location (if player exists)
-	FVector PlayerStartLocation = FVector::ZeroVector;
-	if (APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(GetWorld(), 0))
-	{
-		PlayerStartLocation = PlayerPawn->GetActorLocation();
-	}
-	else
-	{
-		// If player hasn't spawned yet, use the first PlayerStart location
-		if (PlayerStarts.Num() > 0)
-		{
-			PlayerStartLocation = PlayerStarts[0]->GetActorLocation();
-		}
-	}
+	WaveSpawner->QueueNextWave(Wave);
+}
 
-	// Spawn enemies at player start locations that are far from the player
-	TArray<int32> UsedIndices;
-	for (int32 i = 0; i < InitialEnemyCount; ++i)
+AShooterNPC* AMultiplayerGameMode::SpawnEnemyAtRandomLocation(TSubclassOf<AShooterNPC> EnemyClass)
+{
+	if (!EnemyClass)
 	{
-		int32 Attempts = 0;
-		const int32 MaxAttempts = 50; // Prevent infinite loop
-		bool bSpawned = false;
-
-		while (Attempts < MaxAttempts && !bSpawned)
-		{
-			// Select a random player start
-			int32 StartIndex = FMath::RandRange(0, PlayerStarts.Num() - 1);
-			
-			// Skip if we've already used this index (unless we've tried too many times)
-			if (UsedIndices.Contains(StartIndex) && UsedIndices.Num() < PlayerStarts.Num())
-			{
-				++Attempts;
-				continue;
-			}
-
-			APlayerStart* SpawnPoint = Cast<APlayerStart>(PlayerStarts[StartIndex]);
-			if (SpawnPoint)
-			{
-				FVector SpawnLocation = SpawnPoint->GetActorLocation();
-				float DistanceToPlayer = FVector::Dist(SpawnLocation, PlayerStartLocation);
-
-				// If this spawn point is far enough from player, or we've tried many times, use it
-				if (DistanceToPlayer >= MinDistanceFromPlayer || Attempts >= MaxAttempts - 5)
-				{
-					FActorSpawnParameters SpawnParams;
-					SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-
-					AShooterNPC* SpawnedNPC = GetWorld()->SpawnActor<AShooterNPC>(NPCClass, SpawnPoint->GetActorTransform(), SpawnParams);
-					if (SpawnedNPC)
-					{
-						UsedIndices.Add(StartIndex);
-						UE_LOG(LogFPS251106, Log, TEXT("Spawned enemy NPC at PlayerStart %d (Distance from player: %.2f)"), StartIndex, DistanceToPlayer);
-						bSpawned = true;
-					}
-				}
-			}
-			++Attempts;
-		}
-
-		// If we couldn't spawn an enemy after all attempts, break
-		if (!bSpawned)
-		{
-			UE_LOG(LogFPS251106, Warning, TEXT("Could not find suitable spawn location for enemy %d after %d attempts"), i, MaxAttempts);
-			break;
-		}
+		EnemyClass = NPCClass;
 	}
-}
 
-AShooterNPC* AMultiplayerGameMode::SpawnEnemyAtRandomLocation()
-{
-	if (!NPCClass)
+	if (!EnemyClass)
 	{
 		return nullptr;
 	}
 
-	// Find all player starts in the world
-	TArray<AActor*> PlayerStarts;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), APlayerStart::StaticClass(), PlayerStarts);
+	UShooterSpawnRegistrySubsystem* SpawnRegistry = GetWorld()->GetSubsystem<UShooterSpawnRegistrySubsystem>();
+	// spawn away from the players, and skip spawns an enemy is already standing on
+	const auto IsThreat = [](const APawn* Pawn) { return Pawn->IsPlayerControlled(); };
+
+	APlayerStart* SpawnPoint = SpawnRegistry ? SpawnRegistry->FindSafestSpawn(MinDistanceFromPlayer, IsThreat, EnemyClass->GetDefaultObject<AShooterNPC>()) : nullptr;
 
-	if (PlayerStarts.Num() == 0)
+	if (!SpawnPoint)
 	{
 		UE_LOG(LogFPS251106, Warning, TEXT("No PlayerStart found in the world. Cannot respawn enemy."));
 		return nullptr;
 	}
 
-	// Get the player's location if available
-	FVector PlayerLocation = FVector::ZeroVector;
-	if (APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(GetWorld(), 0))
-	{
-		PlayerLocation = PlayerPawn->GetActorLocation();
-	}
+	// recycle a dead NPC if one is parked, along with its controller and weapon
+	UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>();
+	AShooterNPC* SpawnedNPC = Pool ? Pool->AcquireNPC(EnemyClass, SpawnPoint->GetActorTransform()) : nullptr;
 
-	const int32 MaxAttempts = 50;
-	for (int32 Attempt = 0; Attempt < MaxAttempts; ++Attempt)
+	if (!SpawnedNPC)
 	{
-		const int32 Index = FMath::RandRange(0, PlayerStarts.Num() - 1);
-		if (APlayerStart* SpawnPoint = Cast<APlayerStart>(PlayerStarts[Index]))
-		{
-			const FVector SpawnLocation = SpawnPoint->GetActorLocation();
-			const float DistanceToPlayer = FVector::Dist(SpawnLocation, PlayerLocation);
-
-			if (DistanceToPlayer >= MinDistanceFromPlayer || Attempt >= MaxAttempts - 5)
-			{
-				FActorSpawnParameters SpawnParams;
-				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-
-				AShooterNPC* SpawnedNPC = GetWorld()->SpawnActor<AShooterNPC>(NPCClass, SpawnPoint->GetActorTransform(), SpawnParams);
-				if (SpawnedNPC)
-				{
-					UE_LOG(LogFPS251106, Log, TEXT("Respawned enemy NPC at PlayerStart %d (Distance from player: %.2f)"), Index, DistanceToPlayer);
-					
-					// Ensure the AI Controller is properly initialized
-					// Use a delayed callback to ensure AI Controller has time to spawn and possess
-					GetWorld()->GetTimerManager().SetTimerForNextTick([SpawnedNPC]()
-					{
-						if (SpawnedNPC && IsValid(SpawnedNPC))
-						{
-							if (AShooterAIController* AIController = Cast<AShooterAIController>(SpawnedNPC->GetController()))
-							{
-								UE_LOG(LogFPS251106, Log, TEXT("Enemy AI Controller initialized for respawned NPC"));
-								// Ensure StateTree is started
-								AIController->EnsureStateTreeStarted();
-							}
-							else
-							{
-								UE_LOG(LogFPS251106, Warning, TEXT("Enemy NPC spawned but AI Controller still not available after delay"));
-							}
-						}
-					});
-					
-					return SpawnedNPC;
-				}
-			}
-		}
+		UE_LOG(LogFPS251106, Warning, TEXT("Failed to respawn enemy at %s."), *SpawnPoint->GetName());
+		return nullptr;
 	}
 
-	UE_LOG(LogFPS251106, Warning, TEXT("Failed to respawn enemy after %d attempts."), MaxAttempts);
-	return nullptr;
-}
+	// we own this one, so replace it when it dies
+	SpawnedNPC->SetRespawnOnDeath(true);
 
+	SpawnRegistry->MarkSpawnUsed(SpawnPoint);
+
+	UE_LOG(LogFPS251106, Log, TEXT("Respawned enemy NPC at %s"), *SpawnPoint->GetName());
+
+	return SpawnedNPC;
+}
@@ -9,6 +9,7 @@
 #include "MultiplayerGameMode.generated.h"
 
 class UShooterUI;
+class UShooterWaveSpawnerComponent;
 
 /**
  *  Multiplayer GameMode for a first person shooter game
@@ -19,6 +20,10 @@ class FPS251106_API AMultiplayerGameMode : public AShooterGameMode
 {
 	GENERATED_BODY()
 
+	/** Spawns enemy waves under a per-frame time budget */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
+	UShooterWaveSpawnerComponent* WaveSpawner;
+
 protected:
 
 	/** Target score to win the match */
@@ -37,6 +42,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Multiplayer|Enemies", meta = (ClampMin = 0))
 	int32 InitialEnemyCount = 1;
 
+	/** If true, every enemy that dies is replaced by a new one. Turn off when the enemies come in waves */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Multiplayer|Enemies")
+	bool bRespawnDeadEnemies = true;
+
 	/** Timer handle for match duration */
 	FTimerHandle MatchTimerHandle;
 
@@ -60,9 +69,9 @@ public:
 	/** Increases the score for the given team and checks for victory */
 	virtual void IncrementTeamScore(uint8 TeamByte) override;
 
-	/** Spawns a single enemy at a random valid location in the map */
+	/** Spawns a single enemy at the safest spawn point in the map. Uses the NPC class if no class is passed */
 	UFUNCTION(BlueprintCallable, Category="Multiplayer|Enemies")
-	class AShooterNPC* SpawnEnemyAtRandomLocation();
+	class AShooterNPC* SpawnEnemyAtRandomLocation(TSubclassOf<class AShooterNPC> EnemyClass = nullptr);
 
 	/** Checks if any team has reached the target score */
 	UFUNCTION(BlueprintCallable, Category="Multiplayer")
@@ -80,6 +89,15 @@ public:
 	UFUNCTION(BlueprintPure, Category="Multiplayer")
 	int32 GetTargetScore() const { return TargetScore; }
 
+	/** Returns true if dead enemies should be replaced */
+	bool ShouldRespawnDeadEnemies() const { return bRespawnDeadEnemies; }
+
+	/** Returns the wave spawner */
+	UShooterWaveSpawnerComponent* GetWaveSpawner() const { return WaveSpawner; }
+
+	/** Returns the NPC class spawned as enemies */
+	const TSubclassOf<class AShooterNPC>& GetNPCClass() const { return NPCClass; }
+
 	/** Returns the remaining match time */
 	UFUNCTION(BlueprintPure, Category="Multiplayer")
 	float GetRemainingMatchTime() const;
@@ -96,7 +114,7 @@ protected:
 	/** Ends the match and prevents further gameplay */
 	void EndMatch();
 
-	/** Spawns initial enemies in the world */
+	/** Queues the initial enemies as a single wave, so they're spawned over several frames */
 	void SpawnInitialEnemies();
 };
 
@@ -144,10 +144,21 @@ void APVPGameMode::OnPlayerKill(APlayerController* Killer, APlayerController* Vi
 			PlayerScoresArray.Add(FPlayerScoreInfo(Killer, PlayerScores[Killer]));
 		}
 
+		// credit the killer's team too
+		if (const AShooterCharacter* KillerCharacter = Cast<AShooterCharacter>(Killer->GetPawn()))
+		{
+			IncrementTeamScore(KillerCharacter->GetGenericTeamId().GetId());
+		}
+
 		UpdateScoreUI();
 	}
 }
 
+bool APVPGameMode::IsPlayerSpawnThreat(const APawn* Pawn, const AController* Player) const
+{
+	return Pawn->IsPlayerControlled() && Pawn->GetController() != Player;
+}
+
 float APVPGameMode::GetRemainingMatchTime() const
 {
 	if (MatchDuration <= 0.0f || bMatchEnded)
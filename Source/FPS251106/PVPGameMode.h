@@ -96,7 +96,7 @@ protected:
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 public:
-	/** Called when a player kills another player */
+	/** Called when a player kills another player. Scores the killer and credits their team */
 	UFUNCTION(BlueprintCallable, Category="PVP")
 	void OnPlayerKill(APlayerController* Killer, APlayerController* Victim);
 
@@ -137,6 +137,9 @@ public:
 	void ShowGameOverScreen();
 
 protected:
+	/** Players score on their own, so every other player's pawn is a threat to a spawning player */
+	virtual bool IsPlayerSpawnThreat(const APawn* Pawn, const AController* Player) const override;
+
 	/** Called when match duration expires */
 	void OnMatchTimeExpired_Internal();
 
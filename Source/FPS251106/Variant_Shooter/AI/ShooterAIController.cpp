@@ -5,6 +5,10 @@
 #include "ShooterNPC.h"
 #include "Components/StateTreeAIComponent.h"
 #include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISenseConfig_Sight.h"
+#include "Perception/AISense_Sight.h"
+#include "ShooterSightSense.h"
+#include "ShooterNPCPool.h"
 #include "Navigation/PathFollowingComponent.h"
 #include "AI/Navigation/PathFollowingAgentInterface.h"
 
@@ -16,11 +20,46 @@ AShooterAIController::AShooterAIController()
 	// create the AI perception component. It will be configured in BP
 	AIPerception = CreateDefaultSubobject<UAIPerceptionComponent>(TEXT("AIPerception"));
 
+	// add the batched sight sense. Any other senses are configured in BP
+	ShooterSightConfig = CreateDefaultSubobject<UAISenseConfig_ShooterSight>(TEXT("ShooterSightConfig"));
+	AIPerception->ConfigureSense(*ShooterSightConfig);
+
 	// subscribe to the AI perception delegates
 	AIPerception->OnTargetPerceptionUpdated.AddDynamic(this, &AShooterAIController::OnPerceptionUpdated);
 	AIPerception->OnTargetPerceptionForgotten.AddDynamic(this, &AShooterAIController::OnPerceptionForgotten);
 }
 
+void AShooterAIController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	SetupShooterSight();
+}
+
+void AShooterAIController::SetupShooterSight()
+{
+	// Blueprints serialize their own senses config, which replaces the one set up in the constructor
+	if (!AIPerception->GetSenseConfig(ShooterSightConfig->GetSenseID()))
+	{
+		// keep the sight ranges tuned on the stock sight sense
+		if (const UAISenseConfig_Sight* StockSightConfig = Cast<UAISenseConfig_Sight>(AIPerception->GetSenseConfig(UAISense::GetSenseID<UAISense_Sight>())))
+		{
+			ShooterSightConfig->SightRadius = StockSightConfig->SightRadius;
+			ShooterSightConfig->LoseSightRadius = StockSightConfig->LoseSightRadius;
+			ShooterSightConfig->PeripheralVisionAngleDegrees = StockSightConfig->PeripheralVisionAngleDegrees;
+		}
+
+		AIPerception->ConfigureSense(*ShooterSightConfig);
+	}
+
+	// the stock sight sense would trace every target again
+	AIPerception->SetSenseEnabled(UAISense_Sight::StaticClass(), false);
+	AIPerception->SetDominantSense(UAISense_ShooterSight::StaticClass());
+
+	// have the perception system pick up the new senses
+	AIPerception->RequestStimuliListenerUpdate();
+}
+
 void AShooterAIController::OnPossess(APawn* InPawn)
 {
 	Super::OnPossess(InPawn);
@@ -31,6 +70,9 @@ void AShooterAIController::OnPossess(APawn* InPawn)
 		// add the team tag to the pawn
 		NPC->Tags.Add(TeamTag);
 
+		// share the pawn's team, so our attitude towards other actors matches its own
+		SetGenericTeamId(NPC->GetGenericTeamId());
+
 		// subscribe to the pawn's OnDeath delegate
 		NPC->OnPawnDeath.AddDynamic(this, &AShooterAIController::OnPawnDeath);
 
@@ -42,11 +84,15 @@ void AShooterAIController::OnPossess(APawn* InPawn)
 
 void AShooterAIController::OnPawnDeath()
 {
-	// stop movement
-	GetPathFollowingComponent()->AbortMove(*this, FPathFollowingResultFlags::UserAbort);
+	StopBehavior();
 
-	// stop StateTree logic
-	StateTreeAI->StopLogic(FString(""));
+	// the pawn is recycled through the NPC pool along with us, so we stay possessed
+	const AShooterNPC* NPC = Cast<AShooterNPC>(GetPawn());
+
+	if (NPC && NPC->GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>())
+	{
+		return;
+	}
 
 	// unpossess the pawn
 	UnPossess();
@@ -55,6 +101,29 @@ void AShooterAIController::OnPawnDeath()
 	Destroy();
 }
 
+void AShooterAIController::StopBehavior()
+{
+	// stop movement
+	GetPathFollowingComponent()->AbortMove(*this, FPathFollowingResultFlags::UserAbort);
+
+	// stop StateTree logic
+	StateTreeAI->StopLogic(FString(""));
+
+	ClearCurrentTarget();
+}
+
+void AShooterAIController::RestartBehavior()
+{
+	// forget what the previous life perceived, and have the senses report what's visible from the new spawn point
+	AIPerception->ForgetAll();
+	AIPerception->RequestStimuliListenerUpdate();
+
+	ClearCurrentTarget();
+
+	// start StateTree logic from the root state
+	StateTreeAI->StartLogic();
+}
+
 void AShooterAIController::SetCurrentTarget(AActor* Target)
 {
 	TargetEnemy = Target;
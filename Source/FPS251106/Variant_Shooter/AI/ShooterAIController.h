@@ -8,6 +8,7 @@
 
 class UStateTreeAIComponent;
 class UAIPerceptionComponent;
+class UAISenseConfig_ShooterSight;
 struct FAIStimulus;
 
 DECLARE_DELEGATE_TwoParams(FShooterPerceptionUpdatedDelegate, AActor*, const FAIStimulus&);
@@ -29,6 +30,10 @@ class FPS251106_API AShooterAIController : public AAIController
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
 	UAIPerceptionComponent* AIPerception;
 
+	/** Batched shooter sight sense settings. Successful sight stimuli mean the NPC has direct line of sight */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
+	UAISenseConfig_ShooterSight* ShooterSightConfig;
+
 protected:
 
 	/** Team tag for pawn friend or foe identification */
@@ -53,9 +58,15 @@ public:
 
 protected:
 
+	/** Gameplay initialization */
+	virtual void BeginPlay() override;
+
 	/** Pawn initialization */
 	virtual void OnPossess(APawn* InPawn) override;
 
+	/** Makes sure the batched sight sense is the one perceiving, even if a Blueprint overrides the native senses */
+	void SetupShooterSight();
+
 protected:
 
 	/** Called when the possessed pawn dies */
@@ -76,6 +87,12 @@ public:
 	/** Ensures StateTree is started (called after spawning to verify initialization) */
 	void EnsureStateTreeStarted();
 
+	/** Stops movement and StateTree logic and drops the target. Possession is kept, so a pooled pawn can be reused */
+	void StopBehavior();
+
+	/** Forgets everything perceived so far and restarts the StateTree. Called when the pooled pawn is handed out again */
+	void RestartBehavior();
+
 protected:
 
 	/** Called when the AI perception component updates a perception on a given actor */
@@ -0,0 +1,442 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterAISignificance.h"
+#include "ShooterNPC.h"
+#include "ShooterSightSense.h"
+#include "ShooterStatsCollector.h"
+#include "AIController.h"
+#include "Components/StateTreeAIComponent.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AIPerceptionSystem.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("AI Significance Update"), STAT_ShooterAISignificanceUpdate, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("AI Tier High"), STAT_ShooterAITierHigh, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("AI Tier Medium"), STAT_ShooterAITierMedium, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("AI Tier Low"), STAT_ShooterAITierLow, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("AI Tier Dormant"), STAT_ShooterAITierDormant, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("AI Significance Traces"), STAT_ShooterAISignificanceTraces, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("AI Total"), STAT_ShooterAITotal, STATGROUP_Shooter);
+
+static int32 GShooterAISignificanceEnabled = 1;
+static FAutoConsoleVariableRef CVarShooterAISignificanceEnabled(
+	TEXT("Shooter.AISignificance.Enabled"),
+	GShooterAISignificanceEnabled,
+	TEXT("If non-zero, NPC AI ticks are throttled by distance and visibility to the players"),
+	ECVF_Default
+);
+
+static float GShooterAISignificanceUpdateInterval = 0.25f;
+static FAutoConsoleVariableRef CVarShooterAISignificanceUpdateInterval(
+	TEXT("Shooter.AISignificance.UpdateInterval"),
+	GShooterAISignificanceUpdateInterval,
+	TEXT("Time in seconds between two NPC ranking passes"),
+	ECVF_Default
+);
+
+static float GShooterAISignificanceHighDistance = 2000.0f;
+static FAutoConsoleVariableRef CVarShooterAISignificanceHighDistance(
+	TEXT("Shooter.AISignificance.HighDistance"),
+	GShooterAISignificanceHighDistance,
+	TEXT("NPCs closer than this to a player tick at full rate"),
+	ECVF_Default
+);
+
+static float GShooterAISignificanceMediumDistance = 5000.0f;
+static FAutoConsoleVariableRef CVarShooterAISignificanceMediumDistance(
+	TEXT("Shooter.AISignificance.MediumDistance"),
+	GShooterAISignificanceMediumDistance,
+	TEXT("NPCs closer than this to a player are in the medium tier"),
+	ECVF_Default
+);
+
+static float GShooterAISignificanceLowDistance = 10000.0f;
+static FAutoConsoleVariableRef CVarShooterAISignificanceLowDistance(
+	TEXT("Shooter.AISignificance.LowDistance"),
+	GShooterAISignificanceLowDistance,
+	TEXT("NPCs closer than this to a player are in the low tier. Farther NPCs are dormant"),
+	ECVF_Default
+);
+
+static float GShooterAISignificanceViewConeAngle = 60.0f;
+static FAutoConsoleVariableRef CVarShooterAISignificanceViewConeAngle(
+	TEXT("Shooter.AISignificance.ViewConeAngle"),
+	GShooterAISignificanceViewConeAngle,
+	TEXT("Half angle in degrees of the player view cone. NPCs inside it are bumped up one tier"),
+	ECVF_Default
+);
+
+static int32 GShooterAISignificanceMaxVisibilityTraces = 32;
+static FAutoConsoleVariableRef CVarShooterAISignificanceMaxVisibilityTraces(
+	TEXT("Shooter.AISignificance.MaxVisibilityTraces"),
+	GShooterAISignificanceMaxVisibilityTraces,
+	TEXT("Max number of line of sight traces issued per ranking pass for NPCs inside a player's view cone"),
+	ECVF_Default
+);
+
+#if STATS
+
+/** Engine and shooter AI stats summed into the AI Total stat. None of them nest */
+static TArray<FShooterStatsCollector::FSystemStat> MakeShooterAITotalStats()
+{
+	return {
+		{ 0, FName(TEXT("STAT_StateTree_Tick")) },
+		{ 0, FName(TEXT("STAT_AI_PerceptionSys")) },
+		{ 0, FName(TEXT("STAT_CharacterMovement")) },
+		{ 0, FName(TEXT("STAT_ShooterLineOfSightRefresh")) },
+		{ 0, FName(TEXT("STAT_ShooterAISignificanceUpdate")) }
+	};
+}
+
+#endif
+
+/** Tick interval of the StateTree component for each tier */
+static constexpr float StateTreeTickIntervals[] = { 0.0f, 0.1f, 0.25f, 1.0f };
+
+/** Min frames between two shooter sight traces of the same pair for each tier. Zero leaves the global setting */
+static constexpr int32 SightRetraceFrames[] = { 0, 6, 15, 60 };
+
+/** Tick interval of the movement component for each tier */
+static constexpr float MovementTickIntervals[] = { 0.0f, 0.0f, 0.05f, 0.2f };
+
+static_assert(UE_ARRAY_COUNT(StateTreeTickIntervals) == static_cast<int32>(EShooterAISignificance::Num), "One StateTree tick interval per tier");
+static_assert(UE_ARRAY_COUNT(SightRetraceFrames) == static_cast<int32>(EShooterAISignificance::Num), "One sight retrace rate per tier");
+static_assert(UE_ARRAY_COUNT(MovementTickIntervals) == static_cast<int32>(EShooterAISignificance::Num), "One movement tick interval per tier");
+
+void UShooterAISignificanceSubsystem::RegisterNPC(AShooterNPC* NPC)
+{
+	if (!IsValid(NPC) || Entries.ContainsByPredicate([NPC](const FShooterAISignificanceEntry& Entry) { return Entry.NPC == NPC; }))
+	{
+		return;
+	}
+
+	FShooterAISignificanceEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.NPC = NPC;
+
+	// rank it on the next tick
+	TimeUntilUpdate = 0.0f;
+}
+
+void UShooterAISignificanceSubsystem::UnregisterNPC(AShooterNPC* NPC)
+{
+	Entries.RemoveAllSwap([NPC](const FShooterAISignificanceEntry& Entry) { return Entry.NPC == NPC || !Entry.NPC.IsValid(); }, EAllowShrinking::No);
+}
+
+void UShooterAISignificanceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+#if STATS
+	// frames only arrive while stats are collected, so this costs nothing until "stat Shooter" is shown
+	StatsCollector = MakeShared<FShooterStatsCollector, ESPMode::ThreadSafe>(1, MakeShooterAITotalStats());
+	StatsCollector->Start();
+#endif
+}
+
+void UShooterAISignificanceSubsystem::Deinitialize()
+{
+#if STATS
+	if (StatsCollector)
+	{
+		StatsCollector->Stop();
+		StatsCollector.Reset();
+	}
+#endif
+
+	Super::Deinitialize();
+}
+
+void UShooterAISignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UpdateAITimeStat();
+
+	// trace results only stay around for a frame, so collect them every frame
+	if (NumPendingVisibilityTraces > 0)
+	{
+		GatherVisibilityResults();
+	}
+
+	TimeUntilUpdate -= DeltaTime;
+
+	if (Entries.Num() == 0 || TimeUntilUpdate > 0.0f)
+	{
+		return;
+	}
+
+	TimeUntilUpdate = GShooterAISignificanceUpdateInterval;
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterAISignificanceUpdate);
+
+	// drop NPCs that went away up front, so the candidate indices stay valid
+	Entries.RemoveAllSwap([](const FShooterAISignificanceEntry& Entry) { return !Entry.NPC.IsValid(); }, EAllowShrinking::No);
+
+	GatherViewers();
+
+	FMemory::Memzero(TierCounts);
+	VisibilityCandidates.Reset();
+
+	const bool bRank = GShooterAISignificanceEnabled != 0 && ViewerLocations.Num() > 0;
+
+	for (int32 i = 0; i < Entries.Num(); ++i)
+	{
+		FShooterAISignificanceEntry& Entry = Entries[i];
+		AShooterNPC* NPC = Entry.NPC.Get();
+
+		// dead NPCs don't think anymore
+		if (NPC->IsDead())
+		{
+			continue;
+		}
+
+		// without any players around, or with throttling off, everyone runs at full rate
+		int32 ConeViewer = INDEX_NONE;
+		const EShooterAISignificance Tier = bRank ? ComputeTier(NPC->GetActorLocation(), Entry.bVisible, ConeViewer) : EShooterAISignificance::High;
+
+		// only NPCs inside a view cone need their visibility confirmed
+		if (ConeViewer == INDEX_NONE)
+		{
+			Entry.bVisible = false;
+
+		} else if (!Entry.bVisibilityPending) {
+
+			Entry.ConeViewer = ConeViewer;
+			VisibilityCandidates.Add(i);
+
+		}
+
+		if (!Entry.bApplied || Tier != Entry.Tier)
+		{
+			Entry.Tier = Tier;
+			Entry.bApplied = true;
+
+			ApplyTier(NPC, Tier);
+		}
+
+		++TierCounts[static_cast<int32>(Tier)];
+	}
+
+	// the results raise or lower the tiers on the next pass
+	IssueVisibilityTraces();
+
+	SET_DWORD_STAT(STAT_ShooterAITierHigh, TierCounts[static_cast<int32>(EShooterAISignificance::High)]);
+	SET_DWORD_STAT(STAT_ShooterAITierMedium, TierCounts[static_cast<int32>(EShooterAISignificance::Medium)]);
+	SET_DWORD_STAT(STAT_ShooterAITierLow, TierCounts[static_cast<int32>(EShooterAISignificance::Low)]);
+	SET_DWORD_STAT(STAT_ShooterAITierDormant, TierCounts[static_cast<int32>(EShooterAISignificance::Dormant)]);
+}
+
+TStatId UShooterAISignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterAISignificanceSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterAISignificanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterAISignificanceSubsystem::GatherViewers()
+{
+	ViewerLocations.Reset();
+	ViewerDirections.Reset();
+	ViewerPawns.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		const APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+
+		if (!Pawn)
+		{
+			continue;
+		}
+
+		// the base aim rotation follows the replicated control rotation, so it works for remote players too
+		ViewerLocations.Add(Pawn->GetPawnViewLocation());
+		ViewerDirections.Add(Pawn->GetBaseAimRotation().Vector());
+		ViewerPawns.Add(Pawn);
+	}
+}
+
+EShooterAISignificance UShooterAISignificanceSubsystem::ComputeTier(const FVector& Location, bool bVisible, int32& OutConeViewer) const
+{
+	const float ConeCos = FMath::Cos(FMath::DegreesToRadians(GShooterAISignificanceViewConeAngle));
+
+	float NearestDistSq = TNumericLimits<float>::Max();
+	float NearestConeDistSq = TNumericLimits<float>::Max();
+
+	OutConeViewer = INDEX_NONE;
+
+	for (int32 i = 0; i < ViewerLocations.Num(); ++i)
+	{
+		const FVector Delta = Location - ViewerLocations[i];
+		const float DistSq = Delta.SizeSquared();
+
+		NearestDistSq = FMath::Min(NearestDistSq, DistSq);
+
+		// inside this player's view cone? Keep the nearest one to trace the visibility from
+		if (DistSq < NearestConeDistSq && FVector::DotProduct(Delta, ViewerDirections[i]) >= ConeCos * FMath::Sqrt(DistSq))
+		{
+			NearestConeDistSq = DistSq;
+			OutConeViewer = i;
+		}
+	}
+
+	int32 TierIndex = static_cast<int32>(EShooterAISignificance::Dormant);
+
+	if (NearestDistSq <= FMath::Square(GShooterAISignificanceHighDistance))
+	{
+		TierIndex = static_cast<int32>(EShooterAISignificance::High);
+
+	} else if (NearestDistSq <= FMath::Square(GShooterAISignificanceMediumDistance)) {
+
+		TierIndex = static_cast<int32>(EShooterAISignificance::Medium);
+
+	} else if (NearestDistSq <= FMath::Square(GShooterAISignificanceLowDistance)) {
+
+		TierIndex = static_cast<int32>(EShooterAISignificance::Low);
+
+	}
+
+	// NPCs a player can actually see get bumped up a tier. Looking towards an NPC behind a wall doesn't count
+	if (OutConeViewer != INDEX_NONE && bVisible && TierIndex > 0)
+	{
+		--TierIndex;
+	}
+
+	return static_cast<EShooterAISignificance>(TierIndex);
+}
+
+void UShooterAISignificanceSubsystem::GatherVisibilityResults()
+{
+	UWorld* World = GetWorld();
+
+	// recount, so entries unregistered while their trace was in flight don't keep us polling
+	NumPendingVisibilityTraces = 0;
+
+	for (FShooterAISignificanceEntry& Entry : Entries)
+	{
+		if (!Entry.bVisibilityPending)
+		{
+			continue;
+		}
+
+		if (World->QueryTraceData(Entry.VisibilityTrace, VisibilityTraceData))
+		{
+			Entry.bVisible = !VisibilityTraceData.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+
+		} else if (World->IsTraceHandleValid(Entry.VisibilityTrace, false)) {
+
+			// not ready yet
+			++NumPendingVisibilityTraces;
+			continue;
+
+		}
+
+		// dropped traces keep the last verdict and let the NPC be traced again
+		Entry.bVisibilityPending = false;
+	}
+}
+
+void UShooterAISignificanceSubsystem::IssueVisibilityTraces()
+{
+	const int32 NumTraces = FMath::Min(VisibilityCandidates.Num(), FMath::Max(GShooterAISignificanceMaxVisibilityTraces, 0));
+
+	if (NumTraces == 0)
+	{
+		return;
+	}
+
+	// trace the NPCs that waited the longest first
+	if (NumTraces < VisibilityCandidates.Num())
+	{
+		VisibilityCandidates.Sort([this](int32 A, int32 B) { return Entries[A].VisibilityTraceTime < Entries[B].VisibilityTraceTime; });
+	}
+
+	UWorld* World = GetWorld();
+	const double Now = World->GetTimeSeconds();
+
+	for (int32 CandidateIndex = 0; CandidateIndex < NumTraces; ++CandidateIndex)
+	{
+		FShooterAISignificanceEntry& Entry = Entries[VisibilityCandidates[CandidateIndex]];
+		const AShooterNPC* NPC = Entry.NPC.Get();
+
+		// ignore the player and the NPC. Only the geometry between them matters
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterAISignificance), false, ViewerPawns[Entry.ConeViewer]);
+		QueryParams.AddIgnoredActor(NPC);
+
+		Entry.VisibilityTrace = World->AsyncLineTraceByChannel(EAsyncTraceType::Test, ViewerLocations[Entry.ConeViewer], NPC->GetPawnViewLocation(), ECC_Visibility, QueryParams);
+		Entry.VisibilityTraceTime = Now;
+		Entry.bVisibilityPending = true;
+
+		++NumPendingVisibilityTraces;
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterAISignificanceTraces, NumTraces);
+}
+
+void UShooterAISignificanceSubsystem::UpdateAITimeStat()
+{
+#if STATS
+	if (!StatsCollector)
+	{
+		return;
+	}
+
+	double AITimeMs = 0.0;
+	int32 NumFrames = 0;
+	StatsCollector->Drain(MakeArrayView(&AITimeMs, 1), NumFrames);
+
+	// the stats thread lags a frame or two behind, so this shows the average of the frames it finished since our last tick
+	if (NumFrames > 0)
+	{
+		SET_CYCLE_COUNTER(STAT_ShooterAITotal, static_cast<uint32>(AITimeMs / NumFrames / (FPlatformTime::GetSecondsPerCycle() * 1000.0)));
+	}
+#endif
+}
+
+void UShooterAISignificanceSubsystem::ApplyTier(AShooterNPC* NPC, EShooterAISignificance Tier)
+{
+	const int32 TierIndex = static_cast<int32>(Tier);
+
+	// throttle the brain
+	if (AAIController* Controller = Cast<AAIController>(NPC->GetController()))
+	{
+		if (UStateTreeAIComponent* StateTree = Controller->FindComponentByClass<UStateTreeAIComponent>())
+		{
+			StateTree->SetComponentTickInterval(StateTreeTickIntervals[TierIndex]);
+		}
+
+		// the senses run in the perception system, not in the perception component tick, so throttle the sight sense itself
+		const UAIPerceptionComponent* Perception = Controller->FindComponentByClass<UAIPerceptionComponent>();
+		const UAIPerceptionSystem* PerceptionSystem = UAIPerceptionSystem::GetCurrent(NPC->GetWorld());
+
+		if (UAISense_ShooterSight* Sight = (Perception && PerceptionSystem) ? PerceptionSystem->GetSenseInstance<UAISense_ShooterSight>() : nullptr)
+		{
+			Sight->SetListenerMinRetraceFrames(Perception->GetListenerId(), SightRetraceFrames[TierIndex]);
+		}
+	}
+
+	// throttle the movement
+	UCharacterMovementComponent* Movement = NPC->GetCharacterMovement();
+	Movement->SetComponentTickInterval(MovementTickIntervals[TierIndex]);
+
+	// far away NPCs follow the navmesh instead of sweeping for the floor
+	const bool bUseNavWalking = Tier >= EShooterAISignificance::Low;
+
+	if (bUseNavWalking && Movement->MovementMode == MOVE_Walking)
+	{
+		Movement->SetMovementMode(MOVE_NavWalking);
+
+	} else if (!bUseNavWalking && Movement->MovementMode == MOVE_NavWalking) {
+
+		Movement->SetMovementMode(MOVE_Walking);
+
+	}
+}
@@ -0,0 +1,155 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "ShooterAISignificance.generated.h"
+
+class AShooterNPC;
+class APawn;
+class FShooterStatsCollector;
+
+/**
+ *  Significance tier of an NPC. Lower tiers tick less often
+ */
+UENUM(BlueprintType)
+enum class EShooterAISignificance : uint8
+{
+	/** Close to a player, or in plain view. Ticks at full rate */
+	High,
+
+	/** Mid range */
+	Medium,
+
+	/** Far away. Uses cheap movement */
+	Low,
+
+	/** Out of range of every player. Barely ticks */
+	Dormant,
+
+	Num UMETA(Hidden)
+};
+
+/**
+ *  An NPC registered with the significance subsystem
+ */
+struct FShooterAISignificanceEntry
+{
+	/** Registered NPC */
+	TWeakObjectPtr<AShooterNPC> NPC;
+
+	/** Tier currently applied to the NPC */
+	EShooterAISignificance Tier = EShooterAISignificance::High;
+
+	/** If true, the tier settings have been applied at least once */
+	bool bApplied = false;
+
+	/** Async trace checking whether a player can actually see the NPC */
+	FTraceHandle VisibilityTrace;
+
+	/** Time the visibility was last traced */
+	double VisibilityTraceTime = 0.0;
+
+	/** Player the visibility is traced from on this pass */
+	int32 ConeViewer = INDEX_NONE;
+
+	/** If true, a visibility trace is in flight */
+	bool bVisibilityPending = false;
+
+	/** If true, the last trace from a player looking at the NPC came back unobstructed */
+	bool bVisible = false;
+};
+
+/**
+ *  World subsystem that throttles NPC AI by significance
+ *  On the server, every NPC is periodically ranked by its distance to the nearest player and by whether a player
+ *  can see it: inside a view cone, and confirmed by an async line of sight trace. The traces are time-sliced under
+ *  a per-pass budget, oldest first. Each tier sets the tick intervals of the StateTree and movement components
+ *  and how often the shooter sight sense retraces the NPC's targets, and far away NPCs switch to nav walking
+ *  so they skip the floor sweeps. The measured AI game thread time is published as the AI Total stat.
+ */
+UCLASS()
+class FPS251106_API UShooterAISignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Registered NPCs */
+	TArray<FShooterAISignificanceEntry> Entries;
+
+	/** Frame scratch: locations of the player pawns */
+	TArray<FVector> ViewerLocations;
+
+	/** Frame scratch: aim directions of the player pawns */
+	TArray<FVector> ViewerDirections;
+
+	/** Frame scratch: player pawns */
+	TArray<const APawn*> ViewerPawns;
+
+	/** Frame scratch: entries inside a player's view cone that are waiting for a visibility trace */
+	TArray<int32> VisibilityCandidates;
+
+	/** Frame scratch: trace results */
+	FTraceDatum VisibilityTraceData;
+
+	/** Number of visibility traces in flight */
+	int32 NumPendingVisibilityTraces = 0;
+
+#if STATS
+	/** Sums the engine's AI stats on the stats thread */
+	TSharedPtr<FShooterStatsCollector, ESPMode::ThreadSafe> StatsCollector;
+#endif
+
+	/** Time left until the next ranking pass */
+	float TimeUntilUpdate = 0.0f;
+
+	/** Number of NPCs in each tier after the last ranking pass */
+	int32 TierCounts[static_cast<int32>(EShooterAISignificance::Num)] = {};
+
+public:
+
+	/** Starts throttling the given NPC */
+	void RegisterNPC(AShooterNPC* NPC);
+
+	/** Stops throttling the given NPC */
+	void UnregisterNPC(AShooterNPC* NPC);
+
+	/** Returns the number of NPCs in the given tier */
+	int32 GetTierCount(EShooterAISignificance Tier) const { return TierCounts[static_cast<int32>(Tier)]; }
+
+	//~Begin USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~End USubsystem interface
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Collects the location and aim of every player pawn */
+	void GatherViewers();
+
+	/** Ranks an NPC at the given location. Only visible NPCs get the view cone bump. Outputs the nearest player looking towards it */
+	EShooterAISignificance ComputeTier(const FVector& Location, bool bVisible, int32& OutConeViewer) const;
+
+	/** Applies the visibility trace results that came back */
+	void GatherVisibilityResults();
+
+	/** Issues visibility traces for the candidates that waited the longest, up to the pass budget */
+	void IssueVisibilityTraces();
+
+	/** Publishes the AI game thread time measured by the collector */
+	void UpdateAITimeStat();
+
+	/** Applies the tick intervals, sight throttle and movement mode of a tier to an NPC */
+	static void ApplyTier(AShooterNPC* NPC, EShooterAISignificance Tier);
+};
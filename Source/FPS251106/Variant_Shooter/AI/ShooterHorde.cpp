@@ -0,0 +1,639 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterHorde.h"
+#include "ShooterHordeFragments.h"
+#include "ShooterHordeProcessors.h"
+#include "ShooterNPC.h"
+#include "ShooterNPCPool.h"
+#include "ShooterWeapon.h"
+#include "ShooterHitscan.h"
+#include "ShooterDamage.h"
+#include "MultiplayerGameMode.h"
+#include "MassEntitySubsystem.h"
+#include "MassEntityManager.h"
+#include "MassExecutor.h"
+#include "MassProcessingTypes.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "NavigationSystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Horde Simulation"), STAT_ShooterHordeSimulation, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Horde Promotion"), STAT_ShooterHordePromotion, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Horde Entities"), STAT_ShooterHordeEntities, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Horde Promoted NPCs"), STAT_ShooterHordePromoted, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Shots"), STAT_ShooterHordeShots, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Sight Traces"), STAT_ShooterHordeSightTraces, STATGROUP_Shooter);
+
+static float GShooterHordePromoteDistance = 4000.0f;
+static FAutoConsoleVariableRef CVarShooterHordePromoteDistance(
+	TEXT("Shooter.Horde.PromoteDistance"),
+	GShooterHordePromoteDistance,
+	TEXT("Horde entities closer than this to a player are candidates to be promoted to full NPCs"),
+	ECVF_Default
+);
+
+static float GShooterHordeDemoteDistance = 5000.0f;
+static FAutoConsoleVariableRef CVarShooterHordeDemoteDistance(
+	TEXT("Shooter.Horde.DemoteDistance"),
+	GShooterHordeDemoteDistance,
+	TEXT("Promoted NPCs farther than this from every player are demoted back to horde entities. Keep it above the promote distance"),
+	ECVF_Default
+);
+
+static int32 GShooterHordeMaxPromoted = 24;
+static FAutoConsoleVariableRef CVarShooterHordeMaxPromoted(
+	TEXT("Shooter.Horde.MaxPromoted"),
+	GShooterHordeMaxPromoted,
+	TEXT("Max number of horde entities promoted to full NPCs at the same time"),
+	ECVF_Default
+);
+
+static int32 GShooterHordeMaxPromotionsPerUpdate = 4;
+static FAutoConsoleVariableRef CVarShooterHordeMaxPromotionsPerUpdate(
+	TEXT("Shooter.Horde.MaxPromotionsPerUpdate"),
+	GShooterHordeMaxPromotionsPerUpdate,
+	TEXT("Max number of NPC actors spawned by a single promotion pass"),
+	ECVF_Default
+);
+
+static float GShooterHordePromotionInterval = 0.25f;
+static FAutoConsoleVariableRef CVarShooterHordePromotionInterval(
+	TEXT("Shooter.Horde.PromotionInterval"),
+	GShooterHordePromotionInterval,
+	TEXT("Time in seconds between two promotion passes"),
+	ECVF_Default
+);
+
+static int32 GShooterHordeMaxShotsPerFrame = 32;
+static FAutoConsoleVariableRef CVarShooterHordeMaxShotsPerFrame(
+	TEXT("Shooter.Horde.MaxShotsPerFrame"),
+	GShooterHordeMaxShotsPerFrame,
+	TEXT("Max number of shots fired by horde entities in a single frame. Entities past the budget fire on a later frame"),
+	ECVF_Default
+);
+
+static int32 GShooterHordeMaxSightTracesPerFrame = 32;
+static FAutoConsoleVariableRef CVarShooterHordeMaxSightTracesPerFrame(
+	TEXT("Shooter.Horde.MaxSightTracesPerFrame"),
+	GShooterHordeMaxSightTracesPerFrame,
+	TEXT("Max number of line of sight traces issued by horde entities in a single frame. Entities past the budget check on a later frame"),
+	ECVF_Default
+);
+
+static float GShooterHordeGroundSearchHeight = 1000.0f;
+static FAutoConsoleVariableRef CVarShooterHordeGroundSearchHeight(
+	TEXT("Shooter.Horde.GroundSearchHeight"),
+	GShooterHordeGroundSearchHeight,
+	TEXT("Vertical distance searched for the navmesh or the ground under a horde entity being promoted"),
+	ECVF_Default
+);
+
+static FAutoConsoleCommandWithWorldAndArgs CmdShooterHordeSpawn(
+	TEXT("Shooter.Horde.Spawn"),
+	TEXT("Spawns horde entities of the game mode's NPC class around the first player. Usage: Shooter.Horde.Spawn <Count> [Radius]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UShooterHordeSubsystem* Horde = World ? World->GetSubsystem<UShooterHordeSubsystem>() : nullptr;
+		const AMultiplayerGameMode* GM = World ? Cast<AMultiplayerGameMode>(World->GetAuthGameMode()) : nullptr;
+		const APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+		const APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+
+		if (!Horde || !GM || !Pawn)
+		{
+			UE_LOG(LogFPS251106, Warning, TEXT("Shooter.Horde.Spawn needs a server running the multiplayer game mode and a player pawn"));
+			return;
+		}
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		const float Radius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 6000.0f;
+
+		const FVector Center = Pawn->GetActorLocation() - FVector(0.0f, 0.0f, Pawn->GetSimpleCollisionHalfHeight());
+
+		const int32 Spawned = Horde->SpawnHorde(GM->GetNPCClass(), Center, Radius, Count);
+
+		UE_LOG(LogFPS251106, Log, TEXT("Spawned %d horde entities, %d alive"), Spawned, Horde->GetNumEntities());
+	})
+);
+
+static FAutoConsoleCommandWithWorld CmdShooterHordeClear(
+	TEXT("Shooter.Horde.Clear"),
+	TEXT("Destroys every horde entity"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UShooterHordeSubsystem* Horde = World ? World->GetSubsystem<UShooterHordeSubsystem>() : nullptr)
+		{
+			Horde->ClearHorde();
+		}
+	})
+);
+
+FShooterHordeTuningFragment FShooterHordeTuningFragment::FromNPCClass(const TSubclassOf<AShooterNPC>& InNPCClass)
+{
+	FShooterHordeTuningFragment Tuning;
+	Tuning.NPCClass = InNPCClass;
+
+	const AShooterNPC* NPC = InNPCClass ? InNPCClass->GetDefaultObject<AShooterNPC>() : nullptr;
+
+	if (!NPC)
+	{
+		return Tuning;
+	}
+
+	// character tuning
+	Tuning.MoveSpeed = NPC->GetCharacterMovement()->MaxWalkSpeed;
+	Tuning.CapsuleHalfHeight = NPC->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	Tuning.CapsuleRadius = NPC->GetCapsuleComponent()->GetScaledCapsuleRadius();
+	Tuning.EyeHeight = Tuning.CapsuleHalfHeight + NPC->BaseEyeHeight;
+	Tuning.AimRange = NPC->GetAimRange();
+	Tuning.AimVarianceHalfAngle = NPC->GetAimVarianceHalfAngle();
+	Tuning.MinAimOffsetZ = NPC->GetMinAimOffsetZ();
+	Tuning.MaxAimOffsetZ = NPC->GetMaxAimOffsetZ();
+
+	// weapon tuning
+	if (const TSubclassOf<AShooterWeapon>& WeaponClass = NPC->GetWeaponClass())
+	{
+		const AShooterWeapon* Weapon = WeaponClass->GetDefaultObject<AShooterWeapon>();
+
+		Tuning.RefireRate = Weapon->GetRefireRate();
+		Tuning.TraceChannel = Weapon->GetHitscanTraceChannel();
+		Tuning.HitParams = Weapon->GetShotHitParams();
+
+		// NPC shots go through both the aim cone and the weapon spread, so fold them into one cone
+		Tuning.AimVarianceHalfAngle += Weapon->GetAimVariance();
+	}
+
+	return Tuning;
+}
+
+int32 UShooterHordeSubsystem::SpawnHorde(TSubclassOf<AShooterNPC> NPCClass, const FVector& Center, float Radius, int32 Count)
+{
+	FMassEntityManager* EntityManager = GetEntityManager();
+
+	if (!EntityManager || !NPCClass || Count <= 0)
+	{
+		return 0;
+	}
+
+	// spread the entities evenly on the ring, with some jitter so they don't walk in lockstep
+	TArray<FVector> Locations;
+	Locations.Reserve(Count);
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const float Angle = (UE_TWO_PI * i) / Count;
+		const float Distance = Radius * FMath::FRandRange(0.8f, 1.0f);
+
+		Locations.Add(Center + FVector(FMath::Cos(Angle) * Distance, FMath::Sin(Angle) * Distance, 0.0f));
+	}
+
+	CreateEntities(*EntityManager, NPCClass, Locations, -1.0f);
+
+	return Count;
+}
+
+void UShooterHordeSubsystem::ClearHorde()
+{
+	if (FMassEntityManager* EntityManager = GetEntityManager())
+	{
+		EntityManager->BatchDestroyEntities(Entities);
+	}
+
+	Entities.Reset();
+	Candidates.Reset();
+	PendingSightTraces.Reset();
+}
+
+float UShooterHordeSubsystem::GetPromoteDistance() const
+{
+	return GShooterHordePromoteDistance;
+}
+
+bool UShooterHordeSubsystem::QueueShot(const FVector& Start, const FVector& End, const FShooterHordeTuningFragment& Tuning)
+{
+	if (!Hitscan || NumShots >= GShooterHordeMaxShotsPerFrame)
+	{
+		return false;
+	}
+
+	++NumShots;
+
+	// horde shots have no weapon or instigator, so they deal damage but don't score
+	Hitscan->QueueTrace(nullptr, Start, End, Tuning.TraceChannel, Tuning.HitParams);
+
+	INC_DWORD_STAT(STAT_ShooterHordeShots);
+
+	return true;
+}
+
+bool UShooterHordeSubsystem::RequestLineOfSight(const FMassEntityHandle& Entity, const FVector& Start, int32 TargetIndex)
+{
+	if (NumSightTraces >= GShooterHordeMaxSightTracesPerFrame || !TargetPawns.IsValidIndex(TargetIndex))
+	{
+		return false;
+	}
+
+	++NumSightTraces;
+
+	// the target's own collision doesn't count as an obstruction
+	const APawn* TargetPawn = TargetPawns[TargetIndex];
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterHordeSight), false, TargetPawn);
+
+	FShooterHordeSightTrace& Trace = PendingSightTraces.AddDefaulted_GetRef();
+	Trace.Handle = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Test, Start, TargetPawn->GetActorLocation(), ECC_Visibility, QueryParams);
+	Trace.Entity = Entity;
+
+	INC_DWORD_STAT(STAT_ShooterHordeSightTraces);
+
+	return true;
+}
+
+void UShooterHordeSubsystem::AddPromotionCandidate(const FMassEntityHandle& Entity, float DistanceSq)
+{
+	Candidates.Add({ Entity, DistanceSq });
+}
+
+float UShooterHordeSubsystem::SelectShooters()
+{
+	const int32 NumFreeSlots = FMath::Min(GShooterHordeMaxPromoted - PromotedNPCs.Num(), Candidates.Num());
+
+	if (NumFreeSlots <= 0)
+	{
+		return -1.0f;
+	}
+
+	Candidates.Sort([](const FShooterHordeCandidate& A, const FShooterHordeCandidate& B) { return A.DistanceSq < B.DistanceSq; });
+
+	return Candidates[NumFreeSlots - 1].DistanceSq;
+}
+
+void UShooterHordeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Collection.InitializeDependency<UMassEntitySubsystem>();
+
+	FMassEntityManager* EntityManager = GetEntityManager();
+
+	if (!EntityManager)
+	{
+		return;
+	}
+
+	// every horde entity has the same composition. The tuning is shared per NPC class
+	Archetype = EntityManager->CreateArchetype({
+		FShooterHordeLocationFragment::StaticStruct(),
+		FShooterHordeHealthFragment::StaticStruct(),
+		FShooterHordeTargetFragment::StaticStruct(),
+		FShooterHordeFireFragment::StaticStruct(),
+		FShooterHordeTuningFragment::StaticStruct()
+	});
+
+	// targeting feeds both movement and firing, so it runs first
+	Processors.Add(NewObject<UShooterHordeTargetProcessor>(this));
+	Processors.Add(NewObject<UShooterHordeMovementProcessor>(this));
+	Processors.Add(NewObject<UShooterHordeFireProcessor>(this));
+
+	for (UMassProcessor* Processor : Processors)
+	{
+		Processor->CallInitialize(this, EntityManager->AsShared());
+	}
+}
+
+void UShooterHordeSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SET_DWORD_STAT(STAT_ShooterHordeEntities, Entities.Num());
+	SET_DWORD_STAT(STAT_ShooterHordePromoted, PromotedNPCs.Num());
+
+	// the horde is simulated by the server only
+	if (GetWorld()->GetNetMode() == NM_Client || (Entities.Num() == 0 && PromotedNPCs.Num() == 0))
+	{
+		return;
+	}
+
+	FMassEntityManager* EntityManager = GetEntityManager();
+
+	if (!EntityManager)
+	{
+		return;
+	}
+
+	GatherTargets();
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ShooterHordeSimulation);
+
+		// apply last frame's line of sight traces before the entities decide whether to fire
+		GatherSightResults(*EntityManager);
+
+		Candidates.Reset();
+		NumShots = 0;
+		NumSightTraces = 0;
+		Hitscan = GetWorld()->GetSubsystem<UShooterHitscanSubsystem>();
+
+		FMassProcessingContext ProcessingContext(EntityManager->AsShared(), DeltaTime);
+
+		for (UMassProcessor* Processor : Processors)
+		{
+			UE::Mass::Executor::Run(*Processor, ProcessingContext);
+		}
+
+		Hitscan = nullptr;
+	}
+
+	TimeUntilPromotion -= DeltaTime;
+
+	if (TimeUntilPromotion <= 0.0f)
+	{
+		TimeUntilPromotion = GShooterHordePromotionInterval;
+
+		SCOPE_CYCLE_COUNTER(STAT_ShooterHordePromotion);
+
+		UpdatePromotions(*EntityManager);
+	}
+}
+
+TStatId UShooterHordeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterHordeSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterHordeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FMassEntityManager* UShooterHordeSubsystem::GetEntityManager() const
+{
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+
+	return EntitySubsystem ? &EntitySubsystem->GetMutableEntityManager() : nullptr;
+}
+
+const FMassArchetypeSharedFragmentValues& UShooterHordeSubsystem::GetSharedValues(FMassEntityManager& EntityManager, const TSubclassOf<AShooterNPC>& NPCClass)
+{
+	if (const FMassArchetypeSharedFragmentValues* SharedValues = SharedValuesByClass.Find(NPCClass))
+	{
+		return *SharedValues;
+	}
+
+	FMassArchetypeSharedFragmentValues& SharedValues = SharedValuesByClass.Add(NPCClass);
+	SharedValues.AddConstSharedFragment(EntityManager.GetOrCreateConstSharedFragment(FShooterHordeTuningFragment::FromNPCClass(NPCClass)));
+	SharedValues.Sort();
+
+	return SharedValues;
+}
+
+void UShooterHordeSubsystem::CreateEntities(FMassEntityManager& EntityManager, const TSubclassOf<AShooterNPC>& NPCClass, TConstArrayView<FVector> Locations, float HP)
+{
+	const FMassArchetypeSharedFragmentValues& SharedValues = GetSharedValues(EntityManager, NPCClass);
+	const float MaxHP = NPCClass->GetDefaultObject<AShooterNPC>()->CurrentHP;
+
+	const int32 FirstNew = Entities.Num();
+
+	// the creation context notifies observers once it goes out of scope, after the fragments are filled in
+	TSharedRef<FMassEntityManager::FEntityCreationContext> CreationContext = EntityManager.BatchCreateEntities(Archetype, SharedValues, Locations.Num(), Entities);
+
+	for (int32 i = 0; i < Locations.Num(); ++i)
+	{
+		const FMassEntityHandle Entity = Entities[FirstNew + i];
+
+		EntityManager.GetFragmentDataChecked<FShooterHordeLocationFragment>(Entity).Location = Locations[i];
+		EntityManager.GetFragmentDataChecked<FShooterHordeHealthFragment>(Entity).HP = HP >= 0.0f ? HP : MaxHP;
+
+		// stagger the first shots so the horde doesn't fire in volleys
+		FShooterHordeFireFragment& Fire = EntityManager.GetFragmentDataChecked<FShooterHordeFireFragment>(Entity);
+		Fire.Seed = GetTypeHash(Entity);
+		Fire.Cooldown = FMath::FRand();
+	}
+}
+
+void UShooterHordeSubsystem::GatherTargets()
+{
+	TargetLocations.Reset();
+	TargetPawns.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		const APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+
+		if (Pawn && !UShooterDamageSubsystem::IsTargetDead(Pawn))
+		{
+			TargetLocations.Add(Pawn->GetActorLocation());
+			TargetPawns.Add(Pawn);
+		}
+	}
+}
+
+void UShooterHordeSubsystem::GatherSightResults(FMassEntityManager& EntityManager)
+{
+	UWorld* World = GetWorld();
+
+	for (int32 i = PendingSightTraces.Num() - 1; i >= 0; --i)
+	{
+		const FShooterHordeSightTrace& Trace = PendingSightTraces[i];
+
+		bool bClear = false;
+		bool bDropped = false;
+
+		if (World->QueryTraceData(Trace.Handle, SightTraceData))
+		{
+			bClear = !SightTraceData.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+
+		} else if (!World->IsTraceHandleValid(Trace.Handle, false)) {
+
+			// the trace was dropped, so ask again without changing the verdict
+			bDropped = true;
+
+		} else {
+
+			// not ready yet
+			continue;
+
+		}
+
+		// the entity may have been promoted or destroyed while the trace was in flight
+		if (EntityManager.IsEntityValid(Trace.Entity))
+		{
+			FShooterHordeFireFragment& Fire = EntityManager.GetFragmentDataChecked<FShooterHordeFireFragment>(Trace.Entity);
+			Fire.bSightPending = false;
+
+			if (!bDropped)
+			{
+				Fire.bHasLineOfSight = bClear;
+				Fire.SightAge = 0.0f;
+			}
+		}
+
+		PendingSightTraces.RemoveAtSwap(i, EAllowShrinking::No);
+	}
+}
+
+bool UShooterHordeSubsystem::FindPromotionLocation(const FVector& FeetLocation, const FShooterHordeTuningFragment& Tuning, FVector& OutLocation) const
+{
+	UWorld* World = GetWorld();
+
+	// entities walk through geometry at their spawn height, so look for the navmesh under them first, then the ground
+	FVector GroundLocation;
+	bool bFoundGround = false;
+
+	if (const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World))
+	{
+		FNavLocation NavLocation;
+
+		if (NavSys->ProjectPointToNavigation(FeetLocation, NavLocation, FVector(Tuning.CapsuleRadius * 2.0f, Tuning.CapsuleRadius * 2.0f, GShooterHordeGroundSearchHeight)))
+		{
+			GroundLocation = NavLocation.Location;
+			bFoundGround = true;
+		}
+	}
+
+	if (!bFoundGround)
+	{
+		FHitResult Hit;
+
+		const FVector TraceStart = FeetLocation + FVector(0.0f, 0.0f, GShooterHordeGroundSearchHeight);
+		const FVector TraceEnd = FeetLocation - FVector(0.0f, 0.0f, GShooterHordeGroundSearchHeight);
+
+		if (World->LineTraceSingleByObjectType(Hit, TraceStart, TraceEnd, FCollisionObjectQueryParams(ECC_WorldStatic)))
+		{
+			GroundLocation = Hit.ImpactPoint;
+			bFoundGround = true;
+		}
+	}
+
+	if (!bFoundGround)
+	{
+		return false;
+	}
+
+	// lift the capsule slightly off the ground, and make sure it isn't inside a wall or another pawn
+	OutLocation = GroundLocation + FVector(0.0f, 0.0f, Tuning.CapsuleHalfHeight + 2.0f);
+
+	const FCollisionShape Capsule = FCollisionShape::MakeCapsule(Tuning.CapsuleRadius, Tuning.CapsuleHalfHeight);
+
+	return !World->OverlapBlockingTestByChannel(OutLocation, FQuat::Identity, ECC_Pawn, Capsule, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterHordePromotion), false));
+}
+
+void UShooterHordeSubsystem::UpdatePromotions(FMassEntityManager& EntityManager)
+{
+	// forget promoted NPCs that died or went away. Dead ones go through the regular NPC death flow
+	PromotedNPCs.RemoveAllSwap([](const TWeakObjectPtr<AShooterNPC>& NPC) { return !NPC.IsValid() || NPC->IsDead(); }, EAllowShrinking::No);
+
+	// demote the NPCs every player has left behind
+	const float DemoteDistanceSq = FMath::Square(FMath::Max(GShooterHordeDemoteDistance, GShooterHordePromoteDistance));
+
+	for (int32 i = PromotedNPCs.Num() - 1; i >= 0; --i)
+	{
+		AShooterNPC* NPC = PromotedNPCs[i].Get();
+		const FVector Location = NPC->GetActorLocation();
+
+		const bool bNearPlayer = TargetLocations.ContainsByPredicate([&Location, DemoteDistanceSq](const FVector& TargetLocation)
+		{
+			return FVector::DistSquared(Location, TargetLocation) <= DemoteDistanceSq;
+		});
+
+		if (!bNearPlayer)
+		{
+			PromotedNPCs.RemoveAtSwap(i, EAllowShrinking::No);
+			DemoteNPC(EntityManager, NPC);
+		}
+	}
+
+	// promote the nearest candidates into the free slots
+	const int32 NumPromotions = FMath::Min(GShooterHordeMaxPromoted - PromotedNPCs.Num(), GShooterHordeMaxPromotionsPerUpdate);
+
+	if (NumPromotions <= 0 || Candidates.Num() == 0)
+	{
+		return;
+	}
+
+	Candidates.Sort([](const FShooterHordeCandidate& A, const FShooterHordeCandidate& B) { return A.DistanceSq < B.DistanceSq; });
+
+	// candidates with no room on the ground are skipped, within a bounded number of attempts
+	const int32 MaxAttempts = FMath::Min(NumPromotions * 2, Candidates.Num());
+	int32 NumPromoted = 0;
+
+	for (int32 i = 0; i < MaxAttempts && NumPromoted < NumPromotions; ++i)
+	{
+		if (AShooterNPC* NPC = PromoteEntity(EntityManager, Candidates[i].Entity))
+		{
+			PromotedNPCs.Add(NPC);
+			++NumPromoted;
+		}
+	}
+}
+
+AShooterNPC* UShooterHordeSubsystem::PromoteEntity(FMassEntityManager& EntityManager, const FMassEntityHandle& Entity)
+{
+	if (!EntityManager.IsEntityValid(Entity))
+	{
+		return nullptr;
+	}
+
+	const FShooterHordeTuningFragment& Tuning = EntityManager.GetConstSharedFragmentDataChecked<FShooterHordeTuningFragment>(Entity);
+	const FShooterHordeLocationFragment& Location = EntityManager.GetFragmentDataChecked<FShooterHordeLocationFragment>(Entity);
+	const float HP = EntityManager.GetFragmentDataChecked<FShooterHordeHealthFragment>(Entity).HP;
+
+	// put the NPC back on the ground. Entities stuck in geometry stay in the horde until they walk out of it
+	FVector SpawnLocation;
+
+	if (!FindPromotionLocation(Location.Location, Tuning, SpawnLocation))
+	{
+		return nullptr;
+	}
+
+	// face the direction the entity was walking in
+	const FRotator Rotation = Location.Velocity.IsNearlyZero() ? FRotator::ZeroRotator : Location.Velocity.Rotation();
+	const FTransform SpawnTransform(Rotation, SpawnLocation);
+
+	// recycle a parked NPC if there is one
+	UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>();
+	AShooterNPC* NPC = Pool ? Pool->AcquireNPC(Tuning.NPCClass, SpawnTransform) : nullptr;
+
+	// leave the entity in the horde and try again on a later pass
+	if (!NPC)
+	{
+		return nullptr;
+	}
+
+	// carry the damage the entity has taken over to the actor
+	NPC->SetCurrentHP(HP);
+
+	EntityManager.DestroyEntity(Entity);
+	Entities.RemoveSwap(Entity, EAllowShrinking::No);
+
+	return NPC;
+}
+
+void UShooterHordeSubsystem::DemoteNPC(FMassEntityManager& EntityManager, AShooterNPC* NPC)
+{
+	const FVector FeetLocation = NPC->GetActorLocation() - FVector(0.0f, 0.0f, NPC->GetSimpleCollisionHalfHeight());
+
+	CreateEntities(EntityManager, NPC->GetClass(), MakeArrayView(&FeetLocation, 1), NPC->CurrentHP);
+
+	// park the NPC along with its controller and weapon, so the next promotion can reuse it
+	if (UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>())
+	{
+		Pool->ReleaseNPC(NPC);
+
+	} else {
+
+		// the controller isn't destroyed with its pawn
+		if (AController* Controller = NPC->GetController())
+		{
+			Controller->Destroy();
+		}
+
+		NPC->Destroy();
+
+	}
+}
@@ -0,0 +1,187 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MassEntityTypes.h"
+#include "MassArchetypeTypes.h"
+#include "WorldCollision.h"
+#include "ShooterHorde.generated.h"
+
+class AShooterNPC;
+class APawn;
+class UMassProcessor;
+class UShooterHitscanSubsystem;
+struct FMassEntityManager;
+struct FShooterHordeTuningFragment;
+
+/**
+ *  A horde entity close enough to a player to be promoted
+ */
+struct FShooterHordeCandidate
+{
+	/** Candidate entity */
+	FMassEntityHandle Entity;
+
+	/** Squared distance to the nearest player */
+	float DistanceSq = 0.0f;
+};
+
+/**
+ *  An async line of sight trace issued for a horde entity
+ */
+struct FShooterHordeSightTrace
+{
+	/** Handle of the async trace */
+	FTraceHandle Handle;
+
+	/** Entity the trace was issued for */
+	FMassEntityHandle Entity;
+};
+
+/**
+ *  World subsystem that runs horde-scale enemy counts as Mass entities
+ *  Horde entities carry only a location, HP, a target and refire state, and are moved and fired in batched
+ *  processors using the tuning of their AShooterNPC class. The entities nearest to the players are promoted
+ *  to full AShooterNPC actors with their remaining HP, and promoted NPCs that fall behind are demoted back.
+ *  Only runs on the server. Entities aren't rendered and can't be hit until they're promoted.
+ */
+UCLASS()
+class FPS251106_API UShooterHordeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Processors run every frame, in order */
+	UPROPERTY()
+	TArray<TObjectPtr<UMassProcessor>> Processors;
+
+	/** Archetype shared by every horde entity */
+	FMassArchetypeHandle Archetype;
+
+	/** Shared tuning by NPC class */
+	TMap<TSubclassOf<AShooterNPC>, FMassArchetypeSharedFragmentValues> SharedValuesByClass;
+
+	/** Live horde entities */
+	TArray<FMassEntityHandle> Entities;
+
+	/** NPCs promoted from horde entities */
+	TArray<TWeakObjectPtr<AShooterNPC>> PromotedNPCs;
+
+	/** Frame scratch: locations of the living player pawns */
+	TArray<FVector> TargetLocations;
+
+	/** Frame scratch: living player pawns, matching the target locations */
+	TArray<const APawn*> TargetPawns;
+
+	/** Line of sight traces waiting for their results */
+	TArray<FShooterHordeSightTrace> PendingSightTraces;
+
+	/** Frame scratch: trace results */
+	FTraceDatum SightTraceData;
+
+	/** Frame scratch: entities close enough to be promoted */
+	TArray<FShooterHordeCandidate> Candidates;
+
+	/** Frame scratch: hitscan subsystem shots are queued with */
+	UPROPERTY(Transient)
+	TObjectPtr<UShooterHitscanSubsystem> Hitscan;
+
+	/** Number of shots queued this frame */
+	int32 NumShots = 0;
+
+	/** Number of line of sight traces issued this frame */
+	int32 NumSightTraces = 0;
+
+	/** Time left until the next promotion pass */
+	float TimeUntilPromotion = 0.0f;
+
+public:
+
+	/**
+	 *  Spawns horde entities of the given NPC class on a ring around a location
+	 *  @param NPCClass Class the entities get their tuning from, and are promoted to
+	 *  @param Center Feet level location to spawn around
+	 *  @param Radius Radius of the ring
+	 *  @param Count Number of entities to spawn
+	 *  @return Number of entities spawned
+	 */
+	int32 SpawnHorde(TSubclassOf<AShooterNPC> NPCClass, const FVector& Center, float Radius, int32 Count);
+
+	/** Destroys every horde entity. Promoted NPCs are left alone */
+	void ClearHorde();
+
+	/** Returns the number of live horde entities, not counting promoted NPCs */
+	int32 GetNumEntities() const { return Entities.Num(); }
+
+	/** Returns the number of promoted NPCs */
+	int32 GetNumPromoted() const { return PromotedNPCs.Num(); }
+
+	/** Returns the locations of the living player pawns this frame */
+	const TArray<FVector>& GetTargetLocations() const { return TargetLocations; }
+
+	/** Returns the distance to a player under which entities are candidates for promotion */
+	float GetPromoteDistance() const;
+
+	/** Queues a horde shot with the hitscan subsystem. Returns false if the frame's shot budget is spent */
+	bool QueueShot(const FVector& Start, const FVector& End, const FShooterHordeTuningFragment& Tuning);
+
+	/**
+	 *  Issues an async line of sight trace from a horde entity to its target
+	 *  The result is written to the entity's fire fragment once it comes back
+	 *  @return False if the frame's trace budget is spent
+	 */
+	bool RequestLineOfSight(const FMassEntityHandle& Entity, const FVector& Start, int32 TargetIndex);
+
+	/** Adds an entity to the frame's promotion candidates */
+	void AddPromotionCandidate(const FMassEntityHandle& Entity, float DistanceSq);
+
+	/**
+	 *  Sorts the frame's promotion candidates and picks the ones that hold a free promotion slot
+	 *  Only those entities fire, so there are never more shooters than the promoted NPC cap allows
+	 *  @return Squared distance to a player under which entities hold a slot. Negative if there are no free slots
+	 */
+	float SelectShooters();
+
+	/** Subsystem initialization */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Returns the world's Mass entity manager */
+	FMassEntityManager* GetEntityManager() const;
+
+	/** Returns the shared fragment values for entities of an NPC class, building the tuning on first use */
+	const FMassArchetypeSharedFragmentValues& GetSharedValues(FMassEntityManager& EntityManager, const TSubclassOf<AShooterNPC>& NPCClass);
+
+	/** Creates one entity per location, with the given HP. Negative HP uses the class max HP */
+	void CreateEntities(FMassEntityManager& EntityManager, const TSubclassOf<AShooterNPC>& NPCClass, TConstArrayView<FVector> Locations, float HP);
+
+	/** Collects the locations of the living player pawns */
+	void GatherTargets();
+
+	/** Writes the line of sight traces that came back to their entities */
+	void GatherSightResults(FMassEntityManager& EntityManager);
+
+	/** Finds room on the ground for an NPC promoted from an entity. Returns false if there's none */
+	bool FindPromotionLocation(const FVector& FeetLocation, const FShooterHordeTuningFragment& Tuning, FVector& OutLocation) const;
+
+	/** Demotes promoted NPCs that fell behind, and promotes the nearest candidates */
+	void UpdatePromotions(FMassEntityManager& EntityManager);
+
+	/** Swaps a horde entity for a full NPC actor, if there's room for it on the ground */
+	AShooterNPC* PromoteEntity(FMassEntityManager& EntityManager, const FMassEntityHandle& Entity);
+
+	/** Swaps a promoted NPC back for a horde entity */
+	void DemoteNPC(FMassEntityManager& EntityManager, AShooterNPC* NPC);
+};
@@ -0,0 +1,146 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "ShooterHitParams.h"
+#include "ShooterHordeFragments.generated.h"
+
+class AShooterNPC;
+
+/**
+ *  Location and velocity of a horde entity
+ *  Horde entities don't collide or follow the floor. They keep the height they were spawned at, and are put back
+ *  on the ground when they're promoted
+ */
+USTRUCT()
+struct FShooterHordeLocationFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** World location of the entity's feet */
+	FVector Location = FVector::ZeroVector;
+
+	/** Velocity applied during the last movement step */
+	FVector Velocity = FVector::ZeroVector;
+};
+
+/**
+ *  Remaining HP of a horde entity. Carried over when the entity is promoted to an actor and back
+ */
+USTRUCT()
+struct FShooterHordeHealthFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Current HP */
+	float HP = 100.0f;
+};
+
+/**
+ *  Player currently targeted by a horde entity
+ */
+USTRUCT()
+struct FShooterHordeTargetFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Index of the target in the horde subsystem's frame target list, or INDEX_NONE */
+	int32 TargetIndex = INDEX_NONE;
+
+	/** Location of the target */
+	FVector TargetLocation = FVector::ZeroVector;
+
+	/** Squared distance to the target */
+	float DistanceSq = TNumericLimits<float>::Max();
+};
+
+/**
+ *  Refire state of a horde entity
+ */
+USTRUCT()
+struct FShooterHordeFireFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Time left until the entity can shoot again */
+	float Cooldown = 0.0f;
+
+	/** Index of the next shot. Seeds the shot's aim error */
+	uint16 ShotIndex = 0;
+
+	/** Per-entity random seed */
+	uint32 Seed = 0;
+
+	/** Time since the line of sight to the target was last refreshed */
+	float SightAge = TNumericLimits<float>::Max();
+
+	/** If true, the last line of sight trace to the target was unobstructed */
+	bool bHasLineOfSight = false;
+
+	/** If true, a line of sight trace is in flight for this entity */
+	bool bSightPending = false;
+};
+
+/**
+ *  Tuning shared by every horde entity of an NPC class
+ *  Built from the NPC class defaults and the defaults of its weapon class, so horde entities aim, shoot and
+ *  deal damage like the AShooterNPC they get promoted to.
+ */
+USTRUCT()
+struct FShooterHordeTuningFragment : public FMassConstSharedFragment
+{
+	GENERATED_BODY()
+
+	/** NPC class the entities are promoted to */
+	UPROPERTY()
+	TSubclassOf<AShooterNPC> NPCClass;
+
+	/** Walk speed */
+	UPROPERTY()
+	float MoveSpeed = 500.0f;
+
+	/** Height of the eyes above the feet. Shots start here */
+	UPROPERTY()
+	float EyeHeight = 64.0f;
+
+	/** Half height of the NPC capsule. Promoted NPCs are spawned this far above the feet */
+	UPROPERTY()
+	float CapsuleHalfHeight = 96.0f;
+
+	/** Radius of the NPC capsule. Promoted NPCs need this much room */
+	UPROPERTY()
+	float CapsuleRadius = 42.0f;
+
+	/** Max range for aiming */
+	UPROPERTY()
+	float AimRange = 10000.0f;
+
+	/** Aim cone half-angle, in degrees. Combines the NPC aim variance and the weapon spread */
+	UPROPERTY()
+	float AimVarianceHalfAngle = 10.0f;
+
+	/** Minimum vertical offset from the target center to aim at */
+	UPROPERTY()
+	float MinAimOffsetZ = -35.0f;
+
+	/** Maximum vertical offset from the target center to aim at */
+	UPROPERTY()
+	float MaxAimOffsetZ = -60.0f;
+
+	/** Time between shots */
+	UPROPERTY()
+	float RefireRate = 0.5f;
+
+	/** Channel shots trace on */
+	UPROPERTY()
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	/** Damage settings of a single shot */
+	UPROPERTY()
+	FShooterHitParams HitParams;
+
+	/** Builds the tuning from the defaults of an NPC class */
+	static FShooterHordeTuningFragment FromNPCClass(const TSubclassOf<AShooterNPC>& InNPCClass);
+};
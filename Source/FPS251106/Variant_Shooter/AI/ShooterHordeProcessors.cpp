@@ -0,0 +1,224 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterHordeProcessors.h"
+#include "ShooterHordeFragments.h"
+#include "ShooterHorde.h"
+#include "MassExecutionContext.h"
+#include "HAL/IConsoleManager.h"
+
+static float GShooterHordeEngageRange = 1500.0f;
+static FAutoConsoleVariableRef CVarShooterHordeEngageRange(
+	TEXT("Shooter.Horde.EngageRange"),
+	GShooterHordeEngageRange,
+	TEXT("Distance at which horde entities stop walking towards their target"),
+	ECVF_Default
+);
+
+static float GShooterHordeSightInterval = 0.5f;
+static FAutoConsoleVariableRef CVarShooterHordeSightInterval(
+	TEXT("Shooter.Horde.SightInterval"),
+	GShooterHordeSightInterval,
+	TEXT("Time in seconds between two line of sight checks of a horde entity in fire range of its target"),
+	ECVF_Default
+);
+
+/** Salt for the horde aim error, so it doesn't correlate with the entity seed itself */
+static constexpr uint32 HordeAimSalt = 0x48524445;
+
+UShooterHordeTargetProcessor::UShooterHordeTargetProcessor()
+	: EntityQuery(*this)
+{
+	// the horde subsystem runs this processor itself
+	bAutoRegisterWithProcessingPhases = false;
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+}
+
+void UShooterHordeTargetProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
+{
+	EntityQuery.AddRequirement<FShooterHordeLocationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FShooterHordeTargetFragment>(EMassFragmentAccess::ReadWrite);
+}
+
+void UShooterHordeTargetProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	UShooterHordeSubsystem* Horde = CastChecked<UShooterHordeSubsystem>(GetOuter());
+
+	const TArray<FVector>& TargetLocations = Horde->GetTargetLocations();
+	const float PromoteDistanceSq = FMath::Square(Horde->GetPromoteDistance());
+
+	EntityQuery.ForEachEntityChunk(Context, [&TargetLocations, PromoteDistanceSq, Horde](FMassExecutionContext& Context)
+	{
+		const TConstArrayView<FShooterHordeLocationFragment> Locations = Context.GetFragmentView<FShooterHordeLocationFragment>();
+		const TArrayView<FShooterHordeTargetFragment> Targets = Context.GetMutableFragmentView<FShooterHordeTargetFragment>();
+
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			const FVector& Location = Locations[EntityIndex].Location;
+			FShooterHordeTargetFragment& Target = Targets[EntityIndex];
+
+			Target.TargetIndex = INDEX_NONE;
+			Target.DistanceSq = TNumericLimits<float>::Max();
+
+			// the player count is small, so a linear scan beats any spatial structure
+			for (int32 TargetIndex = 0; TargetIndex < TargetLocations.Num(); ++TargetIndex)
+			{
+				const float DistSq = FVector::DistSquared(Location, TargetLocations[TargetIndex]);
+
+				if (DistSq < Target.DistanceSq)
+				{
+					Target.TargetIndex = TargetIndex;
+					Target.DistanceSq = DistSq;
+				}
+			}
+
+			if (Target.TargetIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+			Target.TargetLocation = TargetLocations[Target.TargetIndex];
+
+			if (Target.DistanceSq <= PromoteDistanceSq)
+			{
+				Horde->AddPromotionCandidate(Context.GetEntity(EntityIndex), Target.DistanceSq);
+			}
+		}
+	});
+}
+
+UShooterHordeMovementProcessor::UShooterHordeMovementProcessor()
+	: EntityQuery(*this)
+{
+	// the horde subsystem runs this processor itself
+	bAutoRegisterWithProcessingPhases = false;
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+}
+
+void UShooterHordeMovementProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
+{
+	EntityQuery.AddRequirement<FShooterHordeLocationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FShooterHordeTargetFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddConstSharedRequirement<FShooterHordeTuningFragment>();
+}
+
+void UShooterHordeMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	const float EngageRangeSq = FMath::Square(GShooterHordeEngageRange);
+
+	EntityQuery.ForEachEntityChunk(Context, [EngageRangeSq](FMassExecutionContext& Context)
+	{
+		const FShooterHordeTuningFragment& Tuning = Context.GetConstSharedFragment<FShooterHordeTuningFragment>();
+		const float Step = Tuning.MoveSpeed * Context.GetDeltaTimeSeconds();
+
+		const TArrayView<FShooterHordeLocationFragment> Locations = Context.GetMutableFragmentView<FShooterHordeLocationFragment>();
+		const TConstArrayView<FShooterHordeTargetFragment> Targets = Context.GetFragmentView<FShooterHordeTargetFragment>();
+
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			FShooterHordeLocationFragment& Location = Locations[EntityIndex];
+			const FShooterHordeTargetFragment& Target = Targets[EntityIndex];
+
+			// hold position without a target, or once in range
+			if (Target.TargetIndex == INDEX_NONE || Target.DistanceSq <= EngageRangeSq)
+			{
+				Location.Velocity = FVector::ZeroVector;
+				continue;
+			}
+
+			// walk on the plane the entity was spawned on
+			FVector Direction = Target.TargetLocation - Location.Location;
+			Direction.Z = 0.0f;
+			Direction = Direction.GetSafeNormal();
+
+			Location.Velocity = Direction * Tuning.MoveSpeed;
+			Location.Location += Direction * Step;
+		}
+	});
+}
+
+UShooterHordeFireProcessor::UShooterHordeFireProcessor()
+	: EntityQuery(*this)
+{
+	// the horde subsystem runs this processor itself. Shots are queued with game thread subsystems
+	bAutoRegisterWithProcessingPhases = false;
+	bRequiresGameThreadExecution = true;
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+}
+
+void UShooterHordeFireProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
+{
+	EntityQuery.AddRequirement<FShooterHordeLocationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FShooterHordeTargetFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FShooterHordeFireFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddConstSharedRequirement<FShooterHordeTuningFragment>();
+}
+
+void UShooterHordeFireProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	UShooterHordeSubsystem* Horde = CastChecked<UShooterHordeSubsystem>(GetOuter());
+
+	// entities can't be seen or hit, so only the ones next in line for a free promotion slot fire.
+	// Together with the promoted NPCs, that's never more shooters than the promoted NPC cap
+	const float ShooterDistanceSq = Horde->SelectShooters();
+
+	EntityQuery.ForEachEntityChunk(Context, [Horde, ShooterDistanceSq](FMassExecutionContext& Context)
+	{
+		const FShooterHordeTuningFragment& Tuning = Context.GetConstSharedFragment<FShooterHordeTuningFragment>();
+		const float DeltaTime = Context.GetDeltaTimeSeconds();
+
+		const float FireRangeSq = FMath::Min(FMath::Square(Tuning.AimRange), ShooterDistanceSq);
+		const float AimVarianceRadians = FMath::DegreesToRadians(Tuning.AimVarianceHalfAngle);
+
+		const TConstArrayView<FShooterHordeLocationFragment> Locations = Context.GetFragmentView<FShooterHordeLocationFragment>();
+		const TConstArrayView<FShooterHordeTargetFragment> Targets = Context.GetFragmentView<FShooterHordeTargetFragment>();
+		const TArrayView<FShooterHordeFireFragment> Fires = Context.GetMutableFragmentView<FShooterHordeFireFragment>();
+
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			FShooterHordeFireFragment& Fire = Fires[EntityIndex];
+			const FShooterHordeTargetFragment& Target = Targets[EntityIndex];
+
+			Fire.Cooldown = FMath::Max(Fire.Cooldown - DeltaTime, 0.0f);
+			Fire.SightAge += DeltaTime;
+
+			if (Target.TargetIndex == INDEX_NONE || Target.DistanceSq > FireRangeSq)
+			{
+				// a target coming back into range has to be seen again before it's shot at
+				Fire.bHasLineOfSight = false;
+				Fire.SightAge = GShooterHordeSightInterval;
+				continue;
+			}
+
+			const FVector Start = Locations[EntityIndex].Location + FVector(0.0f, 0.0f, Tuning.EyeHeight);
+
+			// keep the line of sight fresh. The trace comes back on a later frame, or is retried if the budget is spent
+			if (!Fire.bSightPending && Fire.SightAge >= GShooterHordeSightInterval)
+			{
+				Fire.bSightPending = Horde->RequestLineOfSight(Context.GetEntity(EntityIndex), Start, Target.TargetIndex);
+			}
+
+			if (Fire.Cooldown > 0.0f || !Fire.bHasLineOfSight)
+			{
+				continue;
+			}
+
+			// aim like an NPC: pick a vertical offset on the target, then apply the aim cone, all from the shot's own stream
+			const FRandomStream AimStream(static_cast<int32>(HashCombineFast(HashCombineFast(Fire.Seed, Fire.ShotIndex), HordeAimSalt)));
+
+			FVector AimTarget = Target.TargetLocation;
+			AimTarget.Z += AimStream.FRandRange(Tuning.MinAimOffsetZ, Tuning.MaxAimOffsetZ);
+
+			const FVector AimDir = AimStream.VRandCone((AimTarget - Start).GetSafeNormal(), AimVarianceRadians);
+
+			// out of shot budget. Stay ready and try again next frame
+			if (!Horde->QueueShot(Start, Start + AimDir * Tuning.AimRange, Tuning))
+			{
+				continue;
+			}
+
+			Fire.Cooldown = Tuning.RefireRate;
+			++Fire.ShotIndex;
+		}
+	});
+}
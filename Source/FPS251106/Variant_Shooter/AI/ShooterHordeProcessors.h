@@ -0,0 +1,88 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityQuery.h"
+#include "ShooterHordeProcessors.generated.h"
+
+/**
+ *  Picks the nearest player for every horde entity, and collects the entities close enough to be promoted
+ *  Run by the horde subsystem, not by the Mass processing phases.
+ */
+UCLASS()
+class FPS251106_API UShooterHordeTargetProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Entities with a location and a target */
+	FMassEntityQuery EntityQuery;
+
+public:
+
+	UShooterHordeTargetProcessor();
+
+protected:
+
+	//~Begin UMassProcessor interface
+	virtual void ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager) override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~End UMassProcessor interface
+};
+
+/**
+ *  Walks every horde entity straight towards its target until it's within engage range
+ *  Run by the horde subsystem, not by the Mass processing phases.
+ */
+UCLASS()
+class FPS251106_API UShooterHordeMovementProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Entities with a location, a target and tuning */
+	FMassEntityQuery EntityQuery;
+
+public:
+
+	UShooterHordeMovementProcessor();
+
+protected:
+
+	//~Begin UMassProcessor interface
+	virtual void ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager) override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~End UMassProcessor interface
+};
+
+/**
+ *  Fires the shots of every horde entity that has a target in range and is off cooldown
+ *  Only entities within the promote distance fire, and only while their last line of sight check to the target
+ *  came back clear. Shots are handed to the horde subsystem, which queues them with the batched hitscan subsystem.
+ *  Run by the horde subsystem, not by the Mass processing phases.
+ */
+UCLASS()
+class FPS251106_API UShooterHordeFireProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Entities with a location, a target, refire state and tuning */
+	FMassEntityQuery EntityQuery;
+
+public:
+
+	UShooterHordeFireProcessor();
+
+protected:
+
+	//~Begin UMassProcessor interface
+	virtual void ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager) override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	//~End UMassProcessor interface
+};
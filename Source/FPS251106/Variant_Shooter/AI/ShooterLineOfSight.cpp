@@ -0,0 +1,267 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterLineOfSight.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Line of Sight Refresh"), STAT_ShooterLineOfSightRefresh, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Line of Sight Queries"), STAT_ShooterLineOfSightQueries, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Line of Sight Sync Traces"), STAT_ShooterLineOfSightSyncTraces, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Line of Sight Async Traces"), STAT_ShooterLineOfSightAsyncTraces, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Line of Sight Pairs"), STAT_ShooterLineOfSightPairs, STATGROUP_Shooter);
+
+static int32 GShooterLineOfSightCacheFrames = 4;
+static FAutoConsoleVariableRef CVarShooterLineOfSightCacheFrames(
+	TEXT("Shooter.LineOfSight.CacheFrames"),
+	GShooterLineOfSightCacheFrames,
+	TEXT("Number of frames a line of sight verdict stays fresh for pairs right next to each other"),
+	ECVF_Default
+);
+
+static float GShooterLineOfSightFramesPerMeter = 0.1f;
+static FAutoConsoleVariableRef CVarShooterLineOfSightFramesPerMeter(
+	TEXT("Shooter.LineOfSight.FramesPerMeter"),
+	GShooterLineOfSightFramesPerMeter,
+	TEXT("Extra frames a line of sight verdict stays fresh for every meter between the viewer and the target"),
+	ECVF_Default
+);
+
+static int32 GShooterLineOfSightMaxCacheFrames = 30;
+static FAutoConsoleVariableRef CVarShooterLineOfSightMaxCacheFrames(
+	TEXT("Shooter.LineOfSight.MaxCacheFrames"),
+	GShooterLineOfSightMaxCacheFrames,
+	TEXT("Max number of frames a line of sight verdict stays fresh, regardless of distance"),
+	ECVF_Default
+);
+
+static int32 GShooterLineOfSightEvictFrames = 60;
+static FAutoConsoleVariableRef CVarShooterLineOfSightEvictFrames(
+	TEXT("Shooter.LineOfSight.EvictFrames"),
+	GShooterLineOfSightEvictFrames,
+	TEXT("Number of frames without a request before a line of sight pair is dropped"),
+	ECVF_Default
+);
+
+bool UShooterLineOfSightSubsystem::HasLineOfSight(AActor* Viewer, const FVector& ViewLocation, AActor* Target, int32 NumChecks)
+{
+	INC_DWORD_STAT(STAT_ShooterLineOfSightQueries);
+
+	const TPair<FObjectKey, FObjectKey> Key(Viewer, Target);
+
+	FShooterLineOfSightEntry* Entry = Entries.Find(Key);
+
+	if (!Entry)
+	{
+		// new pair. Trace it right away so the first answer is accurate, and keep it fresh asynchronously after that
+		Entry = &Entries.Add(Key);
+		Entry->Viewer = Viewer;
+		Entry->Target = Target;
+		Entry->ViewLocation = ViewLocation;
+		Entry->NumChecks = NumChecks;
+		Entry->ResultFrame = GFrameCounter;
+		Entry->bHasLineOfSight = TraceLineOfSight(GetWorld(), Viewer, ViewLocation, Target, NumChecks);
+
+		INC_DWORD_STAT(STAT_ShooterLineOfSightSyncTraces);
+	}
+
+	// keep the pair alive and refresh it from the latest view
+	Entry->ViewLocation = ViewLocation;
+	Entry->NumChecks = NumChecks;
+	Entry->RequestFrame = GFrameCounter;
+
+	return Entry->bHasLineOfSight;
+}
+
+bool UShooterLineOfSightSubsystem::TraceLineOfSight(const UWorld* World, const AActor* Viewer, const FVector& ViewLocation, const AActor* Target, int32 NumChecks)
+{
+	// ignore the viewer and target. We want to ensure there's an unobstructed trace not counting them
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterLineOfSight), false, Viewer);
+	QueryParams.AddIgnoredActor(Target);
+
+	TArray<FVector, TInlineAllocator<8>> Ends;
+	GetTraceEnds(Target, NumChecks, Ends);
+
+	for (const FVector& End : Ends)
+	{
+		// we only need one unobstructed trace
+		if (!World->LineTraceTestByChannel(ViewLocation, End, ECC_Visibility, QueryParams))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UShooterLineOfSightSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SET_DWORD_STAT(STAT_ShooterLineOfSightPairs, Entries.Num());
+
+	if (Entries.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterLineOfSightRefresh);
+
+	// apply last frame's batch before deciding what's stale
+	GatherResults();
+
+	RefreshEntries();
+}
+
+TStatId UShooterLineOfSightSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterLineOfSightSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterLineOfSightSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterLineOfSightSubsystem::GatherResults()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 i = PendingTraces.Num() - 1; i >= 0; --i)
+	{
+		const FShooterLineOfSightTrace& Trace = PendingTraces[i];
+
+		bool bClear = false;
+		bool bDropped = false;
+
+		if (World->QueryTraceData(Trace.Handle, TraceData))
+		{
+			bClear = !TraceData.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+
+		} else if (!World->IsTraceHandleValid(Trace.Handle, false)) {
+
+			// the trace was dropped, so don't wait on it forever
+			bDropped = true;
+
+		} else {
+
+			// not ready yet
+			continue;
+
+		}
+
+		if (FShooterLineOfSightEntry* Entry = Entries.Find(Trace.Key))
+		{
+			Entry->bPendingClear |= bClear;
+			Entry->bPendingFailed |= bDropped;
+
+			// update the verdict once every trace for the pair is back
+			if (--Entry->PendingTraces == 0)
+			{
+				// a dropped trace can't prove the target is hidden, so only a clear trace or a full set of results counts
+				if (Entry->bPendingClear || !Entry->bPendingFailed)
+				{
+					Entry->bHasLineOfSight = Entry->bPendingClear;
+					Entry->ResultFrame = GFrameCounter;
+				}
+
+				Entry->bPendingClear = false;
+				Entry->bPendingFailed = false;
+			}
+		}
+
+		PendingTraces.RemoveAtSwap(i, EAllowShrinking::No);
+	}
+}
+
+void UShooterLineOfSightSubsystem::RefreshEntries()
+{
+	UWorld* World = GetWorld();
+
+	TArray<FVector, TInlineAllocator<8>> Ends;
+
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		FShooterLineOfSightEntry& Entry = It.Value();
+
+		const AActor* Viewer = Entry.Viewer.Get();
+		const AActor* Target = Entry.Target.Get();
+
+		// drop pairs that went away or nobody asks about anymore
+		if (!Viewer || !Target || GFrameCounter - Entry.RequestFrame > static_cast<uint64>(GShooterLineOfSightEvictFrames))
+		{
+			if (Entry.PendingTraces == 0)
+			{
+				It.RemoveCurrent();
+			}
+
+			continue;
+		}
+
+		// skip pairs still waiting on their traces, or still fresh
+		if (Entry.PendingTraces > 0 || GFrameCounter - Entry.ResultFrame < GetMaxAge(Entry))
+		{
+			continue;
+		}
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterLineOfSight), false, Viewer);
+		QueryParams.AddIgnoredActor(Target);
+
+		GetTraceEnds(Target, Entry.NumChecks, Ends);
+
+		// nothing to trace, so there's no line of sight
+		if (Ends.Num() == 0)
+		{
+			Entry.bHasLineOfSight = false;
+			Entry.ResultFrame = GFrameCounter;
+			continue;
+		}
+
+		// the pair keeps its current verdict until the whole batch is back
+		for (const FVector& End : Ends)
+		{
+			FShooterLineOfSightTrace& Trace = PendingTraces.AddDefaulted_GetRef();
+			Trace.Handle = World->AsyncLineTraceByChannel(EAsyncTraceType::Test, Entry.ViewLocation, End, ECC_Visibility, QueryParams);
+			Trace.Key = It.Key();
+
+			++Entry.PendingTraces;
+		}
+
+		INC_DWORD_STAT_BY(STAT_ShooterLineOfSightAsyncTraces, Ends.Num());
+	}
+}
+
+uint64 UShooterLineOfSightSubsystem::GetMaxAge(const FShooterLineOfSightEntry& Entry)
+{
+	// far away pairs change verdict slower on screen, so they can wait longer between refreshes
+	const AActor* Target = Entry.Target.Get();
+	const float DistanceMeters = Target ? FVector::Dist(Entry.ViewLocation, Target->GetActorLocation()) * 0.01f : 0.0f;
+
+	const int32 MaxAge = GShooterLineOfSightCacheFrames + FMath::FloorToInt32(DistanceMeters * GShooterLineOfSightFramesPerMeter);
+
+	return static_cast<uint64>(FMath::Clamp(MaxAge, 1, FMath::Max(GShooterLineOfSightMaxCacheFrames, 1)));
+}
+
+void UShooterLineOfSightSubsystem::GetTraceEnds(const AActor* Target, int32 NumChecks, TArray<FVector, TInlineAllocator<8>>& OutEnds)
+{
+	OutEnds.Reset();
+
+	if (NumChecks <= 0)
+	{
+		return;
+	}
+
+	// get the target's bounding box
+	FVector CenterOfMass, Extent;
+	Target->GetActorBounds(true, CenterOfMass, Extent, false);
+
+	// divide the vertical extent by the number of line of sight checks we'll do
+	const float ExtentZOffset = Extent.Z * 2.0f / NumChecks;
+
+	// spread the end points from the top of the bounds downwards
+	for (int32 i = 0; i < NumChecks - 1; ++i)
+	{
+		OutEnds.Add(CenterOfMass + FVector(0.0f, 0.0f, Extent.Z - ExtentZOffset * i));
+	}
+}
@@ -0,0 +1,110 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "UObject/ObjectKey.h"
+#include "ShooterLineOfSight.generated.h"
+
+/**
+ *  Cached line of sight verdict between a viewer and a target
+ */
+struct FShooterLineOfSightEntry
+{
+	/** Actor looking for the target */
+	TWeakObjectPtr<AActor> Viewer;
+
+	/** Actor being looked for */
+	TWeakObjectPtr<AActor> Target;
+
+	/** Location the viewer traces from, updated on every request */
+	FVector ViewLocation = FVector::ZeroVector;
+
+	/** Number of vertical checks spread over the target's bounds */
+	int32 NumChecks = 2;
+
+	/** Frame the verdict was last refreshed on */
+	uint64 ResultFrame = 0;
+
+	/** Frame the verdict was last requested on */
+	uint64 RequestFrame = 0;
+
+	/** Number of async traces still in flight for this pair */
+	int32 PendingTraces = 0;
+
+	/** If true, one of the in-flight traces came back unobstructed */
+	bool bPendingClear = false;
+
+	/** If true, one of the in-flight traces was dropped */
+	bool bPendingFailed = false;
+
+	/** Cached verdict */
+	bool bHasLineOfSight = false;
+};
+
+/**
+ *  An async trace issued for a line of sight pair
+ */
+struct FShooterLineOfSightTrace
+{
+	/** Handle of the async trace */
+	FTraceHandle Handle;
+
+	/** Pair the trace was issued for */
+	TPair<FObjectKey, FObjectKey> Key;
+};
+
+/**
+ *  World subsystem that answers line of sight queries between AI viewers and their targets
+ *  Every (viewer, target) pair keeps a cached verdict. Stale pairs are refreshed with one batch of async traces
+ *  per frame, and the verdict is allowed to get older the farther apart the pair is. A pair is only traced
+ *  synchronously the first time it's requested, so the cost scales with pair changes instead of queries.
+ */
+UCLASS()
+class FPS251106_API UShooterLineOfSightSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Cached verdicts by (viewer, target) */
+	TMap<TPair<FObjectKey, FObjectKey>, FShooterLineOfSightEntry> Entries;
+
+	/** Async traces waiting for their results */
+	TArray<FShooterLineOfSightTrace> PendingTraces;
+
+	/** Frame scratch: trace results */
+	FTraceDatum TraceData;
+
+public:
+
+	/** Returns the cached line of sight verdict for the pair, and keeps it fresh for future queries */
+	bool HasLineOfSight(AActor* Viewer, const FVector& ViewLocation, AActor* Target, int32 NumChecks);
+
+	/** Traces line of sight between a viewer and a target right away */
+	static bool TraceLineOfSight(const UWorld* World, const AActor* Viewer, const FVector& ViewLocation, const AActor* Target, int32 NumChecks);
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Applies the async trace results that came back */
+	void GatherResults();
+
+	/** Issues async traces for every stale pair, and drops pairs nobody asks about anymore */
+	void RefreshEntries();
+
+	/** Returns the number of frames a verdict stays fresh for the given entry */
+	static uint64 GetMaxAge(const FShooterLineOfSightEntry& Entry);
+
+	/** Returns the trace end points spread over the target's vertical bounds */
+	static void GetTraceEnds(const AActor* Target, int32 NumChecks, TArray<FVector, TInlineAllocator<8>>& OutEnds);
+};
@@ -6,7 +6,6 @@
 #include "ShooterWeapon.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Camera/CameraComponent.h"
-#include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "ShooterGameMode.h"
 #include "MultiplayerGameMode.h"
@@ -14,7 +13,26 @@
 #include "GameFramework/CharacterMovementComponent.h"
 #include "TimerManager.h"
 #include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "ShooterNetQuantize.h"
+#include "ShooterAISignificance.h"
+#include "ShooterNPCPool.h"
+#include "ShooterRagdollBudget.h"
+#include "Animation/AnimInstance.h"
 #include "AIController.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+/** Salt for the NPC aim error, so it doesn't mirror the weapon spread drawn from the same shot */
+static constexpr uint32 NPCAimSalt = 0x4E504341;
+
+static int32 GShooterNPCThirdPersonOnlyWeapons = 1;
+static FAutoConsoleVariableRef CVarShooterNPCThirdPersonOnlyWeapons(
+	TEXT("Shooter.Weapons.NPCThirdPersonOnly"),
+	GShooterNPCThirdPersonOnlyWeapons,
+	TEXT("If zero, NPCs spawned from now on keep full weapons, to compare their cost with Shooter.Weapons.CostReport"),
+	ECVF_Default
+);
 
 AShooterNPC::AShooterNPC()
 {
@@ -29,17 +47,62 @@ AShooterNPC::AShooterNPC()
 	AutoPossessAI = EAutoPossessAI::PlacedInWorldOrSpawned;
 }
 
+void AShooterNPC::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	// the replicated HP is quantized against the class default HP. Clients can receive it before BeginPlay,
+	// and their runtime HP may already be rebuilt from it, so never read the range from the instance
+	MaxHP = FMath::Max(GetClass()->GetDefaultObject<AShooterNPC>()->CurrentHP, UE_KINDA_SMALL_NUMBER);
+}
+
 void AShooterNPC::BeginPlay()
 {
 	Super::BeginPlay();
 
+	SetCurrentHP(CurrentHP);
+
+	// pick the weapon seed before the weapon spawns. Clients receive it with our initial replication, before BeginPlay
+	if (HasAuthority())
+	{
+		WeaponSeed = GetTypeHash(FGuid::NewGuid());
+	}
+
 	// spawn the weapon
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.Owner = this;
 	SpawnParams.Instigator = this;
 	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
+	SpawnParams.bDeferConstruction = true;
+
 	Weapon = GetWorld()->SpawnActor<AShooterWeapon>(WeaponClass, GetActorTransform(), SpawnParams);
+
+	if (Weapon)
+	{
+		// strip the first person mesh before its components are registered
+		if (bThirdPersonOnlyWeapon && GShooterNPCThirdPersonOnlyWeapons != 0)
+		{
+			Weapon->SetThirdPersonOnly();
+		}
+
+		Weapon->FinishSpawning(GetActorTransform());
+
+		// clients can join while we're parked
+		if (bParked)
+		{
+			Weapon->DeactivateWeapon();
+		}
+	}
+
+	// throttle our AI by distance to the players. The AI only runs on the server
+	if (HasAuthority())
+	{
+		if (UShooterAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UShooterAISignificanceSubsystem>())
+		{
+			Significance->RegisterNPC(this);
+		}
+	}
 }
 
 void AShooterNPC::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -48,6 +111,26 @@ void AShooterNPC::EndPlay(const EEndPlayReason::Type EndPlayReason)
 
 	// clear the death timer
 	GetWorld()->GetTimerManager().ClearTimer(DeathTimer);
+
+	if (UShooterAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UShooterAISignificanceSubsystem>())
+	{
+		Significance->UnregisterNPC(this);
+	}
+
+	// give back our ragdoll slot
+	if (UShooterRagdollBudgetSubsystem* RagdollBudget = GetWorld()->GetSubsystem<UShooterRagdollBudgetSubsystem>())
+	{
+		RagdollBudget->ReleaseRagdoll(GetMesh());
+	}
+
+	// destroyed while handed out, so we'll never be released
+	if (bActiveFromPool && EndPlayReason == EEndPlayReason::Destroyed)
+	{
+		if (UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>())
+		{
+			Pool->NotifyNPCDestroyed(this);
+		}
+	}
 }
 
 float AShooterNPC::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
@@ -59,12 +142,12 @@ float AShooterNPC::TakeDamage(float Damage, struct FDamageEvent const& DamageEve
 	}
 
 	// Reduce HP
-	CurrentHP -= Damage;
+	SetCurrentHP(CurrentHP - Damage);
 
 	// Have we depleted HP?
 	if (CurrentHP <= 0.0f)
 	{
-		Die();
+		Die(EventInstigator ? EventInstigator->GetPawn() : nullptr);
 	}
 
 	return Damage;
@@ -77,9 +160,9 @@ void AShooterNPC::AttachWeaponMeshes(AShooterWeapon* WeaponToAttach)
 	// attach the weapon actor
 	WeaponToAttach->AttachToActor(this, AttachmentRule);
 
-	// attach the weapon meshes
+	// attach the weapon meshes. Third person only weapons may be represented by a static mesh
 	WeaponToAttach->GetFirstPersonMesh()->AttachToComponent(GetFirstPersonMesh(), AttachmentRule, FirstPersonWeaponSocket);
-	WeaponToAttach->GetThirdPersonMesh()->AttachToComponent(GetMesh(), AttachmentRule, FirstPersonWeaponSocket);
+	WeaponToAttach->GetThirdPersonComponent()->AttachToComponent(GetMesh(), AttachmentRule, FirstPersonWeaponSocket);
 }
 
 void AShooterNPC::PlayFiringMontage(UAnimMontage* Montage)
@@ -104,6 +187,9 @@ FVector AShooterNPC::GetWeaponTargetLocation()
 
 	FVector AimDir, AimTarget = FVector::ZeroVector;
 
+	// draw the aim error from the weapon's stream for the upcoming shot, so the shot can be reproduced from its index
+	const FRandomStream AimStream = Weapon ? Weapon->MakeShotRandomStream(Weapon->GetNextShotIndex(), NPCAimSalt) : FRandomStream(FMath::Rand());
+
 	// do we have an aim target?
 	if (CurrentAimTarget)
 	{
@@ -111,17 +197,17 @@ FVector AShooterNPC::GetWeaponTargetLocation()
 		AimTarget = CurrentAimTarget->GetActorLocation();
 
 		// apply a vertical offset to target head/feet
-		AimTarget.Z += FMath::RandRange(MinAimOffsetZ, MaxAimOffsetZ);
+		AimTarget.Z += AimStream.FRandRange(MinAimOffsetZ, MaxAimOffsetZ);
 
 		// get the aim direction and apply randomness in a cone
 		AimDir = (AimTarget - AimSource).GetSafeNormal();
-		AimDir = UKismetMathLibrary::RandomUnitVectorInConeInDegrees(AimDir, AimVarianceHalfAngle);
+		AimDir = AimStream.VRandCone(AimDir, FMath::DegreesToRadians(AimVarianceHalfAngle));
 
 		
 	} else {
 
 		// no aim target, so just use the camera facing
-		AimDir = UKismetMathLibrary::RandomUnitVectorInConeInDegrees(GetFirstPersonCameraComponent()->GetForwardVector(), AimVarianceHalfAngle);
+		AimDir = AimStream.VRandCone(GetFirstPersonCameraComponent()->GetForwardVector(), FMath::DegreesToRadians(AimVarianceHalfAngle));
 
 	}
 
@@ -174,7 +260,7 @@ void AShooterNPC::OnSemiWeaponRefire()
 	}
 }
 
-void AShooterNPC::Die()
+void AShooterNPC::Die(const APawn* KillerPawn)
 {
 	// ignore if already dead
 	if (bIsDead)
@@ -185,10 +271,10 @@ void AShooterNPC::Die()
 	// raise the dead flag
 	bIsDead = true;
 
-	// award kill score to the player (shooter variant assumes only player kills NPCs)
+	// award the kill score. Every death comes through here, however the HP ran out. Only the server has a game mode
 	if (AShooterGameMode* GM = Cast<AShooterGameMode>(GetWorld()->GetAuthGameMode()))
 	{
-		GM->AddScore(50);
+		GM->AddScore(AShooterGameMode::GetKillScore(KillerPawn, this));
 	}
 
 	// disable capsule collision
@@ -198,10 +284,24 @@ void AShooterNPC::Die()
 	GetCharacterMovement()->StopMovementImmediately();
 	GetCharacterMovement()->StopActiveMovement();
 
-	// enable ragdoll physics on the third person mesh
-	GetMesh()->SetCollisionProfileName(RagdollCollisionProfile);
-	GetMesh()->SetSimulatePhysics(true);
-	GetMesh()->SetPhysicsBlendWeight(1.0f);
+	// ragdoll if the budget has room, otherwise fall back to the death montage
+	UShooterRagdollBudgetSubsystem* RagdollBudget = GetWorld()->GetSubsystem<UShooterRagdollBudgetSubsystem>();
+
+	if (!RagdollBudget || RagdollBudget->RequestRagdoll(GetMesh(), DeathMontage != nullptr))
+	{
+		// enable ragdoll physics on the third person mesh
+		GetMesh()->SetCollisionProfileName(RagdollCollisionProfile);
+		GetMesh()->SetSimulatePhysics(true);
+		GetMesh()->SetPhysicsBlendWeight(1.0f);
+
+	} else if (UAnimInstance* AnimInstance = DeathMontage ? GetMesh()->GetAnimInstance() : nullptr) {
+
+		AnimInstance->Montage_Play(DeathMontage);
+
+	}
+
+	// let the controller stop our AI
+	OnPawnDeath.Broadcast();
 
 	// schedule actor destruction
 	GetWorld()->GetTimerManager().SetTimer(DeathTimer, this, &AShooterNPC::DeferredDestruction, DeferredDestructionTime, false);
@@ -209,18 +309,169 @@ void AShooterNPC::Die()
 
 void AShooterNPC::DeferredDestruction()
 {
-	// respawn a new enemy at a random location through the multiplayer game mode
 	if (HasAuthority())
 	{
-		if (AMultiplayerGameMode* GM = Cast<AMultiplayerGameMode>(GetWorld()->GetAuthGameMode()))
+		// park ourselves first, so the respawn below can recycle us right away
+		UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>();
+
+		if (Pool)
+		{
+			Pool->ReleaseNPC(this);
+		}
+
+		// respawn a new enemy at a random location through the multiplayer game mode.
+		// NPCs handed out to the horde or the benchmarks are managed by them instead
+		AMultiplayerGameMode* GM = bRespawnOnDeath ? Cast<AMultiplayerGameMode>(GetWorld()->GetAuthGameMode()) : nullptr;
+
+		if (GM && GM->ShouldRespawnDeadEnemies())
 		{
 			GM->SpawnEnemyAtRandomLocation();
 		}
+
+		// the pool keeps us, along with our controller and weapon
+		if (Pool)
+		{
+			return;
+		}
 	}
 
 	Destroy();
 }
 
+void AShooterNPC::Revive()
+{
+	// lower the dead flag
+	bIsDead = false;
+
+	// a pending destruction is no longer wanted
+	GetWorld()->GetTimerManager().ClearTimer(DeathTimer);
+
+	ResetRagdoll();
+}
+
+void AShooterNPC::ResetRagdoll()
+{
+	const AShooterNPC* Defaults = GetClass()->GetDefaultObject<AShooterNPC>();
+	USkeletalMeshComponent* CharacterMesh = GetMesh();
+
+	// give back our ragdoll slot, if we still hold one
+	if (UShooterRagdollBudgetSubsystem* RagdollBudget = GetWorld()->GetSubsystem<UShooterRagdollBudgetSubsystem>())
+	{
+		RagdollBudget->ReleaseRagdoll(CharacterMesh);
+	}
+
+	// stop the death montage
+	if (UAnimInstance* AnimInstance = DeathMontage ? CharacterMesh->GetAnimInstance() : nullptr)
+	{
+		AnimInstance->Montage_Stop(0.0f, DeathMontage);
+	}
+
+	// stop the ragdoll physics, and unfreeze the pose if the budget froze it
+	CharacterMesh->bNoSkeletonUpdate = false;
+	CharacterMesh->SetSimulatePhysics(false);
+	CharacterMesh->SetPhysicsBlendWeight(0.0f);
+	CharacterMesh->SetCollisionProfileName(Defaults->GetMesh()->GetCollisionProfileName());
+
+	// simulating detached the mesh from the capsule, so put it back where the character expects it
+	CharacterMesh->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	CharacterMesh->SetRelativeLocationAndRotation(GetBaseTranslationOffset(), GetBaseRotationOffset());
+
+	// restore the capsule collision
+	GetCapsuleComponent()->SetCollisionEnabled(Defaults->GetCapsuleComponent()->GetCollisionEnabled());
+}
+
+void AShooterNPC::OnAcquiredFromPool(const FTransform& SpawnTransform)
+{
+	bActiveFromPool = true;
+	SetParked(false);
+
+	// whoever acquired us owns our lifetime, unless the game mode claims us for respawning
+	bRespawnOnDeath = false;
+
+	// come back to life with full HP. Clients revive when the HP replicates
+	Revive();
+	SetCurrentHP(MaxHP);
+
+	// collide again before moving, so the move can tell whether the spawn point has room for us
+	SetActorEnableCollision(true);
+
+	// move to the spawn point, or the nearest spot around it we fit in. Only if there's none, go there anyway
+	if (!TeleportTo(SpawnTransform.GetLocation(), SpawnTransform.Rotator()))
+	{
+		UE_LOG(LogFPS251106, Warning, TEXT("%s is encroaching on geometry after leaving the NPC pool."), *GetName());
+
+		SetActorLocationAndRotation(SpawnTransform.GetLocation(), SpawnTransform.Rotator(), false, nullptr, ETeleportType::ResetPhysics);
+	}
+
+	// show ourselves again
+	SetActorHiddenInGame(false);
+
+	// resume movement
+	GetCharacterMovement()->SetComponentTickEnabled(true);
+	GetCharacterMovement()->SetDefaultMovementMode();
+
+	// a full magazine and no leftover reload
+	if (Weapon)
+	{
+		Weapon->ResetWeapon();
+		Weapon->ActivateWeapon();
+	}
+
+	// throttle our AI again. The new entry reapplies the tick intervals
+	if (UShooterAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UShooterAISignificanceSubsystem>())
+	{
+		Significance->RegisterNPC(this);
+	}
+
+	// restart the brain from the new spawn point
+	if (AShooterAIController* AIController = Cast<AShooterAIController>(GetController()))
+	{
+		AIController->SetControlRotation(SpawnTransform.Rotator());
+		AIController->RestartBehavior();
+	}
+}
+
+void AShooterNPC::OnReturnedToPool()
+{
+	bActiveFromPool = false;
+	SetParked(true);
+
+	// a pending destruction is no longer wanted
+	GetWorld()->GetTimerManager().ClearTimer(DeathTimer);
+
+	// stop the brain. The controller stays possessed, so it's reused with us
+	if (AShooterAIController* AIController = Cast<AShooterAIController>(GetController()))
+	{
+		AIController->StopBehavior();
+	}
+
+	// stop shooting and put the weapon away
+	bIsShooting = false;
+	CurrentAimTarget = nullptr;
+
+	if (Weapon)
+	{
+		Weapon->DeactivateWeapon();
+	}
+
+	// parked NPCs aren't throttled
+	if (UShooterAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UShooterAISignificanceSubsystem>())
+	{
+		Significance->UnregisterNPC(this);
+	}
+
+	ResetRagdoll();
+
+	// stop moving
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->DisableMovement();
+	GetCharacterMovement()->SetComponentTickEnabled(false);
+
+	// hide until we're handed out again
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+}
+
 void AShooterNPC::StartShooting(AActor* ActorToShoot)
 {
 	// save the aim target
@@ -242,19 +493,95 @@ void AShooterNPC::StopShooting()
 	Weapon->StopFiring();
 }
 
+void AShooterNPC::MulticastFireEvent_Implementation(const FShooterFireEvent& FireEvent)
+{
+	// the server has already fired this shot
+	if (HasAuthority())
+	{
+		return;
+	}
+
+	// play the shot for effects only
+	if (Weapon)
+	{
+		Weapon->HandleRemoteFireEvent(FireEvent);
+	}
+}
+
 void AShooterNPC::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(AShooterNPC, CurrentHP);
-	DOREPLIFETIME(AShooterNPC, TeamByte);
+	// these rarely change, so they're only compared when marked dirty
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterNPC, ReplicatedHP, PushParams);
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterNPC, TeamByte, PushParams);
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterNPC, bParked, PushParams);
+
+	// the weapon seed never changes after spawning
+	DOREPLIFETIME_CONDITION(AShooterNPC, WeaponSeed, COND_InitialOnly);
 }
 
-void AShooterNPC::OnRep_CurrentHP()
+void AShooterNPC::SetCurrentHP(float NewHP)
 {
+	CurrentHP = NewHP;
+
+	// only dirty the property if the quantized value actually changed
+	const uint16 NewReplicatedHP = ShooterNetQuantize::QuantizeHealth(CurrentHP, MaxHP);
+
+	if (NewReplicatedHP != ReplicatedHP)
+	{
+		ReplicatedHP = NewReplicatedHP;
+		MARK_PROPERTY_DIRTY_FROM_NAME(AShooterNPC, ReplicatedHP, this);
+	}
+}
+
+void AShooterNPC::OnRep_ReplicatedHP()
+{
+	// rebuild the HP from its quantized fraction
+	CurrentHP = ShooterNetQuantize::DequantizeHealth(ReplicatedHP, MaxHP);
+
 	// If HP reaches zero or below, die (only on clients, server handles it in TakeDamage)
 	if (CurrentHP <= 0.0f && !bIsDead)
 	{
 		Die();
+
+	} else if (CurrentHP > 0.0f && bIsDead) {
+
+		// the server recycled this NPC through the pool
+		Revive();
+
+	}
+}
+
+void AShooterNPC::SetParked(bool bInParked)
+{
+	if (bParked != bInParked)
+	{
+		bParked = bInParked;
+		MARK_PROPERTY_DIRTY_FROM_NAME(AShooterNPC, bParked, this);
+	}
+}
+
+void AShooterNPC::OnRep_Parked()
+{
+	// the weapon is spawned locally, and hiding the NPC doesn't hide it
+	if (bParked)
+	{
+		// our death, if any, is over. Stop the ragdoll before it simulates out of sight
+		GetWorld()->GetTimerManager().ClearTimer(DeathTimer);
+		ResetRagdoll();
+
+		if (Weapon)
+		{
+			Weapon->DeactivateWeapon();
+		}
+
+	} else if (Weapon) {
+
+		Weapon->ActivateWeapon();
+
 	}
 }
@@ -5,12 +5,15 @@
 #include "CoreMinimal.h"
 #include "FPS251106Character.h"
 #include "ShooterWeaponHolder.h"
+#include "GenericTeamAgentInterface.h"
+#include "ShooterFireEvent.h"
 #include "Net/UnrealNetwork.h"
 #include "ShooterNPC.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FPawnDeathDelegate);
 
 class AShooterWeapon;
+class UAnimMontage;
 
 /**
  *  A simple AI-controlled shooter game NPC
@@ -18,30 +21,45 @@ class AShooterWeapon;
  *  Holds and manages a weapon
  */
 UCLASS(abstract)
-class FPS251106_API AShooterNPC : public AFPS251106Character, public IShooterWeaponHolder
+class FPS251106_API AShooterNPC : public AFPS251106Character, public IShooterWeaponHolder, public IGenericTeamAgentInterface
 {
 	GENERATED_BODY()
 
 public:
 
-	/** Current HP for this character. It dies if it reaches zero through damage */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, ReplicatedUsing = OnRep_CurrentHP, Category="Damage")
+	/** Current HP for this character. It dies if it reaches zero through damage. Clients rebuild it from ReplicatedHP */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Damage")
 	float CurrentHP = 100.0f;
 
 protected:
 
+	/** Default HP of this character's class. Used as the range for the quantized HP, so the server and clients agree on it */
+	float MaxHP = 100.0f;
+
+	/** Current HP quantized to a fraction of MaxHP. Push model, marked dirty when HP changes */
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedHP)
+	uint16 ReplicatedHP = 0;
+
 	/** Name of the collision profile to use during ragdoll death */
 	UPROPERTY(EditAnywhere, Category="Damage")
 	FName RagdollCollisionProfile = FName("Ragdoll");
 
+	/** Montage played on death instead of the ragdoll when the ragdoll budget is spent. Should hold its last pose */
+	UPROPERTY(EditAnywhere, Category="Damage")
+	TObjectPtr<UAnimMontage> DeathMontage;
+
 	/** Time to wait after death before destroying this actor */
 	UPROPERTY(EditAnywhere, Category="Damage")
 	float DeferredDestructionTime = 5.0f;
 
-	/** Team byte for this character */
+	/** Team byte for this character. Push model */
 	UPROPERTY(EditAnywhere, Replicated, Category="Team")
 	uint8 TeamByte = 1;
 
+	/** Random seed picked by the server and sent once, so every machine's copy of our weapon spreads the same way */
+	UPROPERTY(Replicated)
+	uint32 WeaponSeed = 0;
+
 	/** Pointer to the equipped weapon */
 	TObjectPtr<AShooterWeapon> Weapon;
 
@@ -49,6 +67,10 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Weapon")
 	TSubclassOf<AShooterWeapon> WeaponClass;
 
+	/** If true, the weapon is spawned without a first person mesh, since NPCs never render a first person view */
+	UPROPERTY(EditAnywhere, Category="Weapon")
+	bool bThirdPersonOnlyWeapon = true;
+
 	/** Name of the first person mesh weapon socket */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category ="Weapons")
 	FName FirstPersonWeaponSocket = FName("HandGrip_R");
@@ -85,6 +107,19 @@ protected:
 	/** Deferred destruction on death timer */
 	FTimerHandle DeathTimer;
 
+	/** If true, this NPC is owned by the NPC pool and is released to it after death instead of being destroyed */
+	bool bPooled = false;
+
+	/** If true, this NPC was handed out by the NPC pool and hasn't been released yet */
+	bool bActiveFromPool = false;
+
+	/** If true, this NPC is parked in the NPC pool. Push model, so clients can put away what the server doesn't replicate */
+	UPROPERTY(ReplicatedUsing = OnRep_Parked)
+	bool bParked = false;
+
+	/** If true, the game mode replaces this NPC when it dies. Level NPCs and game mode spawns are replaced, other pool users own their NPCs */
+	bool bRespawnOnDeath = true;
+
 public:
 
 	/** Delegate called when this NPC dies */
@@ -97,6 +132,9 @@ public:
 
 protected:
 
+	/** Takes MaxHP from the class defaults, before any replicated HP is received */
+	virtual void PostInitializeComponents() override;
+
 	/** Gameplay initialization */
 	virtual void BeginPlay() override;
 
@@ -108,6 +146,10 @@ public:
 	/** Handle incoming damage */
 	virtual float TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
+	/** Returns true if this character has died */
+	UFUNCTION(BlueprintPure, Category="Damage")
+	bool IsDead() const { return bIsDead; }
+
 public:
 
 	//~Begin IShooterWeaponHolder interface
@@ -139,16 +181,58 @@ public:
 	/** Notifies the owner that the weapon cooldown has expired and it's ready to shoot again */
 	virtual void OnSemiWeaponRefire() override;
 
+	/** Returns the replicated weapon seed */
+	virtual uint32 GetWeaponSeed() const override { return WeaponSeed; }
+
+	/** NPCs only hold one weapon */
+	virtual int32 GetWeaponIndex(const AShooterWeapon* InWeapon) const override { return InWeapon == Weapon ? 0 : INDEX_NONE; }
+
 	//~End IShooterWeaponHolder interface
 
+	//~Begin IGenericTeamAgentInterface interface
+
+	/** Returns the team byte as a generic team, so perception can tell friend from foe */
+	virtual FGenericTeamId GetGenericTeamId() const override { return FGenericTeamId(TeamByte); }
+
+	//~End IGenericTeamAgentInterface interface
+
 protected:
 
-	/** Called when HP is depleted and the character should die */
-	void Die();
+	/** Called when HP is depleted and the character should die. The killer is only known on the server, and not always */
+	void Die(const APawn* KillerPawn = nullptr);
 
-	/** Called after death to destroy the actor */
+	/** Called after death to destroy the actor, or return it to the NPC pool */
 	void DeferredDestruction();
 
+	/** Clears the dead state and reverts the ragdoll. Runs on the server and on clients */
+	void Revive();
+
+	/** Stops the ragdoll and puts the mesh and capsule collision back the way the class defaults have them */
+	void ResetRagdoll();
+
+public:
+
+	/** Flags this NPC as owned by the NPC pool */
+	void SetPooled(bool bInPooled) { bPooled = bInPooled; }
+
+	/** Returns true if this NPC is owned by the NPC pool */
+	bool IsPooled() const { return bPooled; }
+
+	/** Flags this NPC as handed out by the NPC pool */
+	void SetActiveFromPool(bool bInActiveFromPool) { bActiveFromPool = bInActiveFromPool; }
+
+	/** Returns true if this NPC was handed out by the NPC pool and hasn't been released yet */
+	bool IsActiveFromPool() const { return bActiveFromPool; }
+
+	/** Sets whether the game mode replaces this NPC when it dies */
+	void SetRespawnOnDeath(bool bInRespawnOnDeath) { bRespawnOnDeath = bInRespawnOnDeath; }
+
+	/** Brings this NPC back from the pool at the given transform, with full HP and a restarted StateTree */
+	void OnAcquiredFromPool(const FTransform& SpawnTransform);
+
+	/** Parks this NPC in the pool: stops its AI and weapon, reverts the ragdoll and hides it */
+	void OnReturnedToPool();
+
 public:
 
 	/** Signals this character to start shooting at the passed actor */
@@ -157,12 +241,43 @@ public:
 	/** Signals this character to stop shooting */
 	void StopShooting();
 
+	/** Replicates a shot to the clients so they can play it as a cosmetic-only shot */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireEvent(const FShooterFireEvent& FireEvent);
+
+public:
+
+	/** Sets the current HP and marks its replicated value dirty */
+	void SetCurrentHP(float NewHP);
+
+	/** Returns the type of weapon this character spawns */
+	const TSubclassOf<AShooterWeapon>& GetWeaponClass() const { return WeaponClass; }
+
+	/** Returns the max range for aiming calculations */
+	float GetAimRange() const { return AimRange; }
+
+	/** Returns the cone variance applied while aiming */
+	float GetAimVarianceHalfAngle() const { return AimVarianceHalfAngle; }
+
+	/** Returns the minimum vertical aim offset from the target center */
+	float GetMinAimOffsetZ() const { return MinAimOffsetZ; }
+
+	/** Returns the maximum vertical aim offset from the target center */
+	float GetMaxAimOffsetZ() const { return MaxAimOffsetZ; }
+
 protected:
 
 	/** Network replication */
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
-	/** Called when CurrentHP is replicated */
+	/** Called when ReplicatedHP is replicated */
+	UFUNCTION()
+	void OnRep_ReplicatedHP();
+
+	/** Sets the parked flag and marks it dirty */
+	void SetParked(bool bInParked);
+
+	/** Called when bParked is replicated. Hides or shows the local weapon, and stops the local ragdoll */
 	UFUNCTION()
-	void OnRep_CurrentHP();
+	void OnRep_Parked();
 };
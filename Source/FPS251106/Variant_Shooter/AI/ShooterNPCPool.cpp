@@ -0,0 +1,199 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterNPCPool.h"
+#include "ShooterNPC.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("NPC Pool Hits"), STAT_ShooterNPCPoolHits, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("NPC Pool Misses"), STAT_ShooterNPCPoolMisses, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled NPCs Active"), STAT_ShooterNPCPoolActive, STATGROUP_Shooter);
+
+static FAutoConsoleCommandWithWorld ShooterNPCPoolStatsCommand(
+	TEXT("Shooter.NPCPool.Stats"),
+	TEXT("Logs the hit, miss and high-water counters of the NPC pool for the current world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterNPCPoolSubsystem* Pool = World ? World->GetSubsystem<UShooterNPCPoolSubsystem>() : nullptr)
+		{
+			Pool->LogPoolStats();
+		}
+	})
+);
+
+void UShooterNPCPoolSubsystem::Deinitialize()
+{
+	// report the final counters so the pool can be sized for this map
+	LogPoolStats();
+
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UShooterNPCPoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterNPCPoolSubsystem::Prewarm(TSubclassOf<AShooterNPC> NPCClass, int32 Count)
+{
+	if (!NPCClass)
+	{
+		return;
+	}
+
+	FShooterNPCPoolEntry& Entry = Pools.FindOrAdd(NPCClass);
+
+	// only spawn the NPCs we're missing
+	const int32 NumToSpawn = Count - (Entry.FreeNPCs.Num() + Entry.NumActive);
+
+	for (int32 i = 0; i < NumToSpawn; ++i)
+	{
+		if (AShooterNPC* NPC = SpawnPooledNPC(NPCClass, FTransform::Identity))
+		{
+			// park it until it's needed
+			NPC->OnReturnedToPool();
+
+			Entry.FreeNPCs.Add(NPC);
+		}
+	}
+}
+
+AShooterNPC* UShooterNPCPoolSubsystem::AcquireNPC(TSubclassOf<AShooterNPC> NPCClass, const FTransform& SpawnTransform)
+{
+	if (!NPCClass)
+	{
+		return nullptr;
+	}
+
+	FShooterNPCPoolEntry& Entry = Pools.FindOrAdd(NPCClass);
+
+	// pop the free list until we find an NPC that is still alive
+	AShooterNPC* NPC = nullptr;
+
+	while (!NPC && Entry.FreeNPCs.Num() > 0)
+	{
+		AShooterNPC* Candidate = Entry.FreeNPCs.Pop(EAllowShrinking::No);
+
+		if (IsValid(Candidate))
+		{
+			NPC = Candidate;
+		}
+	}
+
+	if (NPC)
+	{
+		++Entry.Hits;
+		INC_DWORD_STAT(STAT_ShooterNPCPoolHits);
+
+		// bring it back at the spawn point
+		NPC->OnAcquiredFromPool(SpawnTransform);
+
+	} else {
+
+		// the pool ran dry, so grow it. A fresh NPC is already set up
+		++Entry.Misses;
+		INC_DWORD_STAT(STAT_ShooterNPCPoolMisses);
+
+		NPC = SpawnPooledNPC(NPCClass, SpawnTransform);
+
+		if (!NPC)
+		{
+			return nullptr;
+		}
+
+		NPC->SetActiveFromPool(true);
+		NPC->SetRespawnOnDeath(false);
+	}
+
+	// update the usage counters
+	++Entry.NumActive;
+	Entry.HighWater = FMath::Max(Entry.HighWater, Entry.NumActive);
+	INC_DWORD_STAT(STAT_ShooterNPCPoolActive);
+
+	return NPC;
+}
+
+void UShooterNPCPoolSubsystem::ReleaseNPC(AShooterNPC* NPC)
+{
+	if (!IsValid(NPC))
+	{
+		return;
+	}
+
+	FShooterNPCPoolEntry& Entry = Pools.FindOrAdd(NPC->GetClass());
+
+	// releasing twice would hand the same NPC out to two owners
+	if (!ensureMsgf(!Entry.FreeNPCs.Contains(NPC), TEXT("NPC %s was released to the pool twice"), *NPC->GetName()))
+	{
+		return;
+	}
+
+	// NPCs placed in the level were never handed out, so they aren't counted as active
+	if (NPC->IsActiveFromPool())
+	{
+		Entry.NumActive = FMath::Max(0, Entry.NumActive - 1);
+		DEC_DWORD_STAT(STAT_ShooterNPCPoolActive);
+	}
+
+	// park the NPC, adopting it if it didn't come from the pool
+	NPC->SetPooled(true);
+	NPC->OnReturnedToPool();
+
+	// add it back to the free list
+	Entry.FreeNPCs.Add(NPC);
+}
+
+void UShooterNPCPoolSubsystem::NotifyNPCDestroyed(AShooterNPC* NPC)
+{
+	if (FShooterNPCPoolEntry* Entry = Pools.Find(NPC->GetClass()))
+	{
+		// the NPC will never be released, so stop counting it as active
+		Entry->NumActive = FMath::Max(0, Entry->NumActive - 1);
+		DEC_DWORD_STAT(STAT_ShooterNPCPoolActive);
+	}
+}
+
+void UShooterNPCPoolSubsystem::GetPoolStats(TSubclassOf<AShooterNPC> NPCClass, int32& OutHits, int32& OutMisses, int32& OutHighWater, int32& OutActive, int32& OutFree) const
+{
+	OutHits = OutMisses = OutHighWater = OutActive = OutFree = 0;
+
+	if (const FShooterNPCPoolEntry* Entry = Pools.Find(NPCClass))
+	{
+		OutHits = Entry->Hits;
+		OutMisses = Entry->Misses;
+		OutHighWater = Entry->HighWater;
+		OutActive = Entry->NumActive;
+		OutFree = Entry->FreeNPCs.Num();
+	}
+}
+
+void UShooterNPCPoolSubsystem::LogPoolStats() const
+{
+	for (const TPair<TObjectPtr<UClass>, FShooterNPCPoolEntry>& Pair : Pools)
+	{
+		const FShooterNPCPoolEntry& Entry = Pair.Value;
+
+		UE_LOG(LogFPS251106, Log, TEXT("NPC pool [%s] in %s: Hits %d, Misses %d, High-water %d, Active %d, Free %d"),
+			*GetNameSafe(Pair.Key), *GetNameSafe(GetWorld()), Entry.Hits, Entry.Misses, Entry.HighWater, Entry.NumActive, Entry.FreeNPCs.Num());
+	}
+}
+
+AShooterNPC* UShooterNPCPoolSubsystem::SpawnPooledNPC(TSubclassOf<AShooterNPC> NPCClass, const FTransform& SpawnTransform)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	AShooterNPC* NPC = GetWorld()->SpawnActor<AShooterNPC>(NPCClass, SpawnTransform, SpawnParams);
+
+	if (NPC)
+	{
+		// flag the NPC so it's released back to us after death instead of being destroyed
+		NPC->SetPooled(true);
+	}
+
+	return NPC;
+}
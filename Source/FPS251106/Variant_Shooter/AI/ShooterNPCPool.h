@@ -0,0 +1,88 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterNPCPool.generated.h"
+
+class AShooterNPC;
+
+/**
+ *  Holds the parked NPCs and usage counters for a single NPC class
+ */
+USTRUCT()
+struct FShooterNPCPoolEntry
+{
+	GENERATED_BODY()
+
+	/** Parked NPCs ready to be handed out, with their controllers and weapons */
+	UPROPERTY()
+	TArray<TObjectPtr<AShooterNPC>> FreeNPCs;
+
+	/** Number of NPCs currently handed out */
+	int32 NumActive = 0;
+
+	/** Number of requests served from the free list */
+	int32 Hits = 0;
+
+	/** Number of requests that had to spawn a new NPC */
+	int32 Misses = 0;
+
+	/** Highest number of NPCs handed out at the same time */
+	int32 HighWater = 0;
+};
+
+/**
+ *  World subsystem that recycles dead NPCs instead of destroying them and spawning replacements
+ *  A released NPC keeps its AI controller and weapon. It's parked hidden and without collision, and is
+ *  re-initialized in place when it's handed out again: HP reset, ragdoll reverted and StateTree restarted.
+ *  NPCs placed in the level join the pool on their first death. Only used on the server.
+ */
+UCLASS()
+class FPS251106_API UShooterNPCPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Pools by NPC class */
+	UPROPERTY()
+	TMap<TObjectPtr<UClass>, FShooterNPCPoolEntry> Pools;
+
+public:
+
+	/** Subsystem cleanup */
+	virtual void Deinitialize() override;
+
+protected:
+
+	/** Only create the pool for game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Ensures at least Count NPCs of the given class exist in the pool */
+	void Prewarm(TSubclassOf<AShooterNPC> NPCClass, int32 Count);
+
+	/** Hands out an NPC of the given class at the given transform, spawning a new one if the pool is empty */
+	AShooterNPC* AcquireNPC(TSubclassOf<AShooterNPC> NPCClass, const FTransform& SpawnTransform);
+
+	/** Parks an NPC in its pool. NPCs that didn't come from the pool are adopted */
+	void ReleaseNPC(AShooterNPC* NPC);
+
+	/** Removes a pooled NPC that was destroyed while handed out */
+	void NotifyNPCDestroyed(AShooterNPC* NPC);
+
+	/** Returns the usage counters for the given NPC class */
+	UFUNCTION(BlueprintPure, Category="NPC Pool")
+	void GetPoolStats(TSubclassOf<AShooterNPC> NPCClass, int32& OutHits, int32& OutMisses, int32& OutHighWater, int32& OutActive, int32& OutFree) const;
+
+	/** Writes the usage counters for every pooled class to the log */
+	void LogPoolStats() const;
+
+protected:
+
+	/** Spawns a new NPC for the pool at the given transform */
+	AShooterNPC* SpawnPooledNPC(TSubclassOf<AShooterNPC> NPCClass, const FTransform& SpawnTransform);
+};
@@ -0,0 +1,158 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterRagdollBudget.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Ragdoll Budget Tick"), STAT_ShooterRagdollBudgetTick, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Ragdolls Simulating"), STAT_ShooterRagdollsSimulating, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ragdolls Granted"), STAT_ShooterRagdollsGranted, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ragdolls Denied"), STAT_ShooterRagdollsDenied, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ragdolls Frozen"), STAT_ShooterRagdollsFrozen, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ragdolls Evicted"), STAT_ShooterRagdollsEvicted, STATGROUP_Shooter);
+
+static int32 GShooterRagdollMaxActive = 8;
+static FAutoConsoleVariableRef CVarShooterRagdollMaxActive(
+	TEXT("Shooter.Ragdoll.MaxActive"),
+	GShooterRagdollMaxActive,
+	TEXT("Max number of ragdolls simulating at the same time"),
+	ECVF_Default
+);
+
+static float GShooterRagdollSettleSpeed = 20.0f;
+static FAutoConsoleVariableRef CVarShooterRagdollSettleSpeed(
+	TEXT("Shooter.Ragdoll.SettleSpeed"),
+	GShooterRagdollSettleSpeed,
+	TEXT("Speed of the ragdoll root body, in cm/s, under which the ragdoll counts as settled"),
+	ECVF_Default
+);
+
+static float GShooterRagdollSettleTime = 0.5f;
+static FAutoConsoleVariableRef CVarShooterRagdollSettleTime(
+	TEXT("Shooter.Ragdoll.SettleTime"),
+	GShooterRagdollSettleTime,
+	TEXT("Time in seconds a ragdoll has to stay settled before it's frozen"),
+	ECVF_Default
+);
+
+static float GShooterRagdollMaxSimulateTime = 4.0f;
+static FAutoConsoleVariableRef CVarShooterRagdollMaxSimulateTime(
+	TEXT("Shooter.Ragdoll.MaxSimulateTime"),
+	GShooterRagdollMaxSimulateTime,
+	TEXT("Time in seconds after which a ragdoll is frozen even if it hasn't settled"),
+	ECVF_Default
+);
+
+bool UShooterRagdollBudgetSubsystem::RequestRagdoll(USkeletalMeshComponent* Mesh, bool bCanFallBack)
+{
+	if (!Mesh)
+	{
+		return false;
+	}
+
+	// the budget is spent
+	if (Ragdolls.Num() >= FMath::Max(GShooterRagdollMaxActive, 0))
+	{
+		if (bCanFallBack || Ragdolls.Num() == 0)
+		{
+			INC_DWORD_STAT(STAT_ShooterRagdollsDenied);
+			return false;
+		}
+
+		// no fallback, so make room by freezing the oldest ragdoll
+		FreezeRagdoll(0);
+		INC_DWORD_STAT(STAT_ShooterRagdollsEvicted);
+	}
+
+	FShooterRagdollEntry& Entry = Ragdolls.AddDefaulted_GetRef();
+	Entry.Mesh = Mesh;
+	Entry.StartTime = GetWorld()->GetTimeSeconds();
+
+	INC_DWORD_STAT(STAT_ShooterRagdollsGranted);
+	INC_DWORD_STAT(STAT_ShooterRagdollsSimulating);
+
+	return true;
+}
+
+void UShooterRagdollBudgetSubsystem::ReleaseRagdoll(USkeletalMeshComponent* Mesh)
+{
+	const int32 Index = Ragdolls.IndexOfByPredicate([Mesh](const FShooterRagdollEntry& Entry) { return Entry.Mesh == Mesh; });
+
+	if (Index != INDEX_NONE)
+	{
+		Ragdolls.RemoveAt(Index, EAllowShrinking::No);
+		DEC_DWORD_STAT(STAT_ShooterRagdollsSimulating);
+	}
+}
+
+void UShooterRagdollBudgetSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterRagdollBudgetTick);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float SettleSpeedSq = FMath::Square(GShooterRagdollSettleSpeed);
+
+	// walk backwards so frozen ragdolls can be removed while keeping the rest oldest first
+	for (int32 i = Ragdolls.Num() - 1; i >= 0; --i)
+	{
+		FShooterRagdollEntry& Entry = Ragdolls[i];
+		USkeletalMeshComponent* Mesh = Entry.Mesh.Get();
+
+		// the mesh went away or stopped simulating without telling us
+		if (!Mesh || !Mesh->IsSimulatingPhysics())
+		{
+			Ragdolls.RemoveAt(i, EAllowShrinking::No);
+			DEC_DWORD_STAT(STAT_ShooterRagdollsSimulating);
+			continue;
+		}
+
+		// the root body stands in for the whole ragdoll
+		if (Mesh->GetPhysicsLinearVelocity().SizeSquared() < SettleSpeedSq)
+		{
+			Entry.SettledTime += DeltaTime;
+
+		} else {
+
+			Entry.SettledTime = 0.0f;
+
+		}
+
+		if (Entry.SettledTime >= GShooterRagdollSettleTime || Now - Entry.StartTime >= GShooterRagdollMaxSimulateTime)
+		{
+			FreezeRagdoll(i);
+		}
+	}
+}
+
+TStatId UShooterRagdollBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterRagdollBudgetSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterRagdollBudgetSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterRagdollBudgetSubsystem::FreezeRagdoll(int32 Index)
+{
+	if (USkeletalMeshComponent* Mesh = Ragdolls[Index].Mesh.Get())
+	{
+		// stop updating the bones first, so the mesh holds the last simulated pose instead of snapping back to the animation
+		Mesh->bNoSkeletonUpdate = true;
+
+		// take the bodies out of the physics scene
+		Mesh->SetSimulatePhysics(false);
+		Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+
+	Ragdolls.RemoveAt(Index, EAllowShrinking::No);
+
+	INC_DWORD_STAT(STAT_ShooterRagdollsFrozen);
+	DEC_DWORD_STAT(STAT_ShooterRagdollsSimulating);
+}
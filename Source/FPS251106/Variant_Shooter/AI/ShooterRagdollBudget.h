@@ -0,0 +1,71 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterRagdollBudget.generated.h"
+
+class USkeletalMeshComponent;
+
+/**
+ *  A ragdoll currently simulating under the budget
+ */
+struct FShooterRagdollEntry
+{
+	/** Simulating mesh */
+	TWeakObjectPtr<USkeletalMeshComponent> Mesh;
+
+	/** Game time the ragdoll started simulating at */
+	double StartTime = 0.0;
+
+	/** Time the ragdoll has been moving slower than the settle speed for */
+	float SettledTime = 0.0f;
+};
+
+/**
+ *  World subsystem that caps the number of ragdolls simulating at the same time
+ *  Each dying NPC asks for a slot before it enables ragdoll physics. Ragdolls that have settled, or simulated
+ *  for too long, are frozen into their last pose and give their slot back. When the budget is spent, the NPC
+ *  falls back to its death montage, or the oldest ragdoll is frozen early if the NPC has none.
+ *  Ragdolls are cosmetic, so the server and every client keep their own budget.
+ */
+UCLASS()
+class FPS251106_API UShooterRagdollBudgetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Simulating ragdolls, oldest first */
+	TArray<FShooterRagdollEntry> Ragdolls;
+
+public:
+
+	/**
+	 *  Asks for a ragdoll slot for the given mesh
+	 *  @param Mesh Mesh that's about to start simulating
+	 *  @param bCanFallBack If true, the caller has a fallback and is denied when the budget is spent. Otherwise the oldest ragdoll is frozen to make room
+	 *  @return True if the mesh may simulate
+	 */
+	bool RequestRagdoll(USkeletalMeshComponent* Mesh, bool bCanFallBack);
+
+	/** Gives back the slot of a mesh that stopped simulating on its own, like a recycled NPC */
+	void ReleaseRagdoll(USkeletalMeshComponent* Mesh);
+
+	/** Returns the number of simulating ragdolls */
+	int32 GetNumRagdolls() const { return Ragdolls.Num(); }
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Stops simulating a ragdoll and holds its last pose */
+	void FreezeRagdoll(int32 Index);
+};
@@ -0,0 +1,434 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterSightSense.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Sight Update"), STAT_ShooterSightUpdate, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight Prefilter Passes"), STAT_ShooterSightPasses, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight Traces"), STAT_ShooterSightTraces, STATGROUP_Shooter);
+
+static int32 GShooterSightMaxTracesPerFrame = 32;
+static FAutoConsoleVariableRef CVarShooterSightMaxTracesPerFrame(
+	TEXT("Shooter.Sight.MaxTracesPerFrame"),
+	GShooterSightMaxTracesPerFrame,
+	TEXT("Max number of visibility traces the shooter sight sense issues per frame, across all listeners"),
+	ECVF_Default
+);
+
+static int32 GShooterSightMinRetraceFrames = 2;
+static FAutoConsoleVariableRef CVarShooterSightMinRetraceFrames(
+	TEXT("Shooter.Sight.MinRetraceFrames"),
+	GShooterSightMinRetraceFrames,
+	TEXT("Min number of frames between two visibility traces of the same pair"),
+	ECVF_Default
+);
+
+UAISenseConfig_ShooterSight::UAISenseConfig_ShooterSight(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	DebugColor = FColor::Green;
+	Implementation = UAISense_ShooterSight::StaticClass();
+
+	// don't look at teammates
+	DetectionByAffiliation.bDetectEnemies = true;
+	DetectionByAffiliation.bDetectNeutrals = true;
+	DetectionByAffiliation.bDetectFriendlies = false;
+}
+
+TSubclassOf<UAISense> UAISenseConfig_ShooterSight::GetSenseImplementation() const
+{
+	return Implementation;
+}
+
+UAISense_ShooterSight::UAISense_ShooterSight(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	// only tell listeners when visibility changes
+	NotifyType = EAISenseNotifyType::OnPerceptionChange;
+
+	// have the perception system hand us every pawn as it spawns, so we never have to search the world for targets
+	bAutoRegisterAllPawnsAsSources = true;
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		OnNewListenerDelegate.BindUObject(this, &UAISense_ShooterSight::OnNewListenerImpl);
+		OnListenerUpdateDelegate.BindUObject(this, &UAISense_ShooterSight::OnListenerUpdateImpl);
+		OnListenerRemovedDelegate.BindUObject(this, &UAISense_ShooterSight::OnListenerRemovedImpl);
+	}
+}
+
+float UAISense_ShooterSight::Update()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterSightUpdate);
+
+	// publish last frame's results first, so the prefilter sees the current visibility
+	GatherResults();
+
+	GatherListeners();
+	GatherTargets();
+
+	PrefilterPairs();
+	IssueTraces();
+
+	// update every frame
+	return 0.0f;
+}
+
+void UAISense_ShooterSight::SetListenerMinRetraceFrames(const FPerceptionListenerID& ListenerId, int32 MinRetraceFrames)
+{
+	// the listener may not have been registered yet. Its config is digested into the same entry when it is
+	ListenerProperties.FindOrAdd(ListenerId).MinRetraceFrames = FMath::Max(MinRetraceFrames, 0);
+}
+
+void UAISense_ShooterSight::RegisterSource(AActor& SourceActor)
+{
+	RegisteredTargets.AddUnique(&SourceActor);
+}
+
+void UAISense_ShooterSight::UnregisterSource(AActor& SourceActor)
+{
+	RegisteredTargets.RemoveSingleSwap(&SourceActor, EAllowShrinking::No);
+}
+
+void UAISense_ShooterSight::OnNewListenerImpl(const FPerceptionListener& NewListener)
+{
+	const UAIPerceptionComponent* PerceptionComponent = NewListener.Listener.Get();
+	const UAISenseConfig_ShooterSight* SenseConfig = PerceptionComponent ? Cast<const UAISenseConfig_ShooterSight>(PerceptionComponent->GetSenseConfig(GetSenseID())) : nullptr;
+
+	if (!SenseConfig)
+	{
+		return;
+	}
+
+	FShooterSightListenerProperties& Properties = ListenerProperties.FindOrAdd(NewListener.GetListenerID());
+	Properties.SightRadiusSq = FMath::Square(SenseConfig->SightRadius);
+	Properties.LoseSightRadiusSq = FMath::Square(FMath::Max(SenseConfig->LoseSightRadius, SenseConfig->SightRadius));
+	Properties.ConeCos = FMath::Cos(FMath::DegreesToRadians(SenseConfig->PeripheralVisionAngleDegrees));
+	Properties.DetectionTag = SenseConfig->DetectionTag;
+	Properties.AffiliationFlags = SenseConfig->DetectionByAffiliation.GetAsFlags();
+}
+
+void UAISense_ShooterSight::OnListenerUpdateImpl(const FPerceptionListener& UpdatedListener)
+{
+	if (UpdatedListener.HasSense(GetSenseID()))
+	{
+		// keep the throttle across the reset
+		const FShooterSightListenerProperties* OldProperties = ListenerProperties.Find(UpdatedListener.GetListenerID());
+		const int32 MinRetraceFrames = OldProperties ? OldProperties->MinRetraceFrames : 0;
+
+		// drop the pair state, so the listener is told again what it sees. Recycled NPCs rely on this
+		OnListenerRemovedImpl(UpdatedListener);
+		OnNewListenerImpl(UpdatedListener);
+
+		if (FShooterSightListenerProperties* NewProperties = ListenerProperties.Find(UpdatedListener.GetListenerID()))
+		{
+			NewProperties->MinRetraceFrames = MinRetraceFrames;
+		}
+
+	} else {
+
+		OnListenerRemovedImpl(UpdatedListener);
+
+	}
+}
+
+void UAISense_ShooterSight::OnListenerRemovedImpl(const FPerceptionListener& RemovedListener)
+{
+	const FPerceptionListenerID ListenerId = RemovedListener.GetListenerID();
+
+	ListenerProperties.Remove(ListenerId);
+
+	for (auto It = Pairs.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key == ListenerId)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UAISense_ShooterSight::GatherResults()
+{
+	UWorld* World = GetWorld();
+
+	FTraceDatum TraceData;
+
+	for (int32 i = PendingTraces.Num() - 1; i >= 0; --i)
+	{
+		const FShooterSightTrace& Trace = PendingTraces[i];
+
+		bool bClear = false;
+
+		if (World->QueryTraceData(Trace.Handle, TraceData))
+		{
+			bClear = !TraceData.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+
+		} else if (World->IsTraceHandleValid(Trace.Handle, false)) {
+
+			// not ready yet
+			continue;
+
+		}
+
+		// dropped traces just release the pair so it can be traced again
+		AActor* Target = Trace.Target.Get();
+
+		if (FShooterSightPair* Pair = Target ? Pairs.Find(TPair<FPerceptionListenerID, FObjectKey>(Trace.ListenerId, Target)) : nullptr)
+		{
+			Pair->bPending = false;
+
+			// only targets that are still in range and in the cone can be seen
+			const bool bVisible = bClear && Pair->PassFrame + 1 >= GFrameCounter;
+
+			if (bVisible != Pair->bVisible)
+			{
+				Pair->bVisible = bVisible;
+				PublishVisibility(Trace.ListenerId, Target, bVisible);
+			}
+		}
+
+		PendingTraces.RemoveAtSwap(i, EAllowShrinking::No);
+	}
+}
+
+void UAISense_ShooterSight::GatherListeners()
+{
+	ListenerIds.Reset();
+	ListenerBodies.Reset();
+	ListenerTeamAgents.Reset();
+	ListenerX.Reset();
+	ListenerY.Reset();
+	ListenerZ.Reset();
+	ForwardX.Reset();
+	ForwardY.Reset();
+	ForwardZ.Reset();
+	LoseRadiusSq.Reset();
+	ConeCos.Reset();
+
+	for (const TPair<FPerceptionListenerID, FPerceptionListener>& ListenerPair : GetListeners())
+	{
+		const FPerceptionListener& Listener = ListenerPair.Value;
+		const FShooterSightListenerProperties* Properties = ListenerProperties.Find(ListenerPair.Key);
+		const AActor* Body = Listener.GetBodyActor();
+
+		if (!Properties || !Body || !Listener.HasSense(GetSenseID()))
+		{
+			continue;
+		}
+
+		ListenerIds.Add(ListenerPair.Key);
+		ListenerBodies.Add(Body);
+		ListenerTeamAgents.Add(Cast<const IGenericTeamAgentInterface>(Body));
+		ListenerX.Add(Listener.CachedLocation.X);
+		ListenerY.Add(Listener.CachedLocation.Y);
+		ListenerZ.Add(Listener.CachedLocation.Z);
+		ForwardX.Add(Listener.CachedDirection.X);
+		ForwardY.Add(Listener.CachedDirection.Y);
+		ForwardZ.Add(Listener.CachedDirection.Z);
+		LoseRadiusSq.Add(Properties->LoseSightRadiusSq);
+		ConeCos.Add(Properties->ConeCos);
+	}
+}
+
+void UAISense_ShooterSight::GatherTargets()
+{
+	Targets.Reset();
+
+	if (ListenerIds.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 i = RegisteredTargets.Num() - 1; i >= 0; --i)
+	{
+		AActor* Target = RegisteredTargets[i].Get();
+
+		// sources are unregistered when they end play, this only catches the ones that skipped it
+		if (!IsValid(Target))
+		{
+			RegisteredTargets.RemoveAtSwap(i, EAllowShrinking::No);
+			continue;
+		}
+
+		// pooled pawns are hidden while they wait to be reused
+		if (!Target->IsHidden())
+		{
+			Targets.Add(Target);
+		}
+	}
+}
+
+void UAISense_ShooterSight::PrefilterPairs()
+{
+	const int32 NumListeners = ListenerIds.Num();
+
+	Candidates.Reset();
+	CandidateTraceFrames.Reset();
+	PassMask.SetNumUninitialized(NumListeners, EAllowShrinking::No);
+
+	for (AActor* Target : Targets)
+	{
+		const FVector TargetLocation = Target->GetActorLocation();
+
+		const float TargetX = TargetLocation.X;
+		const float TargetY = TargetLocation.Y;
+		const float TargetZ = TargetLocation.Z;
+
+		// distance and cone test against every listener at once. Branchless over flat arrays so the compiler can vectorize it
+		for (int32 i = 0; i < NumListeners; ++i)
+		{
+			const float DX = TargetX - ListenerX[i];
+			const float DY = TargetY - ListenerY[i];
+			const float DZ = TargetZ - ListenerZ[i];
+
+			const float DistSq = DX * DX + DY * DY + DZ * DZ;
+			const float Dot = DX * ForwardX[i] + DY * ForwardY[i] + DZ * ForwardZ[i];
+
+			PassMask[i] = (DistSq <= LoseRadiusSq[i]) & (Dot >= ConeCos[i] * FMath::Sqrt(DistSq));
+		}
+
+		// walk the pairs that passed
+		for (int32 i = 0; i < NumListeners; ++i)
+		{
+			if (!PassMask[i] || ListenerBodies[i] == Target)
+			{
+				continue;
+			}
+
+			const FShooterSightListenerProperties& Properties = ListenerProperties.FindChecked(ListenerIds[i]);
+
+			if (!Properties.DetectionTag.IsNone() && !Target->ActorHasTag(Properties.DetectionTag))
+			{
+				continue;
+			}
+
+			// listeners without a team see everyone as neutral
+			const ETeamAttitude::Type Attitude = ListenerTeamAgents[i] ? ListenerTeamAgents[i]->GetTeamAttitudeTowards(*Target) : ETeamAttitude::Neutral;
+
+			if ((Properties.AffiliationFlags & (1 << Attitude)) == 0)
+			{
+				continue;
+			}
+
+			FShooterSightPair& Pair = Pairs.FindOrAdd(TPair<FPerceptionListenerID, FObjectKey>(ListenerIds[i], Target));
+
+			// unseen targets have to come within the shorter spot distance
+			if (!Pair.bVisible)
+			{
+				const float DistSq = FVector::DistSquared(TargetLocation, FVector(ListenerX[i], ListenerY[i], ListenerZ[i]));
+
+				if (DistSq > Properties.SightRadiusSq)
+				{
+					continue;
+				}
+			}
+
+			Pair.PassFrame = GFrameCounter;
+
+			INC_DWORD_STAT(STAT_ShooterSightPasses);
+
+			const int32 MinRetraceFrames = FMath::Max(GShooterSightMinRetraceFrames, Properties.MinRetraceFrames);
+
+			if (!Pair.bPending && GFrameCounter - Pair.TraceFrame >= static_cast<uint64>(MinRetraceFrames))
+			{
+				Candidates.Emplace(ListenerIds[i], Target);
+				CandidateTraceFrames.Add(Pair.TraceFrame);
+			}
+		}
+	}
+
+	// lose sight of pairs that left the range or the cone without waiting for a trace, and drop idle pairs
+	for (auto It = Pairs.CreateIterator(); It; ++It)
+	{
+		FShooterSightPair& Pair = It.Value();
+
+		if (Pair.PassFrame == GFrameCounter)
+		{
+			continue;
+		}
+
+		if (Pair.bVisible)
+		{
+			Pair.bVisible = false;
+
+			if (AActor* Target = Cast<AActor>(It.Key().Value.ResolveObjectPtr()))
+			{
+				PublishVisibility(It.Key().Key, Target, false);
+			}
+		}
+
+		if (!Pair.bPending)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UAISense_ShooterSight::IssueTraces()
+{
+	const int32 NumTraces = FMath::Min(Candidates.Num(), FMath::Max(GShooterSightMaxTracesPerFrame, 0));
+
+	if (NumTraces == 0)
+	{
+		return;
+	}
+
+	// trace the pairs that waited the longest first
+	CandidateOrder.SetNumUninitialized(Candidates.Num(), EAllowShrinking::No);
+
+	for (int32 i = 0; i < Candidates.Num(); ++i)
+	{
+		CandidateOrder[i] = i;
+	}
+
+	if (NumTraces < Candidates.Num())
+	{
+		CandidateOrder.Sort([this](int32 A, int32 B) { return CandidateTraceFrames[A] < CandidateTraceFrames[B]; });
+	}
+
+	UWorld* World = GetWorld();
+
+	for (int32 OrderIndex = 0; OrderIndex < NumTraces; ++OrderIndex)
+	{
+		const TPair<FPerceptionListenerID, AActor*>& Candidate = Candidates[CandidateOrder[OrderIndex]];
+
+		const FPerceptionListener* Listener = GetListeners().Find(Candidate.Key);
+		FShooterSightPair* Pair = Pairs.Find(TPair<FPerceptionListenerID, FObjectKey>(Candidate.Key, Candidate.Value));
+
+		if (!Listener || !Pair)
+		{
+			continue;
+		}
+
+		// ignore the listener and target. We want to ensure there's an unobstructed trace not counting them
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterSight), false, Listener->GetBodyActor());
+		QueryParams.AddIgnoredActor(Candidate.Value);
+
+		FShooterSightTrace& Trace = PendingTraces.AddDefaulted_GetRef();
+		Trace.Handle = World->AsyncLineTraceByChannel(EAsyncTraceType::Test, Listener->CachedLocation, Candidate.Value->GetActorLocation(), ECC_Visibility, QueryParams);
+		Trace.ListenerId = Candidate.Key;
+		Trace.Target = Candidate.Value;
+
+		Pair->bPending = true;
+		Pair->TraceFrame = GFrameCounter;
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterSightTraces, NumTraces);
+}
+
+void UAISense_ShooterSight::PublishVisibility(const FPerceptionListenerID& ListenerId, AActor* Target, bool bVisible)
+{
+	FPerceptionListener* Listener = GetListeners().Find(ListenerId);
+
+	if (!Listener)
+	{
+		return;
+	}
+
+	// a successful stimulus means the listener has direct line of sight
+	Listener->RegisterStimulus(Target, FAIStimulus(*this, bVisible ? 1.0f : 0.0f, Target->GetActorLocation(), Listener->CachedLocation, bVisible ? FAIStimulus::SensingSucceeded : FAIStimulus::SensingFailed));
+}
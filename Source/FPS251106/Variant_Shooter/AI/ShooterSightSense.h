@@ -0,0 +1,222 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Perception/AISense.h"
+#include "Perception/AISenseConfig.h"
+#include "WorldCollision.h"
+#include "UObject/ObjectKey.h"
+#include "GenericTeamAgentInterface.h"
+#include "ShooterSightSense.generated.h"
+
+class UAISense_ShooterSight;
+
+/**
+ *  Configures the shooter sight sense on an AI Perception Component
+ */
+UCLASS(meta = (DisplayName = "AI Shooter Sight config"))
+class FPS251106_API UAISenseConfig_ShooterSight : public UAISenseConfig
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sense implementation this config drives */
+	UPROPERTY(EditDefaultsOnly, Category="Sense", NoClear, config)
+	TSubclassOf<UAISense_ShooterSight> Implementation;
+
+	/** Max distance at which a target can be spotted */
+	UPROPERTY(EditAnywhere, Category="Sense", config, meta = (ClampMin = 0, Units = "cm"))
+	float SightRadius = 3000.0f;
+
+	/** Max distance at which a seen target stays seen */
+	UPROPERTY(EditAnywhere, Category="Sense", config, meta = (ClampMin = 0, Units = "cm"))
+	float LoseSightRadius = 3500.0f;
+
+	/** Half angle of the vision cone, in degrees */
+	UPROPERTY(EditAnywhere, Category="Sense", config, meta = (ClampMin = 0, ClampMax = 180, Units = "deg"))
+	float PeripheralVisionAngleDegrees = 60.0f;
+
+	/** If set, only pawns with this tag can be seen */
+	UPROPERTY(EditAnywhere, Category="Sense", config)
+	FName DetectionTag;
+
+	/** Which team attitudes can be seen, as the listener's pawn sees the target. Actors without a team are neutral */
+	UPROPERTY(EditAnywhere, Category="Sense", config)
+	FAISenseAffiliationFilter DetectionByAffiliation;
+
+public:
+
+	UAISenseConfig_ShooterSight(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	//~Begin UAISenseConfig interface
+	virtual TSubclassOf<UAISense> GetSenseImplementation() const override;
+	//~End UAISenseConfig interface
+};
+
+/**
+ *  Sight settings of a listener, digested from its sense config
+ */
+struct FShooterSightListenerProperties
+{
+	/** Squared spot distance */
+	float SightRadiusSq = 0.0f;
+
+	/** Squared keep-in-sight distance */
+	float LoseSightRadiusSq = 0.0f;
+
+	/** Cosine of the vision cone half angle */
+	float ConeCos = 0.0f;
+
+	/** Only pawns with this tag can be seen */
+	FName DetectionTag;
+
+	/** Team attitudes that can be seen, as flags */
+	uint8 AffiliationFlags = 0;
+
+	/** Min number of frames between two visibility traces of the same pair for this listener. Set by the AI significance */
+	int32 MinRetraceFrames = 0;
+};
+
+/**
+ *  Visibility state of a (listener, target) pair
+ */
+struct FShooterSightPair
+{
+	/** Frame the pair last passed the distance and cone prefilter */
+	uint64 PassFrame = 0;
+
+	/** Frame the pair was last traced */
+	uint64 TraceFrame = 0;
+
+	/** If true, a trace for the pair is in flight */
+	bool bPending = false;
+
+	/** If true, the listener currently sees the target */
+	bool bVisible = false;
+};
+
+/**
+ *  An async visibility trace issued for a pair
+ */
+struct FShooterSightTrace
+{
+	/** Handle of the async trace */
+	FTraceHandle Handle;
+
+	/** Listener the trace was issued for */
+	FPerceptionListenerID ListenerId;
+
+	/** Target the trace was issued for */
+	TWeakObjectPtr<AActor> Target;
+};
+
+/**
+ *  Sight sense for shooter AI
+ *  Targets are the actors registered as sources, which includes every pawn. Every update, all (listener, target)
+ *  pairs are prefiltered with a distance and cone test over structure-of-arrays listener data, then by team attitude.
+ *  Pairs that pass are traced asynchronously under a global per-frame budget, oldest first, and visibility changes
+ *  are published as regular perception stimuli on the next update.
+ *  A successful stimulus from this sense means the listener has direct line of sight to the target.
+ */
+UCLASS(ClassGroup=AI)
+class FPS251106_API UAISense_ShooterSight : public UAISense
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Digested sight settings by listener */
+	TMap<FPerceptionListenerID, FShooterSightListenerProperties> ListenerProperties;
+
+	/** Visibility state by (listener, target) */
+	TMap<TPair<FPerceptionListenerID, FObjectKey>, FShooterSightPair> Pairs;
+
+	/** Actors registered as sight sources. Every pawn registers itself when it spawns */
+	TArray<TWeakObjectPtr<AActor>> RegisteredTargets;
+
+	/** Async traces waiting for their results */
+	TArray<FShooterSightTrace> PendingTraces;
+
+	/** Frame scratch: listener ids */
+	TArray<FPerceptionListenerID> ListenerIds;
+
+	/** Frame scratch: listener body actors */
+	TArray<const AActor*> ListenerBodies;
+
+	/** Frame scratch: team agents of the listener bodies, if they have a team */
+	TArray<const IGenericTeamAgentInterface*> ListenerTeamAgents;
+
+	/** Frame scratch: listener eye locations, one array per axis */
+	TArray<float> ListenerX, ListenerY, ListenerZ;
+
+	/** Frame scratch: listener view directions, one array per axis */
+	TArray<float> ForwardX, ForwardY, ForwardZ;
+
+	/** Frame scratch: listener keep-in-sight distances, squared */
+	TArray<float> LoseRadiusSq;
+
+	/** Frame scratch: listener vision cone cosines */
+	TArray<float> ConeCos;
+
+	/** Frame scratch: non-zero if the listener passed the prefilter for the current target */
+	TArray<uint8> PassMask;
+
+	/** Frame scratch: registered targets that can be seen */
+	TArray<AActor*> Targets;
+
+	/** Frame scratch: pairs waiting for a trace */
+	TArray<TPair<FPerceptionListenerID, AActor*>> Candidates;
+
+	/** Frame scratch: trace priority of each candidate */
+	TArray<uint64> CandidateTraceFrames;
+
+	/** Frame scratch: candidate order */
+	TArray<int32> CandidateOrder;
+
+public:
+
+	UAISense_ShooterSight(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** Throttles how often the listener's pairs are retraced. The global min retrace frames still apply */
+	void SetListenerMinRetraceFrames(const FPerceptionListenerID& ListenerId, int32 MinRetraceFrames);
+
+	//~Begin UAISense interface
+	virtual void RegisterSource(AActor& SourceActor) override;
+	virtual void UnregisterSource(AActor& SourceActor) override;
+	//~End UAISense interface
+
+protected:
+
+	//~Begin UAISense interface
+	virtual float Update() override;
+	//~End UAISense interface
+
+	/** Digests the config of a new listener */
+	void OnNewListenerImpl(const FPerceptionListener& NewListener);
+
+	/** Re-digests the config of a listener */
+	void OnListenerUpdateImpl(const FPerceptionListener& UpdatedListener);
+
+	/** Forgets a listener and its pairs */
+	void OnListenerRemovedImpl(const FPerceptionListener& RemovedListener);
+
+	/** Applies the trace results that came back and publishes visibility changes */
+	void GatherResults();
+
+	/** Copies the listener data into the frame scratch arrays */
+	void GatherListeners();
+
+	/** Collects the registered targets that can be seen this frame, and drops the ones that are gone */
+	void GatherTargets();
+
+	/** Runs the distance and cone prefilter over every pair, and loses sight of pairs that fail it */
+	void PrefilterPairs();
+
+	/** Issues async traces for the oldest candidates, up to the frame budget */
+	void IssueTraces();
+
+	/** Publishes a visibility change to the listener */
+	void PublishVisibility(const FPerceptionListenerID& ListenerId, AActor* Target, bool bVisible);
+};
@@ -8,6 +8,8 @@
 #include "AIController.h"
 #include "Perception/AIPerceptionComponent.h"
 #include "ShooterAIController.h"
+#include "ShooterLineOfSight.h"
+#include "ShooterSightSense.h"
 #include "StateTreeAsyncExecutionContext.h"
 
 bool FStateTreeLineOfSightToTargetCondition::TestCondition(FStateTreeExecutionContext& Context) const
@@ -32,41 +34,25 @@ bool FStateTreeLineOfSightToTargetCondition::TestCondition(FStateTreeExecutionCo
 		return !InstanceData.bMustHaveLineOfSight;
 	}
 
-	// get the target's bounding box
-	FVector CenterOfMass, Extent;
-	InstanceData.Target->GetActorBounds(true, CenterOfMass, Extent, false);
-
-	// divide the vertical extent by the number of line of sight checks we'll do
-	const float ExtentZOffset = Extent.Z * 2.0f / InstanceData.NumberOfVerticalLineOfSightChecks;
-
 	// get the character's camera location as the source for the line checks
 	const FVector Start = InstanceData.Character->GetFirstPersonCameraComponent()->GetComponentLocation();
 
-	// ignore the character and target. We want to ensure there's an unobstructed trace not counting them
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(InstanceData.Character);
-	QueryParams.AddIgnoredActor(InstanceData.Target);
+	UWorld* World = InstanceData.Character->GetWorld();
 
-	FHitResult OutHit;
+	bool bHasLineOfSight = false;
 
-	// run a number of vertically offset line traces to the target location
-	for (int32 i = 0; i < InstanceData.NumberOfVerticalLineOfSightChecks - 1; ++i)
+	// read the cached verdict for this pair. The traces are batched and refreshed by the line of sight subsystem
+	if (UShooterLineOfSightSubsystem* LineOfSight = World->GetSubsystem<UShooterLineOfSightSubsystem>())
 	{
-		// calculate the endpoint for the trace
-		const FVector End = CenterOfMass + FVector(0.0f, 0.0f, Extent.Z - ExtentZOffset * i);
+		bHasLineOfSight = LineOfSight->HasLineOfSight(InstanceData.Character, Start, InstanceData.Target, InstanceData.NumberOfVerticalLineOfSightChecks);
+
+	} else {
 
-		InstanceData.Character->GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
+		bHasLineOfSight = UShooterLineOfSightSubsystem::TraceLineOfSight(World, InstanceData.Character, Start, InstanceData.Target, InstanceData.NumberOfVerticalLineOfSightChecks);
 
-		// is the trace unobstructed?
-		if (!OutHit.bBlockingHit)
-		{
-			// we only need one unobstructed trace, so terminate early
-			return InstanceData.bMustHaveLineOfSight;
-		}
 	}
 
-	// no line of sight found
-	return !InstanceData.bMustHaveLineOfSight;
+	return bHasLineOfSight ? InstanceData.bMustHaveLineOfSight : !InstanceData.bMustHaveLineOfSight;
 }
 
 #if WITH_EDITOR
@@ -242,16 +228,8 @@ EStateTreeRunStatus FStateTreeSenseEnemiesTask::EnterState(FStateTreeExecutionCo
 						// is the direction within our perception cone?
 						if (DirDot >= MaxDot)
 						{
-							// run a line trace between the character and the sensed actor
-							FCollisionQueryParams QueryParams;
-							QueryParams.AddIgnoredActor(LambdaInstanceData->Character);
-							QueryParams.AddIgnoredActor(SensedActor);
-
-							FHitResult OutHit;
-
-							// we have direct line of sight if this trace is unobstructed
-							bDirectLOS = !LambdaInstanceData->Character->GetWorld()->LineTraceSingleByChannel(OutHit, LambdaInstanceData->Character->GetActorLocation(), SensedActor->GetActorLocation(), ECC_Visibility, QueryParams);
-
+							// the shooter sight sense already traced the target, so a successful sight stimulus means direct line of sight
+							bDirectLOS = Stimulus.Type == UAISense::GetSenseID<UAISense_ShooterSight>() && Stimulus.WasSuccessfullySensed();
 						}
 
 						// check if we have a direct line of sight to the stimulus
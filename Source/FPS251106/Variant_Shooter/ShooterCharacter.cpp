@@ -13,7 +13,16 @@
 #include "TimerManager.h"
 #include "ShooterGameMode.h"
 #include "PVPGameMode.h"
+#include "ShooterLagCompensation.h"
 #include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "ShooterNetQuantize.h"
+#include "FPS251106.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aim Trace Fallbacks"), STAT_ShooterAimTraceFallbacks, STATGROUP_Shooter);
+
+/** Max age in frames of a cached aim trace before it's considered stale */
+static constexpr uint64 MaxAimTraceAge = 2;
 
 AShooterCharacter::AShooterCharacter()
 {
@@ -26,14 +35,25 @@ AShooterCharacter::AShooterCharacter()
 
 	// configure movement
 	GetCharacterMovement()->RotationRate = FRotator(0.0f, 600.0f, 0.0f);
+
+	// set up the default lag compensation hitboxes
+	LagCompensationHitboxes.Add(FShooterHitboxBone(FName("head"), 18.0f));
+	LagCompensationHitboxes.Add(FShooterHitboxBone(FName("spine_03"), 24.0f));
+	LagCompensationHitboxes.Add(FShooterHitboxBone(FName("pelvis"), 22.0f));
 }
 
 void AShooterCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
+	// pick the weapon seed before any weapon spawns. Clients receive it with our initial replication, before BeginPlay
+	if (HasAuthority())
+	{
+		WeaponSeed = GetTypeHash(FGuid::NewGuid());
+	}
+
 	// reset HP to max
-	CurrentHP = MaxHP;
+	SetCurrentHP(MaxHP);
 
 	// update the HUD
 	OnDamaged.Broadcast(1.0f);
@@ -43,6 +63,40 @@ void AShooterCharacter::BeginPlay()
 	{
 		AddWeaponClass(InitialWeaponClass);
 	}
+
+	// cache the async camera aim trace results
+	AimTraceDelegate.BindUObject(this, &AShooterCharacter::OnAimTraceCompleted);
+
+	// record our hitbox history so the server can evaluate shots from remote clients
+	if (HasAuthority())
+	{
+		if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+		{
+			LagCompensation->RegisterCharacter(this);
+		}
+	}
+}
+
+void AShooterCharacter::EndPlay(EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// stop recording our hitbox history
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+}
+
+void AShooterCharacter::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// only the local player aims through the camera
+	if (IsLocallyControlled())
+	{
+		RequestAimTrace();
+	}
 }
 
 void AShooterCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -78,7 +132,7 @@ float AShooterCharacter::TakeDamage(float Damage, struct FDamageEvent const& Dam
 	}
 
 	// Reduce HP
-	CurrentHP -= Damage;
+	SetCurrentHP(CurrentHP - Damage);
 
 	// Have we depleted HP?
 	if (CurrentHP <= 0.0f)
@@ -116,6 +170,12 @@ void AShooterCharacter::DoReload()
 	if (CurrentWeapon)
 	{
 		CurrentWeapon->StartReload();
+
+		// the server validates our shots against its own ammo count
+		if (GetNetMode() == NM_Client)
+		{
+			ServerReload();
+		}
 	}
 }
 
@@ -124,9 +184,6 @@ void AShooterCharacter::DoSwitchWeapon()
 	// ensure we have at least two weapons two switch between
 	if (OwnedWeapons.Num() > 1)
 	{
-		// deactivate the old weapon
-		CurrentWeapon->DeactivateWeapon();
-
 		// find the index of the current weapon in the owned list
 		int32 WeaponIndex = OwnedWeapons.Find(CurrentWeapon);
 
@@ -141,11 +198,76 @@ void AShooterCharacter::DoSwitchWeapon()
 			++WeaponIndex;
 		}
 
-		// set the new weapon as current
-		CurrentWeapon = OwnedWeapons[WeaponIndex];
+		SwitchToWeapon(WeaponIndex);
+
+		// the server fires our shots with its own copy of the weapon, so it has to switch too
+		if (GetNetMode() == NM_Client)
+		{
+			ServerSwitchWeapon(static_cast<uint8>(WeaponIndex));
+		}
+	}
+}
+
+void AShooterCharacter::SwitchToWeapon(int32 WeaponIndex)
+{
+	if (!OwnedWeapons.IsValidIndex(WeaponIndex) || OwnedWeapons[WeaponIndex] == CurrentWeapon)
+	{
+		return;
+	}
+
+	// deactivate the old weapon
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->DeactivateWeapon();
+	}
+
+	// set the new weapon as current
+	CurrentWeapon = OwnedWeapons[WeaponIndex];
+
+	// activate the new weapon
+	CurrentWeapon->ActivateWeapon();
+}
+
+void AShooterCharacter::ServerSwitchWeapon_Implementation(uint8 WeaponIndex)
+{
+	SwitchToWeapon(WeaponIndex);
+}
+
+void AShooterCharacter::ServerFire_Implementation(const FShooterFireEvent& FireEvent)
+{
+	// only the weapon we're holding here may fire. Shots that left the client before its switch reached us are dropped,
+	// since our copy of any other weapon has its own seed, fire mode, damage and ammo
+	AShooterWeapon* FiringWeapon = OwnedWeapons.IsValidIndex(FireEvent.WeaponIndex) ? OwnedWeapons[FireEvent.WeaponIndex] : nullptr;
+
+	if (FiringWeapon && FiringWeapon == CurrentWeapon)
+	{
+		FiringWeapon->HandleClientFireEvent(FireEvent);
+	}
+}
+
+void AShooterCharacter::ServerReload_Implementation()
+{
+	// reload our copy of the weapon, so the client's shots are counted against a full magazine afterwards
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->StartReload();
+	}
+}
+
+void AShooterCharacter::MulticastFireEvent_Implementation(const FShooterFireEvent& FireEvent)
+{
+	// the server and the shooter have already fired this shot
+	if (HasAuthority() || IsLocallyControlled())
+	{
+		return;
+	}
+
+	// play the shot for effects only, with the weapon that fired it if we have our own copy of it
+	AShooterWeapon* FiringWeapon = OwnedWeapons.IsValidIndex(FireEvent.WeaponIndex) ? OwnedWeapons[FireEvent.WeaponIndex] : CurrentWeapon.Get();
 
-		// activate the new weapon
-		CurrentWeapon->ActivateWeapon();
+	if (FiringWeapon)
+	{
+		FiringWeapon->HandleRemoteFireEvent(FireEvent);
 	}
 }
 
@@ -180,19 +302,87 @@ void AShooterCharacter::UpdateWeaponHUD(int32 CurrentAmmo, int32 MagazineSize)
 
 FVector AShooterCharacter::GetWeaponTargetLocation()
 {
-	// trace ahead from the camera viewpoint
-	FHitResult OutHit;
+	const FVector Start = GetFirstPersonCameraComponent()->GetComponentLocation();
+	const FVector Direction = GetFirstPersonCameraComponent()->GetForwardVector();
+
+	// only trace again if the camera moved too far since the cached trace
+	if (!IsAimCacheValid(Start, Direction))
+	{
+		INC_DWORD_STAT(STAT_ShooterAimTraceFallbacks);
+		TraceAimNow(Start, Direction);
+	}
+
+	// reuse the cached depth along the current aim, so the shot stays on the crosshair
+	return Start + (Direction * CachedAimDistance);
+}
+
+bool AShooterCharacter::GetCachedAimHit(FHitResult& OutHit) const
+{
+	OutHit = CachedAimHit;
+	return bHasCachedAim;
+}
 
+void AShooterCharacter::RequestAimTrace()
+{
 	const FVector Start = GetFirstPersonCameraComponent()->GetComponentLocation();
 	const FVector End = Start + (GetFirstPersonCameraComponent()->GetForwardVector() * MaxAimDistance);
 
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterAimTrace), false, this);
+
+	// the trace runs with the other async traces at the end of the frame, and reports back at the start of the next one
+	PendingAimFrame = GFrameCounter;
 
-	GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, ECC_Visibility, QueryParams, FCollisionResponseParams::DefaultResponseParam, &AimTraceDelegate);
+}
 
-	// return either the impact point or the trace end
-	return OutHit.bBlockingHit ? OutHit.ImpactPoint : OutHit.TraceEnd;
+void AShooterCharacter::OnAimTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceData)
+{
+	CacheAimTrace(TraceData.Start, TraceData.End, TraceData.OutHits.Num() > 0 ? &TraceData.OutHits[0] : nullptr, PendingAimFrame);
+}
+
+void AShooterCharacter::TraceAimNow(const FVector& Start, const FVector& Direction)
+{
+	FHitResult OutHit;
+
+	const FVector End = Start + (Direction * MaxAimDistance);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterAimTrace), false, this);
+
+	const bool bHit = GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
+
+	CacheAimTrace(Start, End, bHit ? &OutHit : nullptr, GFrameCounter);
+}
+
+void AShooterCharacter::CacheAimTrace(const FVector& Start, const FVector& End, const FHitResult* Hit, uint64 FrameNumber)
+{
+	if (Hit && Hit->bBlockingHit)
+	{
+		CachedAimHit = *Hit;
+		CachedAimDistance = Hit->Distance;
+
+	} else {
+
+		CachedAimHit = FHitResult(Start, End);
+		CachedAimDistance = MaxAimDistance;
+
+	}
+
+	CachedAimStart = Start;
+	CachedAimDirection = (End - Start).GetSafeNormal();
+	CachedAimFrame = FrameNumber;
+	bHasCachedAim = true;
+}
+
+bool AShooterCharacter::IsAimCacheValid(const FVector& Start, const FVector& Direction) const
+{
+	if (!bHasCachedAim || GFrameCounter - CachedAimFrame > MaxAimTraceAge)
+	{
+		return false;
+	}
+
+	// did the camera move or turn too much?
+	return FVector::DistSquared(Start, CachedAimStart) <= FMath::Square(AimCacheMaxDistance)
+		&& FVector::DotProduct(Direction, CachedAimDirection) >= FMath::Cos(FMath::DegreesToRadians(AimCacheMaxAngle));
 }
 
 void AShooterCharacter::AddWeaponClass(const TSubclassOf<AShooterWeapon>& WeaponClass)
@@ -229,6 +419,11 @@ void AShooterCharacter::AddWeaponClass(const TSubclassOf<AShooterWeapon>& Weapon
 	}
 }
 
+int32 AShooterCharacter::GetWeaponIndex(const AShooterWeapon* Weapon) const
+{
+	return OwnedWeapons.IndexOfByKey(Weapon);
+}
+
 void AShooterCharacter::OnWeaponActivated(AShooterWeapon* Weapon)
 {
 	// update the bullet counter
@@ -313,12 +508,36 @@ void AShooterCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& Ou
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(AShooterCharacter, CurrentHP);
-	DOREPLIFETIME(AShooterCharacter, TeamByte);
+	// these rarely change, so they're only compared when marked dirty
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterCharacter, ReplicatedHP, PushParams);
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterCharacter, TeamByte, PushParams);
+
+	// the weapon seed never changes after spawning
+	DOREPLIFETIME_CONDITION(AShooterCharacter, WeaponSeed, COND_InitialOnly);
+}
+
+void AShooterCharacter::SetCurrentHP(float NewHP)
+{
+	CurrentHP = NewHP;
+
+	// only dirty the property if the quantized value actually changed
+	const uint16 NewReplicatedHP = ShooterNetQuantize::QuantizeHealth(CurrentHP, MaxHP);
+
+	if (NewReplicatedHP != ReplicatedHP)
+	{
+		ReplicatedHP = NewReplicatedHP;
+		MARK_PROPERTY_DIRTY_FROM_NAME(AShooterCharacter, ReplicatedHP, this);
+	}
 }
 
-void AShooterCharacter::OnRep_CurrentHP()
+void AShooterCharacter::OnRep_ReplicatedHP()
 {
+	// rebuild the HP from its quantized fraction
+	CurrentHP = ShooterNetQuantize::DequantizeHealth(ReplicatedHP, MaxHP);
+
 	// Update the HUD when HP is replicated
 	OnDamaged.Broadcast(FMath::Max(0.0f, CurrentHP / MaxHP));
 }
@@ -5,6 +5,10 @@
 #include "CoreMinimal.h"
 #include "FPS251106Character.h"
 #include "ShooterWeaponHolder.h"
+#include "GenericTeamAgentInterface.h"
+#include "ShooterLagCompensation.h"
+#include "ShooterFireEvent.h"
+#include "WorldCollision.h"
 #include "Net/UnrealNetwork.h"
 #include "ShooterCharacter.generated.h"
 
@@ -22,7 +26,7 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDamagedDelegate, float, LifePercent
  *  Manages health and death
  */
 UCLASS(abstract)
-class FPS251106_API AShooterCharacter : public AFPS251106Character, public IShooterWeaponHolder
+class FPS251106_API AShooterCharacter : public AFPS251106Character, public IShooterWeaponHolder, public IGenericTeamAgentInterface
 {
 	GENERATED_BODY()
 	
@@ -60,18 +64,57 @@ protected:
 	UPROPERTY(EditAnywhere, Category ="Aim", meta = (ClampMin = 0, ClampMax = 100000, Units = "cm"))
 	float MaxAimDistance = 10000.0f;
 
+	/** Max distance the camera can move away from the cached aim trace before firing falls back to a synchronous trace */
+	UPROPERTY(EditAnywhere, Category ="Aim", meta = (ClampMin = 0, ClampMax = 1000, Units = "cm"))
+	float AimCacheMaxDistance = 20.0f;
+
+	/** Max angle the camera can turn away from the cached aim trace before firing falls back to a synchronous trace */
+	UPROPERTY(EditAnywhere, Category ="Aim", meta = (ClampMin = 0, ClampMax = 90, Units = "Degrees"))
+	float AimCacheMaxAngle = 2.0f;
+
+	/** Result of the last camera aim trace */
+	FHitResult CachedAimHit;
+
+	/** Start of the last camera aim trace */
+	FVector CachedAimStart = FVector::ZeroVector;
+
+	/** Direction of the last camera aim trace */
+	FVector CachedAimDirection = FVector::ForwardVector;
+
+	/** Distance to the aim hit of the last camera aim trace, or the max aim distance if nothing was hit */
+	float CachedAimDistance = 0.0f;
+
+	/** Frame the last camera aim trace was issued on */
+	uint64 CachedAimFrame = 0;
+
+	/** Frame the pending async camera aim trace was issued on */
+	uint64 PendingAimFrame = 0;
+
+	/** If true, we have a cached aim trace */
+	bool bHasCachedAim = false;
+
+	/** Called when the async camera aim trace completes */
+	FTraceDelegate AimTraceDelegate;
+
 	/** Max HP this character can have */
 	UPROPERTY(EditAnywhere, Category="Health")
 	float MaxHP = 500.0f;
 
-	/** Current HP remaining to this character */
-	UPROPERTY(ReplicatedUsing = OnRep_CurrentHP)
+	/** Current HP remaining to this character. Only authoritative on the server, clients rebuild it from ReplicatedHP */
 	float CurrentHP = 0.0f;
 
-	/** Team ID for this character*/
+	/** Current HP quantized to a fraction of MaxHP. Push model, marked dirty when HP changes */
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedHP)
+	uint16 ReplicatedHP = 0;
+
+	/** Team ID for this character. Push model */
 	UPROPERTY(EditAnywhere, Replicated, Category="Team")
 	uint8 TeamByte = 0;
 
+	/** Random seed picked by the server and sent once, so every machine's copies of our weapons spread the same way */
+	UPROPERTY(Replicated)
+	uint32 WeaponSeed = 0;
+
 	/** List of weapons picked up by the character */
 	TArray<AShooterWeapon*> OwnedWeapons;
 
@@ -81,6 +124,10 @@ protected:
 	UPROPERTY(EditAnywhere, Category ="Destruction", meta = (ClampMin = 0, ClampMax = 10, Units = "s"))
 	float RespawnTime = 5.0f;
 
+	/** Bone hitboxes recorded for server-side lag compensation, on top of the capsule */
+	UPROPERTY(EditAnywhere, Category="Lag Compensation")
+	TArray<FShooterHitboxBone> LagCompensationHitboxes;
+
 public:
 
 	/** Bullet count updated delegate */
@@ -99,6 +146,16 @@ protected:
 	/** Gameplay initialization */
 	virtual void BeginPlay() override;
 
+	/** Gameplay cleanup */
+	virtual void EndPlay(EEndPlayReason::Type EndPlayReason) override;
+
+public:
+
+	/** Issues the camera aim trace for this frame */
+	virtual void Tick(float DeltaTime) override;
+
+protected:
+
 	/** Set up input action bindings */
 	virtual void SetupPlayerInputComponent(UInputComponent* InputComponent) override;
 
@@ -107,6 +164,10 @@ public:
 	/** Handle incoming damage */
 	virtual float TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
+	/** Returns true if this character's HP has been depleted */
+	UFUNCTION(BlueprintPure, Category="Health")
+	bool IsDead() const { return CurrentHP <= 0.0f; }
+
 	/** Last damage instigator controller (stored when taking damage) */
 	UPROPERTY()
 	TObjectPtr<AController> LastDamageInstigatorController;
@@ -160,13 +221,69 @@ public:
 	/** Notifies the owner that the weapon cooldown has expired and it's ready to shoot again */
 	virtual void OnSemiWeaponRefire() override;
 
+	/** Returns the replicated weapon seed */
+	virtual uint32 GetWeaponSeed() const override { return WeaponSeed; }
+
+	/** Returns the index of the weapon in the owned list */
+	virtual int32 GetWeaponIndex(const AShooterWeapon* Weapon) const override;
+
 	//~End IShooterWeaponHolder interface
 
+	//~Begin IGenericTeamAgentInterface interface
+
+	/** Returns the team byte as a generic team, so perception can tell friend from foe */
+	virtual FGenericTeamId GetGenericTeamId() const override { return FGenericTeamId(TeamByte); }
+
+	//~End IGenericTeamAgentInterface interface
+
+public:
+
+	/** Returns the bone hitboxes recorded for lag compensation */
+	const TArray<FShooterHitboxBone>& GetLagCompensationHitboxes() const { return LagCompensationHitboxes; }
+
+	/** Asks the server to fire the authoritative version of a shot fired by this client. Unreliable, since it's sent once per bullet */
+	UFUNCTION(Server, Unreliable)
+	void ServerFire(const FShooterFireEvent& FireEvent);
+
+	/** Asks the server to reload its copy of the current weapon, so it keeps counting this client's ammo */
+	UFUNCTION(Server, Reliable)
+	void ServerReload();
+
+	/** Asks the server to switch to the same weapon this client switched to, so it fires the client's shots with it */
+	UFUNCTION(Server, Reliable)
+	void ServerSwitchWeapon(uint8 WeaponIndex);
+
+	/** Replicates a shot to the other machines so they can play it as a cosmetic-only shot */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireEvent(const FShooterFireEvent& FireEvent);
+
+	/** Returns the result of the last camera aim trace. Returns false if there's no cached trace yet */
+	UFUNCTION(BlueprintPure, Category="Aim")
+	bool GetCachedAimHit(FHitResult& OutHit) const;
+
 protected:
 
+	/** Issues an async camera aim trace. The result is cached when it completes on the next frame */
+	void RequestAimTrace();
+
+	/** Caches the result of the async camera aim trace */
+	void OnAimTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceData);
+
+	/** Runs the camera aim trace synchronously and caches its result */
+	void TraceAimNow(const FVector& Start, const FVector& Direction);
+
+	/** Caches the result of a camera aim trace */
+	void CacheAimTrace(const FVector& Start, const FVector& End, const FHitResult* Hit, uint64 FrameNumber);
+
+	/** Returns true if the cached aim trace is still close enough to the given camera viewpoint to be reused */
+	bool IsAimCacheValid(const FVector& Start, const FVector& Direction) const;
+
 	/** Returns true if the character already owns a weapon of the given class */
 	AShooterWeapon* FindWeaponOfType(TSubclassOf<AShooterWeapon> WeaponClass) const;
 
+	/** Deactivates the current weapon and activates the owned weapon at the given index */
+	void SwitchToWeapon(int32 WeaponIndex);
+
 	/** Called when this character's HP is depleted */
 	void Die();
 
@@ -179,7 +296,10 @@ protected:
 	/** Network replication */
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
-	/** Called when CurrentHP is replicated */
+	/** Sets the current HP and marks its replicated value dirty */
+	void SetCurrentHP(float NewHP);
+
+	/** Called when ReplicatedHP is replicated */
 	UFUNCTION()
-	void OnRep_CurrentHP();
+	void OnRep_ReplicatedHP();
 };
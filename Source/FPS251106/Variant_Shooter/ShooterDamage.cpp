@@ -0,0 +1,117 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterDamage.h"
+#include "ShooterCharacter.h"
+#include "ShooterNPC.h"
+#include "ShooterGameMode.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/DamageEvents.h"
+#include "Engine/World.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Damage Resolve"), STAT_ShooterDamageResolve, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Damage Hits"), STAT_ShooterDamageHits, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Damage Kills"), STAT_ShooterDamageKills, STATGROUP_Shooter);
+
+void UShooterDamageSubsystem::QueueHit(AActor* Target, float Damage, APawn* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType)
+{
+	if (!Target)
+	{
+		return;
+	}
+
+	FShooterQueuedHit& Hit = QueuedHits.AddDefaulted_GetRef();
+	Hit.Target = Target;
+	Hit.Damage = Damage;
+	Hit.Instigator = Instigator;
+	Hit.Causer = Causer;
+	Hit.DamageType = DamageType;
+}
+
+bool UShooterDamageSubsystem::IsTargetDead(const AActor* Target)
+{
+	if (const AShooterCharacter* Character = Cast<AShooterCharacter>(Target))
+	{
+		return Character->IsDead();
+	}
+
+	if (const AShooterNPC* NPC = Cast<AShooterNPC>(Target))
+	{
+		return NPC->IsDead();
+	}
+
+	return false;
+}
+
+void UShooterDamageSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (QueuedHits.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterDamageResolve);
+	INC_DWORD_STAT_BY(STAT_ShooterDamageHits, QueuedHits.Num());
+
+	// swap the queues so hits caused by this resolve wait for the next frame
+	Swap(QueuedHits, ResolvingHits);
+
+	ResolveHits();
+
+	ResolvingHits.Reset();
+}
+
+TStatId UShooterDamageSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterDamageSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterDamageSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterDamageSubsystem::ResolveHits()
+{
+	AShooterGameMode* GameMode = Cast<AShooterGameMode>(GetWorld()->GetAuthGameMode());
+
+	// add up the hit score for the whole frame so the game mode and UI only update once.
+	// Kills are scored by the NPC itself when it dies, since not every death comes through here
+	int32 ScoreDelta = 0;
+
+	for (const FShooterQueuedHit& Hit : ResolvingHits)
+	{
+		AActor* Target = Hit.Target;
+
+		// skip targets destroyed or killed by an earlier hit
+		if (!IsValid(Target) || IsTargetDead(Target))
+		{
+			continue;
+		}
+
+		// apply the damage the same way UGameplayStatics::ApplyDamage would
+		if (Hit.Damage != 0.0f)
+		{
+			const TSubclassOf<UDamageType> DamageType = Hit.DamageType ? Hit.DamageType : TSubclassOf<UDamageType>(UDamageType::StaticClass());
+			const FDamageEvent DamageEvent(DamageType);
+
+			Target->TakeDamage(Hit.Damage, DamageEvent, Hit.Instigator ? Hit.Instigator->GetController() : nullptr, Hit.Causer);
+		}
+
+		ScoreDelta += AShooterGameMode::GetHitScore(Hit.Instigator, Target);
+
+		// this hit got the kill if it took the target down
+		if (IsTargetDead(Target))
+		{
+			INC_DWORD_STAT(STAT_ShooterDamageKills);
+		}
+	}
+
+	if (GameMode && ScoreDelta != 0)
+	{
+		GameMode->AddScore(ScoreDelta);
+	}
+}
@@ -0,0 +1,83 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameFramework/DamageType.h"
+#include "ShooterDamage.generated.h"
+
+class AActor;
+class APawn;
+
+/**
+ *  A hit waiting to be resolved by the damage subsystem
+ */
+USTRUCT()
+struct FShooterQueuedHit
+{
+	GENERATED_BODY()
+
+	/** Actor taking the damage */
+	UPROPERTY()
+	TObjectPtr<AActor> Target;
+
+	/** Pawn that fired the shot */
+	UPROPERTY()
+	TObjectPtr<APawn> Instigator;
+
+	/** Actor that deals the damage, either the projectile or the weapon */
+	UPROPERTY()
+	TObjectPtr<AActor> Causer;
+
+	/** Type of damage to apply */
+	UPROPERTY()
+	TSubclassOf<UDamageType> DamageType;
+
+	/** Damage to apply */
+	float Damage = 0.0f;
+};
+
+/**
+ *  World subsystem that resolves all shooter damage once per frame
+ *  Hits are appended to a queue as they happen, then resolved in order in a single pass:
+ *  damage is applied, deaths are detected and attributed to the hit that caused them,
+ *  and hit score deltas are added up and handed to the game mode once. Kills are scored by the NPC when it dies.
+ *  Hits on targets killed earlier in the same frame are dropped, so only one shot gets the kill.
+ */
+UCLASS()
+class FPS251106_API UShooterDamageSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Hits queued since the last resolve */
+	UPROPERTY()
+	TArray<FShooterQueuedHit> QueuedHits;
+
+	/** Hits being resolved. Hits queued while resolving wait for the next frame */
+	UPROPERTY()
+	TArray<FShooterQueuedHit> ResolvingHits;
+
+public:
+
+	/** Queues damage on the target. It's applied when the subsystem ticks */
+	void QueueHit(AActor* Target, float Damage, APawn* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType);
+
+	/** Returns true if the target is a shooter character or NPC that has already died */
+	static bool IsTargetDead(const AActor* Target);
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only resolve damage in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Applies every queued hit in order */
+	void ResolveHits();
+};
@@ -5,6 +5,9 @@
 #include "Variant_Shooter/UI/ShooterUI.h"
 #include "Variant_Shooter/UI/GameOverUI.h"
 #include "Variant_Shooter/ShooterCharacter.h"
+#include "Variant_Shooter/AI/ShooterNPC.h"
+#include "Variant_Shooter/ShooterSpawnRegistry.h"
+#include "GameFramework/PlayerStart.h"
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 
@@ -32,6 +35,44 @@ void AShooterGameMode::BeginPlay()
 	}
 }
 
+AActor* AShooterGameMode::ChoosePlayerStart_Implementation(AController* Player)
+{
+	// spawn away from and out of sight of the other players
+	if (UShooterSpawnRegistrySubsystem* SpawnRegistry = GetWorld()->GetSubsystem<UShooterSpawnRegistrySubsystem>())
+	{
+		// play-from-here in the editor takes precedence
+		if (APlayerStart* PlayInEditorStart = SpawnRegistry->GetPlayInEditorStart())
+		{
+			return PlayInEditorStart;
+		}
+
+		// skip spawns the new pawn wouldn't fit in
+		const UClass* PawnClass = GetDefaultPawnClassForController(Player);
+		const APawn* PawnToFit = PawnClass ? PawnClass->GetDefaultObject<APawn>() : nullptr;
+
+		const auto IsThreat = [this, Player](const APawn* Pawn) { return IsPlayerSpawnThreat(Pawn, Player); };
+
+		if (APlayerStart* Spawn = SpawnRegistry->FindSafestSpawn(PlayerSpawnMinDistance, IsThreat, PawnToFit))
+		{
+			SpawnRegistry->MarkSpawnUsed(Spawn);
+			return Spawn;
+		}
+	}
+
+	// players that log in before the world begins play come before the registry is built
+	return Super::ChoosePlayerStart_Implementation(Player);
+}
+
+bool AShooterGameMode::ShouldSpawnAtStartSpot(AController* Player)
+{
+	return false;
+}
+
+bool AShooterGameMode::IsPlayerSpawnThreat(const APawn* Pawn, const AController* Player) const
+{
+	return Pawn->IsA<AShooterNPC>();
+}
+
 void AShooterGameMode::IncrementTeamScore(uint8 TeamByte)
 {
 	// retrieve the team score if any
@@ -68,6 +109,39 @@ void AShooterGameMode::AddScore(int32 Delta)
 	}
 }
 
+int32 AShooterGameMode::GetHitScore(const APawn* InstigatorPawn, const AActor* HitActor)
+{
+	const bool bPlayerInstigator = Cast<AShooterCharacter>(InstigatorPawn) != nullptr;
+	const bool bEnemyInstigator = Cast<AShooterNPC>(InstigatorPawn) != nullptr;
+
+	const bool bPlayerTarget = Cast<AShooterCharacter>(HitActor) != nullptr;
+	const bool bEnemyTarget = Cast<AShooterNPC>(HitActor) != nullptr;
+
+	// player hits an enemy: +10
+	if (bPlayerInstigator && bEnemyTarget)
+	{
+		return 10;
+	}
+
+	// enemy hits the player: -15
+	if (bEnemyInstigator && bPlayerTarget)
+	{
+		return -15;
+	}
+
+	return 0;
+}
+
+int32 AShooterGameMode::GetKillScore(const APawn* KillerPawn, const AActor* KilledActor)
+{
+	// only players score kills. Enemy friendly fire, horde shots and unknown killers don't
+	const bool bPlayerKiller = Cast<AShooterCharacter>(KillerPawn) != nullptr;
+	const bool bEnemyKilled = Cast<AShooterNPC>(KilledActor) != nullptr;
+
+	// player kills an enemy: +50
+	return bPlayerKiller && bEnemyKilled ? 50 : 0;
+}
+
 float AShooterGameMode::GetElapsedTime() const
 {
 	if (const UWorld* World = GetWorld())
@@ -46,11 +46,24 @@ protected:
 	UPROPERTY()
 	TObjectPtr<UGameOverUI> GameOverUI;
 
+	/** Players avoid spawn points closer than this to a living threat when there's a choice */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Shooter|Spawning", meta = (ClampMin = 0, Units = "cm"))
+	float PlayerSpawnMinDistance = 2000.0f;
+
 protected:
 
 	/** Gameplay initialization */
 	virtual void BeginPlay() override;
 
+	/** Picks the safest spawn point from the spawn registry */
+	virtual AActor* ChoosePlayerStart_Implementation(AController* Player) override;
+
+	/** Always pick a fresh spawn point, so respawns don't reuse the previous one */
+	virtual bool ShouldSpawnAtStartSpot(AController* Player) override;
+
+	/** Returns true if a player should spawn away from the given pawn. In co-op, that's the enemy NPCs */
+	virtual bool IsPlayerSpawnThreat(const APawn* Pawn, const AController* Player) const;
+
 public:
 
 	/** Increases the score for the given team (legacy team scoreboard logic) */
@@ -59,6 +72,12 @@ public:
 	/** Adds score to the player (positive or negative) and updates the UI */
 	void AddScore(int32 Delta);
 
+	/** Returns the score awarded when the instigator hits the given actor: player hits enemy +10, enemy hits player -15 */
+	static int32 GetHitScore(const APawn* InstigatorPawn, const AActor* HitActor);
+
+	/** Returns the score awarded when the killer takes down the given actor: player kills enemy +50. Unknown killers don't score */
+	static int32 GetKillScore(const APawn* KillerPawn, const AActor* KilledActor);
+
 	/** Returns the current player score */
 	UFUNCTION(BlueprintPure, Category="Shooter|Score")
 	int32 GetPlayerScore() const { return PlayerScore; }
@@ -0,0 +1,70 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Variant_Shooter/ShooterGameState.h"
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+
+void AShooterGameState::SetWaveState(const FShooterWaveState& NewWaveState)
+{
+	const FShooterWaveState OldWaveState = WaveState;
+
+	WaveState = NewWaveState;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AShooterGameState, WaveState, this);
+
+	// the server and a listen server host get the events right away
+	BroadcastWaveChanges(OldWaveState);
+}
+
+void AShooterGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// only compared when the wave spawner changes it
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+
+	DOREPLIFETIME_WITH_PARAMS_FAST(AShooterGameState, WaveState, PushParams);
+}
+
+void AShooterGameState::OnRep_WaveState(const FShooterWaveState& OldWaveState)
+{
+	BroadcastWaveChanges(OldWaveState);
+}
+
+void AShooterGameState::BroadcastWaveChanges(const FShooterWaveState& OldWaveState)
+{
+	// report in the order the spawner raises them, so a merged update still reads as a sequence
+	if (WaveState.NumWavesSpawned > OldWaveState.NumWavesSpawned)
+	{
+		OnWaveSpawned.Broadcast(WaveState.LastSpawnedWave);
+	}
+
+	if (WaveState.IncomingWave != INDEX_NONE && (WaveState.IncomingWave != OldWaveState.IncomingWave || WaveState.IncomingStartTime != OldWaveState.IncomingStartTime))
+	{
+		// the delay left on this machine's clock
+		const float Delay = FMath::Max(0.0f, static_cast<float>(WaveState.IncomingStartTime - GetServerWorldTimeSeconds()));
+
+		OnWaveIncoming.Broadcast(WaveState.IncomingWave, WaveState.IncomingEnemyCount, Delay);
+	}
+
+	if (WaveState.CurrentWave != INDEX_NONE)
+	{
+		const bool bStarted = WaveState.CurrentWave != OldWaveState.CurrentWave;
+
+		if (bStarted)
+		{
+			OnWaveStarted.Broadcast(WaveState.CurrentWave);
+		}
+
+		if (bStarted ? WaveState.NumSpawned > 0 : WaveState.NumSpawned != OldWaveState.NumSpawned)
+		{
+			OnWaveProgress.Broadcast(WaveState.CurrentWave, WaveState.NumSpawned, WaveState.NumTotal);
+		}
+	}
+
+	if (WaveState.bAllWavesSpawned && !OldWaveState.bAllWavesSpawned)
+	{
+		OnAllWavesSpawned.Broadcast();
+	}
+}
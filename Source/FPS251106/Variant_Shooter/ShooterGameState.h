@@ -0,0 +1,69 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameStateBase.h"
+#include "ShooterWaveSpawner.h"
+#include "ShooterGameState.generated.h"
+
+/**
+ *  GameState for the multiplayer shooter
+ *  Replicates the wave progress of the game mode's wave spawner, which only exists on the server, and raises
+ *  the same wave events on every machine so clients can drive their wave UI. Replication can merge several
+ *  changes into one update, so the events are derived from the difference between the old and new state.
+ */
+UCLASS()
+class FPS251106_API AShooterGameState : public AGameStateBase
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Wave progress. Push model, marked dirty when the server updates it */
+	UPROPERTY(ReplicatedUsing = OnRep_WaveState)
+	FShooterWaveState WaveState;
+
+public:
+
+	/** Called when a wave is about to start after its delay */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveIncomingDelegate OnWaveIncoming;
+
+	/** Called when a wave starts spawning */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveStartedDelegate OnWaveStarted;
+
+	/** Called when more enemies of the current wave have spawned */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveProgressDelegate OnWaveProgress;
+
+	/** Called when every enemy of a wave has been spawned */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveSpawnedDelegate OnWaveSpawned;
+
+	/** Called when the last wave has been spawned */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterAllWavesSpawnedDelegate OnAllWavesSpawned;
+
+public:
+
+	/** Sets the wave progress and raises the wave events. Server only */
+	void SetWaveState(const FShooterWaveState& NewWaveState);
+
+	/** Returns the wave progress */
+	UFUNCTION(BlueprintPure, Category="Waves")
+	const FShooterWaveState& GetWaveState() const { return WaveState; }
+
+protected:
+
+	/** Network replication */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Called when WaveState is replicated */
+	UFUNCTION()
+	void OnRep_WaveState(const FShooterWaveState& OldWaveState);
+
+	/** Raises the wave events for everything that changed between the two states */
+	void BroadcastWaveChanges(const FShooterWaveState& OldWaveState);
+};
@@ -0,0 +1,376 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterLagCompensation.h"
+#include "ShooterCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/PlayerState.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Record"), STAT_ShooterLagCompensationRecord, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Rewind"), STAT_ShooterLagCompensationRewind, STATGROUP_Shooter);
+
+static int32 GShooterLagCompensationEnabled = 1;
+static FAutoConsoleVariableRef CVarShooterLagCompensationEnabled(
+	TEXT("Shooter.LagCompensation.Enabled"),
+	GShooterLagCompensationEnabled,
+	TEXT("If non-zero, shots fired by remote clients are evaluated against rewound character hitboxes"),
+	ECVF_Default
+);
+
+static float GShooterLagCompensationMaxRewindTime = 0.4f;
+static FAutoConsoleVariableRef CVarShooterLagCompensationMaxRewindTime(
+	TEXT("Shooter.LagCompensation.MaxRewindTime"),
+	GShooterLagCompensationMaxRewindTime,
+	TEXT("Max time in seconds the server will rewind characters to evaluate a shot"),
+	ECVF_Default
+);
+
+static int32 GShooterLagCompensationHistoryFrames = 64;
+static FAutoConsoleVariableRef CVarShooterLagCompensationHistoryFrames(
+	TEXT("Shooter.LagCompensation.HistoryFrames"),
+	GShooterLagCompensationHistoryFrames,
+	TEXT("Number of hitbox snapshots kept per character. Applies to characters registered after the change"),
+	ECVF_Default
+);
+
+/** Finds where a segment enters a sphere. Returns false if it doesn't */
+static bool SegmentSphereEntry(const FVector& Start, const FVector& Dir, float Length, const FVector& Center, float Radius, float& OutDistance)
+{
+	const FVector ToStart = Start - Center;
+	const float B = FVector::DotProduct(ToStart, Dir);
+	const float C = ToStart.SizeSquared() - FMath::Square(Radius);
+
+	// starting outside and pointing away
+	if (C > 0.0f && B > 0.0f)
+	{
+		return false;
+	}
+
+	const float Discriminant = B * B - C;
+
+	if (Discriminant < 0.0f)
+	{
+		return false;
+	}
+
+	// clamp to the start if we began inside the sphere
+	const float Distance = FMath::Max(0.0f, -B - FMath::Sqrt(Discriminant));
+
+	if (Distance > Length)
+	{
+		return false;
+	}
+
+	OutDistance = Distance;
+	return true;
+}
+
+void UShooterLagCompensationSubsystem::RegisterCharacter(AShooterCharacter* Character)
+{
+	if (!IsValid(Character) || TrackedActors.Contains(Character))
+	{
+		return;
+	}
+
+	FShooterHitboxHistory& History = Histories.AddDefaulted_GetRef();
+	History.Character = Character;
+	History.CapsuleRadius = Character->GetCapsuleComponent()->GetScaledCapsuleRadius();
+	History.CapsuleHalfHeight = Character->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	History.Bones = Character->GetLagCompensationHitboxes();
+
+	// allocate the whole history up front so recording never allocates
+	const int32 NumFrames = FMath::Clamp(GShooterLagCompensationHistoryFrames, 2, 512);
+
+	History.Frames.SetNum(NumFrames);
+	History.BoneLocations.SetNumZeroed(NumFrames * History.Bones.Num());
+
+	TrackedActors.Add(Character);
+}
+
+void UShooterLagCompensationSubsystem::UnregisterCharacter(AShooterCharacter* Character)
+{
+	const int32 Index = TrackedActors.Find(Character);
+
+	if (Index != INDEX_NONE)
+	{
+		Histories.RemoveAtSwap(Index);
+		TrackedActors.RemoveAtSwap(Index);
+	}
+}
+
+bool UShooterLagCompensationSubsystem::IsLagCompensationActive() const
+{
+	if (GShooterLagCompensationEnabled == 0)
+	{
+		return false;
+	}
+
+	// only servers with remote clients need to rewind
+	const ENetMode NetMode = GetWorld()->GetNetMode();
+
+	return NetMode == NM_DedicatedServer || NetMode == NM_ListenServer;
+}
+
+double UShooterLagCompensationSubsystem::GetMaxRewindTime()
+{
+	return FMath::Max(GShooterLagCompensationMaxRewindTime, 0.0f);
+}
+
+double UShooterLagCompensationSubsystem::GetRewindTime(double ClientTimestamp, const APawn* Shooter) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// the client sees other characters where they were one trip ago, so go back half the round trip from its timestamp
+	double RewindTime = ClientTimestamp;
+
+	if (const APlayerState* PlayerState = Shooter ? Shooter->GetPlayerState() : nullptr)
+	{
+		RewindTime -= PlayerState->GetPingInMilliseconds() * 0.0005;
+	}
+
+	// never rewind further than allowed, or into the future
+	return FMath::Clamp(RewindTime, Now - GShooterLagCompensationMaxRewindTime, Now);
+}
+
+bool UShooterLagCompensationSubsystem::TraceRewound(const FVector& Start, const FVector& End, double RewindTime, const AActor* IgnoredActor, FHitResult& OutHit) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterLagCompensationRewind);
+
+	FVector Dir;
+	float Length;
+	(End - Start).ToDirectionAndLength(Dir, Length);
+
+	if (Length <= UE_KINDA_SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	float BestDistance = Length;
+	int32 BestHistory = INDEX_NONE;
+	int32 BestBone = INDEX_NONE;
+	FVector BestCenter = FVector::ZeroVector;
+
+	// rewound bone locations for the current character
+	TArray<FVector, TInlineAllocator<16>> RewoundBones;
+
+	for (int32 HistoryIndex = 0; HistoryIndex < Histories.Num(); ++HistoryIndex)
+	{
+		const FShooterHitboxHistory& History = Histories[HistoryIndex];
+		const AShooterCharacter* Character = History.Character.Get();
+
+		if (!Character || Character == IgnoredActor)
+		{
+			continue;
+		}
+
+		int32 Older, Newer;
+		float Alpha;
+
+		if (!FindFrames(History, RewindTime, Older, Newer, Alpha))
+		{
+			continue;
+		}
+
+		// blend the capsule between the two snapshots
+		const FShooterHitboxFrame& OlderFrame = History.Frames[Older];
+		const FShooterHitboxFrame& NewerFrame = History.Frames[Newer];
+
+		const FVector CapsuleLocation = FMath::Lerp(OlderFrame.CapsuleLocation, NewerFrame.CapsuleLocation, Alpha);
+		const FQuat CapsuleRotation = FQuat::Slerp(OlderFrame.CapsuleRotation, NewerFrame.CapsuleRotation, Alpha);
+
+		// test the capsule first. Find the closest point on its axis and enter the sphere around it
+		const FVector AxisOffset = CapsuleRotation.GetUpVector() * FMath::Max(0.0f, History.CapsuleHalfHeight - History.CapsuleRadius);
+
+		FVector SegmentPoint, AxisPoint;
+		FMath::SegmentDistToSegmentSafe(Start, End, CapsuleLocation - AxisOffset, CapsuleLocation + AxisOffset, SegmentPoint, AxisPoint);
+
+		if (FVector::DistSquared(SegmentPoint, AxisPoint) > FMath::Square(History.CapsuleRadius))
+		{
+			continue;
+		}
+
+		float CapsuleDistance;
+
+		if (!SegmentSphereEntry(Start, Dir, BestDistance, AxisPoint, History.CapsuleRadius, CapsuleDistance))
+		{
+			continue;
+		}
+
+		// the capsule was hit, so refine with the bone hitboxes
+		const int32 NumBones = History.Bones.Num();
+
+		RewoundBones.Reset();
+
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+		{
+			RewoundBones.Add(FMath::Lerp(History.BoneLocations[Older * NumBones + BoneIndex], History.BoneLocations[Newer * NumBones + BoneIndex], Alpha));
+		}
+
+		int32 HitBone = INDEX_NONE;
+		float HitDistance = CapsuleDistance;
+		FVector HitCenter = AxisPoint;
+
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+		{
+			float BoneDistance;
+
+			if (SegmentSphereEntry(Start, Dir, BestDistance, RewoundBones[BoneIndex], History.Bones[BoneIndex].Radius, BoneDistance))
+			{
+				if (HitBone == INDEX_NONE || BoneDistance < HitDistance)
+				{
+					HitBone = BoneIndex;
+					HitDistance = BoneDistance;
+					HitCenter = RewoundBones[BoneIndex];
+				}
+			}
+		}
+
+		if (HitDistance <= BestDistance)
+		{
+			BestDistance = HitDistance;
+			BestHistory = HistoryIndex;
+			BestBone = HitBone;
+			BestCenter = HitCenter;
+		}
+	}
+
+	if (BestHistory == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// build the hit result
+	const FShooterHitboxHistory& History = Histories[BestHistory];
+	AShooterCharacter* HitCharacter = History.Character.Get();
+
+	const FVector ImpactPoint = Start + Dir * BestDistance;
+
+	OutHit = FHitResult(HitCharacter, nullptr, ImpactPoint, (ImpactPoint - BestCenter).GetSafeNormal());
+	OutHit.bBlockingHit = true;
+	OutHit.TraceStart = Start;
+	OutHit.TraceEnd = End;
+	OutHit.Location = ImpactPoint;
+	OutHit.Distance = BestDistance;
+	OutHit.Time = BestDistance / Length;
+
+	if (BestBone != INDEX_NONE)
+	{
+		OutHit.Component = HitCharacter->GetMesh();
+		OutHit.BoneName = History.Bones[BestBone].BoneName;
+
+	} else {
+
+		OutHit.Component = HitCharacter->GetCapsuleComponent();
+
+	}
+
+	return true;
+}
+
+void UShooterLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Histories.Num() == 0 || !IsLagCompensationActive())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterLagCompensationRecord);
+
+	// we tick after the actors, so this is where the characters ended up this frame
+	const double Timestamp = GetWorld()->GetTimeSeconds();
+
+	for (FShooterHitboxHistory& History : Histories)
+	{
+		RecordFrame(History, Timestamp);
+	}
+}
+
+TStatId UShooterLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterLagCompensationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterLagCompensationSubsystem::RecordFrame(FShooterHitboxHistory& History, double Timestamp)
+{
+	const AShooterCharacter* Character = History.Character.Get();
+
+	if (!Character)
+	{
+		return;
+	}
+
+	// advance the ring buffer, overwriting the oldest snapshot
+	History.Head = (History.Head + 1) % History.Frames.Num();
+	History.NumFrames = FMath::Min(History.NumFrames + 1, History.Frames.Num());
+
+	const UCapsuleComponent* Capsule = Character->GetCapsuleComponent();
+
+	FShooterHitboxFrame& Frame = History.Frames[History.Head];
+	Frame.Timestamp = Timestamp;
+	Frame.CapsuleLocation = Capsule->GetComponentLocation();
+	Frame.CapsuleRotation = Capsule->GetComponentQuat();
+
+	// record the bone hitboxes
+	const USkeletalMeshComponent* Mesh = Character->GetMesh();
+	const int32 NumBones = History.Bones.Num();
+
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		History.BoneLocations[History.Head * NumBones + BoneIndex] = Mesh->GetSocketLocation(History.Bones[BoneIndex].BoneName);
+	}
+}
+
+bool UShooterLagCompensationSubsystem::FindFrames(const FShooterHitboxHistory& History, double Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const
+{
+	if (History.NumFrames == 0)
+	{
+		return false;
+	}
+
+	const int32 Capacity = History.Frames.Num();
+
+	// newer than our latest snapshot, so use it as is
+	if (Time >= History.Frames[History.Head].Timestamp)
+	{
+		OutOlder = OutNewer = History.Head;
+		OutAlpha = 0.0f;
+		return true;
+	}
+
+	// walk back from the newest snapshot until we pass the requested time
+	int32 Newer = History.Head;
+
+	for (int32 Step = 1; Step < History.NumFrames; ++Step)
+	{
+		const int32 Older = (History.Head - Step + Capacity) % Capacity;
+		const double OlderTime = History.Frames[Older].Timestamp;
+
+		if (OlderTime <= Time)
+		{
+			const double NewerTime = History.Frames[Newer].Timestamp;
+
+			OutOlder = Older;
+			OutNewer = Newer;
+			OutAlpha = NewerTime > OlderTime ? static_cast<float>((Time - OlderTime) / (NewerTime - OlderTime)) : 0.0f;
+			return true;
+		}
+
+		Newer = Older;
+	}
+
+	// older than our history, so use the oldest snapshot
+	OutOlder = OutNewer = Newer;
+	OutAlpha = 0.0f;
+	return true;
+}
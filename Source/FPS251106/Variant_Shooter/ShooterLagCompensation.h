@@ -0,0 +1,140 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/HitResult.h"
+#include "ShooterLagCompensation.generated.h"
+
+class AShooterCharacter;
+class APawn;
+
+/**
+ *  A sphere hitbox following a bone of the character mesh
+ */
+USTRUCT(BlueprintType)
+struct FShooterHitboxBone
+{
+	GENERATED_BODY()
+
+	/** Bone or socket the hitbox follows */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hitbox")
+	FName BoneName;
+
+	/** Radius of the hitbox */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hitbox", meta = (ClampMin = 0, ClampMax = 200, Units = "cm"))
+	float Radius = 20.0f;
+
+	FShooterHitboxBone()
+	{
+	}
+
+	FShooterHitboxBone(FName InBoneName, float InRadius)
+		: BoneName(InBoneName)
+		, Radius(InRadius)
+	{
+	}
+};
+
+/**
+ *  Hitbox snapshot of a character for a single server frame
+ */
+struct FShooterHitboxFrame
+{
+	/** Server time the snapshot was taken at */
+	double Timestamp = 0.0;
+
+	/** Capsule location */
+	FVector CapsuleLocation = FVector::ZeroVector;
+
+	/** Capsule rotation */
+	FQuat CapsuleRotation = FQuat::Identity;
+};
+
+/**
+ *  Fixed-size ring buffer of hitbox snapshots for a single character
+ */
+struct FShooterHitboxHistory
+{
+	/** Character this history belongs to */
+	TWeakObjectPtr<AShooterCharacter> Character;
+
+	/** Capsule size at registration */
+	float CapsuleRadius = 0.0f;
+	float CapsuleHalfHeight = 0.0f;
+
+	/** Bone hitboxes at registration */
+	TArray<FShooterHitboxBone> Bones;
+
+	/** Capsule snapshots. Allocated once at registration */
+	TArray<FShooterHitboxFrame> Frames;
+
+	/** Bone locations for every snapshot, NumBones per frame. Allocated once at registration */
+	TArray<FVector> BoneLocations;
+
+	/** Index of the most recent snapshot */
+	int32 Head = INDEX_NONE;
+
+	/** Number of valid snapshots */
+	int32 NumFrames = 0;
+};
+
+/**
+ *  World subsystem that rewinds shooter characters for server-side hit evaluation
+ *  Records every registered character's capsule and key bone locations into a preallocated ring buffer
+ *  once per server frame. Shots requested by remote clients are then evaluated against the hitboxes
+ *  as they were at the time the client fired, so players don't need to lead their targets to compensate for ping.
+ */
+UCLASS()
+class FPS251106_API UShooterLagCompensationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Hitbox history of every registered character */
+	TArray<FShooterHitboxHistory> Histories;
+
+	/** Actors of every registered character, kept in sync with Histories */
+	TArray<AActor*> TrackedActors;
+
+public:
+
+	/** Starts recording hitbox history for the given character */
+	void RegisterCharacter(AShooterCharacter* Character);
+
+	/** Stops recording hitbox history for the given character */
+	void UnregisterCharacter(AShooterCharacter* Character);
+
+	/** Returns the actors of all registered characters */
+	const TArray<AActor*>& GetTrackedActors() const { return TrackedActors; }
+
+	/** Returns true if shots should be evaluated against rewound hitboxes in this world */
+	bool IsLagCompensationActive() const;
+
+	/** Returns the max time in seconds the server rewinds characters to evaluate a shot */
+	static double GetMaxRewindTime();
+
+	/** Converts a client's estimate of the server time when it fired into the server time to rewind to */
+	double GetRewindTime(double ClientTimestamp, const APawn* Shooter) const;
+
+	/** Traces a segment against the registered characters as they were at the given server time. Returns true on a hit */
+	bool TraceRewound(const FVector& Start, const FVector& End, double RewindTime, const AActor* IgnoredActor, FHitResult& OutHit) const;
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only record hitboxes in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Takes a snapshot of the given character's hitboxes */
+	void RecordFrame(FShooterHitboxHistory& History, double Timestamp);
+
+	/** Finds the snapshots around the given time and the blend alpha between them. Returns false if there's no history */
+	bool FindFrames(const FShooterHitboxHistory& History, double Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const;
+};
@@ -0,0 +1,29 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *  Helpers to quantize shooter gameplay state for replication
+ */
+namespace ShooterNetQuantize
+{
+	/** Quantizes HP to a 16 bit fraction of max HP. Any HP left above zero stays above zero, so clients never see a living character as dead */
+	inline uint16 QuantizeHealth(float HP, float MaxHP)
+	{
+		if (HP <= 0.0f || MaxHP <= 0.0f)
+		{
+			return 0;
+		}
+
+		const float Fraction = FMath::Clamp(HP / MaxHP, 0.0f, 1.0f);
+		return static_cast<uint16>(FMath::Clamp(FMath::CeilToInt32(Fraction * MAX_uint16), 1, static_cast<int32>(MAX_uint16)));
+	}
+
+	/** Rebuilds HP from its quantized fraction of max HP */
+	inline float DequantizeHealth(uint16 QuantizedHP, float MaxHP)
+	{
+		return (static_cast<float>(QuantizedHP) / MAX_uint16) * MaxHP;
+	}
+}
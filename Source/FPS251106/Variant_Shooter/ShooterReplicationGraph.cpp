@@ -0,0 +1,265 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterReplicationGraph.h"
+#include "ShooterWeapon.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/Info.h"
+#include "UObject/UObjectIterator.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+static float GShooterRepGraphCellSize = 10000.0f;
+static FAutoConsoleVariableRef CVarShooterRepGraphCellSize(
+	TEXT("Shooter.RepGraph.CellSize"),
+	GShooterRepGraphCellSize,
+	TEXT("Size in world units of each cell of the replication spatial grid. Applies to new sessions"),
+	ECVF_Default
+);
+
+static float GShooterRepGraphSpatialBiasX = -150000.0f;
+static FAutoConsoleVariableRef CVarShooterRepGraphSpatialBiasX(
+	TEXT("Shooter.RepGraph.SpatialBiasX"),
+	GShooterRepGraphSpatialBiasX,
+	TEXT("X origin of the replication spatial grid. Should be below the smallest X of the playable area. Applies to new sessions"),
+	ECVF_Default
+);
+
+static float GShooterRepGraphSpatialBiasY = -150000.0f;
+static FAutoConsoleVariableRef CVarShooterRepGraphSpatialBiasY(
+	TEXT("Shooter.RepGraph.SpatialBiasY"),
+	GShooterRepGraphSpatialBiasY,
+	TEXT("Y origin of the replication spatial grid. Should be below the smallest Y of the playable area. Applies to new sessions"),
+	ECVF_Default
+);
+
+static int32 GShooterRepGraphDisableSpatialRebuilds = 1;
+static FAutoConsoleVariableRef CVarShooterRepGraphDisableSpatialRebuilds(
+	TEXT("Shooter.RepGraph.DisableSpatialRebuilds"),
+	GShooterRepGraphDisableSpatialRebuilds,
+	TEXT("If non-zero, actors outside the grid bounds are clamped to the edge cells instead of rebuilding the grid. Applies to new sessions"),
+	ECVF_Default
+);
+
+void UShooterReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// set up the replication info for every native replicated actor class
+	// blueprint classes pick up the settings of their closest native parent
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+
+		if (!Class->IsChildOf(AActor::StaticClass()) || !Class->IsNative() || Class->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists))
+		{
+			continue;
+		}
+
+		const AActor* ActorCDO = Class->GetDefaultObject<AActor>();
+
+		if (!ActorCDO || !ActorCDO->GetIsReplicated())
+		{
+			continue;
+		}
+
+		FClassReplicationInfo ClassInfo;
+		InitClassReplicationInfo(ClassInfo, Class);
+
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void UShooterReplicationGraph::InitGlobalGraphNodes()
+{
+	// create the spatial grid for moving and placed actors
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GShooterRepGraphCellSize;
+	GridNode->SpatialBias = FVector2D(GShooterRepGraphSpatialBiasX, GShooterRepGraphSpatialBiasY);
+
+	if (GShooterRepGraphDisableSpatialRebuilds != 0)
+	{
+		// clamp out of bounds actors to the edge cells instead of reallocating the whole grid
+		GridNode->AddToClassRebuildDenyList(AActor::StaticClass());
+	}
+
+	AddGlobalGraphNode(GridNode);
+
+	// create the list for game state, player states and other always relevant actors
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UShooterReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// the connection's own player controller and view target are always relevant to it
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* AlwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(AlwaysRelevantForConnectionNode, RepGraphConnection);
+}
+
+void UShooterReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	// actors carried by a pawn replicate along with it
+	if (AActor* Parent = GetDependentParent(ActorInfo.Actor))
+	{
+		GlobalActorReplicationInfoMap.AddDependentActor(Parent, ActorInfo.Actor);
+		DependentActorParents.Add(ActorInfo.Actor, Parent);
+		return;
+	}
+
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+		case EShooterRepNodeMapping::RelevantAllConnections:
+
+			AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Static:
+
+			GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Dynamic:
+
+			GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Dormancy:
+
+			GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+			break;
+
+		default:
+			break;
+	}
+}
+
+void UShooterReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	// dependent actors were never routed to a node
+	TWeakObjectPtr<AActor> Parent;
+
+	if (DependentActorParents.RemoveAndCopyValue(ActorInfo.Actor, Parent))
+	{
+		if (AActor* ParentActor = Parent.Get())
+		{
+			GlobalActorReplicationInfoMap.RemoveDependentActor(ParentActor, ActorInfo.Actor);
+		}
+
+		return;
+	}
+
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+		case EShooterRepNodeMapping::RelevantAllConnections:
+
+			AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Static:
+
+			GridNode->RemoveActor_Static(ActorInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Dynamic:
+
+			GridNode->RemoveActor_Dynamic(ActorInfo);
+			break;
+
+		case EShooterRepNodeMapping::Spatialize_Dormancy:
+
+			GridNode->RemoveActor_Dormancy(ActorInfo);
+			break;
+
+		default:
+			break;
+	}
+}
+
+EShooterRepNodeMapping UShooterReplicationGraph::GetMappingPolicy(UClass* Class)
+{
+	if (const EShooterRepNodeMapping* CachedPolicy = ClassRepNodePolicies.Find(Class))
+	{
+		return *CachedPolicy;
+	}
+
+	const EShooterRepNodeMapping Policy = ComputeMappingPolicy(Class);
+	ClassRepNodePolicies.Add(Class, Policy);
+
+	UE_LOG(LogFPS251106, Verbose, TEXT("ShooterReplicationGraph: routing %s as %s"), *GetNameSafe(Class), *UEnum::GetValueAsString(Policy));
+
+	return Policy;
+}
+
+EShooterRepNodeMapping UShooterReplicationGraph::ComputeMappingPolicy(const UClass* Class) const
+{
+	const AActor* ActorCDO = Class ? Class->GetDefaultObject<AActor>() : nullptr;
+
+	if (!ActorCDO || !ActorCDO->GetIsReplicated())
+	{
+		return EShooterRepNodeMapping::NotRouted;
+	}
+
+	// player controllers and other owner-only actors are gathered by their connection's own node
+	if (ActorCDO->bOnlyRelevantToOwner)
+	{
+		return EShooterRepNodeMapping::NotRouted;
+	}
+
+	// game state, player states and world settings go to everyone
+	if (ActorCDO->bAlwaysRelevant || Class->IsChildOf(AInfo::StaticClass()))
+	{
+		return EShooterRepNodeMapping::RelevantAllConnections;
+	}
+
+	// characters and NPCs move every frame
+	if (Class->IsChildOf(APawn::StaticClass()) || ActorCDO->IsReplicatingMovement())
+	{
+		return ActorCDO->NetDormancy > DORM_Awake ? EShooterRepNodeMapping::Spatialize_Dormancy : EShooterRepNodeMapping::Spatialize_Dynamic;
+	}
+
+	return ActorCDO->NetDormancy > DORM_Awake ? EShooterRepNodeMapping::Spatialize_Dormancy : EShooterRepNodeMapping::Spatialize_Static;
+}
+
+AActor* UShooterReplicationGraph::GetDependentParent(const AActor* Actor)
+{
+	if (!Actor || Actor->IsA<APawn>() || Actor->IsA<AController>() || Actor->IsA<APlayerState>())
+	{
+		return nullptr;
+	}
+
+	// attached to a pawn
+	AActor* AttachParent = Actor->GetAttachParentActor();
+
+	if (AttachParent && AttachParent->IsA<APawn>())
+	{
+		return AttachParent;
+	}
+
+	// weapons are owned by the pawn holding them, even before they're attached
+	AActor* Owner = Actor->GetOwner();
+
+	if (Owner && Owner->IsA<APawn>() && Actor->IsA<AShooterWeapon>())
+	{
+		return Owner;
+	}
+
+	return nullptr;
+}
+
+void UShooterReplicationGraph::InitClassReplicationInfo(FClassReplicationInfo& ClassInfo, const UClass* Class) const
+{
+	const AActor* ActorCDO = Class->GetDefaultObject<AActor>();
+
+	// always relevant actors skip the distance checks
+	if (!ActorCDO->bAlwaysRelevant && !ActorCDO->bOnlyRelevantToOwner)
+	{
+		ClassInfo.SetCullDistanceSquared(ActorCDO->GetNetCullDistanceSquared());
+	}
+
+	ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->GetNetUpdateFrequency());
+}
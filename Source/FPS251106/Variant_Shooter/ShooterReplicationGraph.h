@@ -0,0 +1,84 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "ShooterReplicationGraph.generated.h"
+
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+
+/**
+ *  How a replicated actor class is routed through the shooter replication graph
+ */
+UENUM()
+enum class EShooterRepNodeMapping : uint8
+{
+	/** Not routed to any node. Either relevant to its owner only, or a dependent of another actor */
+	NotRouted,
+
+	/** Relevant to every connection */
+	RelevantAllConnections,
+
+	/** Spatialized, never moves */
+	Spatialize_Static,
+
+	/** Spatialized, moves every frame */
+	Spatialize_Dynamic,
+
+	/** Spatialized, moves while awake and is static while dormant */
+	Spatialize_Dormancy
+};
+
+/**
+ *  Replication graph for large shooter PVP sessions
+ *  Characters and NPCs are spatialized on a 2D grid, so each connection only gathers the cells around its view.
+ *  Game and player state go through a single always relevant node, and player controllers only replicate to their owner.
+ *  Replicated actors owned by a pawn, like weapons, piggyback on their pawn as dependent actors instead of being routed on their own.
+ */
+UCLASS(Transient, config=Engine)
+class FPS251106_API UShooterReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Spatial grid for pawns and other moving actors */
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_GridSpatialization2D> GridNode;
+
+	/** Actors relevant to every connection */
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_ActorList> AlwaysRelevantNode;
+
+	/** Routing policy for each replicated class, resolved from the class defaults on first use */
+	TMap<UClass*, EShooterRepNodeMapping> ClassRepNodePolicies;
+
+	/** Pawn each dependent actor was added to. Kept so the actor can be removed after it's been detached */
+	TMap<TObjectKey<AActor>, TWeakObjectPtr<AActor>> DependentActorParents;
+
+public:
+
+	//~Begin UReplicationGraph interface
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	//~End UReplicationGraph interface
+
+protected:
+
+	/** Returns the routing policy for the given class, caching it */
+	EShooterRepNodeMapping GetMappingPolicy(UClass* Class);
+
+	/** Works out the routing policy for the given class from its defaults */
+	EShooterRepNodeMapping ComputeMappingPolicy(const UClass* Class) const;
+
+	/** Returns the pawn the given actor should piggyback on, if any */
+	static AActor* GetDependentParent(const AActor* Actor);
+
+	/** Sets up the replication frequency and cull distance for a class from its defaults */
+	void InitClassReplicationInfo(FClassReplicationInfo& ClassInfo, const UClass* Class) const;
+};
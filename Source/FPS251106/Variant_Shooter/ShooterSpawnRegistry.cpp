@@ -0,0 +1,292 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterSpawnRegistry.h"
+#include "ShooterDamage.h"
+#include "GameFramework/PlayerStart.h"
+#include "GameFramework/PlayerStartPIE.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Spawn Registry Build"), STAT_ShooterSpawnRegistryBuild, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Spawn Registry Pick"), STAT_ShooterSpawnRegistryPick, STATGROUP_Shooter);
+
+static float GShooterSpawnEyeHeight = 64.0f;
+static FAutoConsoleVariableRef CVarShooterSpawnEyeHeight(
+	TEXT("Shooter.Spawn.EyeHeight"),
+	GShooterSpawnEyeHeight,
+	TEXT("Height above each spawn point the visibility matrix is traced from. Applies the next time the registry is built"),
+	ECVF_Default
+);
+
+static float GShooterSpawnReuseCooldown = 3.0f;
+static FAutoConsoleVariableRef CVarShooterSpawnReuseCooldown(
+	TEXT("Shooter.Spawn.ReuseCooldown"),
+	GShooterSpawnReuseCooldown,
+	TEXT("Time in seconds a spawn point is avoided for after it's used"),
+	ECVF_Default
+);
+
+/** Score penalty for spawns a threat can see. Larger than any map, so it always outweighs distance */
+static constexpr float VisiblePenalty = 4.0e6f;
+
+/** Score penalty for spawns closer than the min distance to a threat */
+static constexpr float TooClosePenalty = 2.0e6f;
+
+/** Score penalty for spawns used recently */
+static constexpr float RecentlyUsedPenalty = 1.0e6f;
+
+APlayerStart* UShooterSpawnRegistrySubsystem::FindSafestSpawn(float MinDistance, TFunctionRef<bool(const APawn*)> IsThreat, const APawn* PawnToFit)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterSpawnRegistryPick);
+
+	const int32 NumSpawns = Spawns.Num();
+
+	if (NumSpawns == 0)
+	{
+		return nullptr;
+	}
+
+	GatherThreats(IsThreat);
+
+	// distance pass: nearest threat to every spawn, as flat loops over the axis arrays
+	const float* RESTRICT X = SpawnX.GetData();
+	const float* RESTRICT Y = SpawnY.GetData();
+	const float* RESTRICT Z = SpawnZ.GetData();
+	float* RESTRICT DistSq = MinDistSq.GetData();
+
+	for (int32 i = 0; i < NumSpawns; ++i)
+	{
+		DistSq[i] = TNumericLimits<float>::Max();
+	}
+
+	FMemory::Memzero(VisibleMask.GetData(), VisibleMask.Num() * sizeof(uint64));
+
+	for (const FVector& Threat : ThreatLocations)
+	{
+		const float TX = static_cast<float>(Threat.X);
+		const float TY = static_cast<float>(Threat.Y);
+		const float TZ = static_cast<float>(Threat.Z);
+
+		// the threat sees what the spawn nearest to it sees
+		int32 NearestSpawn = 0;
+		float NearestDistSq = TNumericLimits<float>::Max();
+
+		for (int32 i = 0; i < NumSpawns; ++i)
+		{
+			const float DX = X[i] - TX;
+			const float DY = Y[i] - TY;
+			const float DZ = Z[i] - TZ;
+			const float SpawnDistSq = DX * DX + DY * DY + DZ * DZ;
+
+			DistSq[i] = FMath::Min(DistSq[i], SpawnDistSq);
+
+			if (SpawnDistSq < NearestDistSq)
+			{
+				NearestDistSq = SpawnDistSq;
+				NearestSpawn = i;
+			}
+		}
+
+		const uint64* Row = &VisibilityRows[NearestSpawn * WordsPerRow];
+
+		for (int32 Word = 0; Word < WordsPerRow; ++Word)
+		{
+			VisibleMask[Word] |= Row[Word];
+		}
+	}
+
+	// scoring pass: farther from threats is better, and every penalty outweighs any distance
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float MinDistanceSq = FMath::Square(MinDistance);
+
+	int32 BestSpawn = INDEX_NONE;
+	float BestScore = -TNumericLimits<float>::Max();
+
+	for (int32 i = 0; i < NumSpawns; ++i)
+	{
+		SpawnScores[i] = -TNumericLimits<float>::Max();
+
+		if (!Spawns[i].IsValid())
+		{
+			continue;
+		}
+
+		// without any threats around, every spawn is equally far
+		float Score = ThreatLocations.Num() > 0 ? FMath::Sqrt(DistSq[i]) : 0.0f;
+
+		if ((VisibleMask[i >> 6] >> (i & 63)) & 1)
+		{
+			Score -= VisiblePenalty;
+		}
+
+		if (ThreatLocations.Num() > 0 && DistSq[i] < MinDistanceSq)
+		{
+			Score -= TooClosePenalty;
+		}
+
+		if (Now - LastUsedTimes[i] < GShooterSpawnReuseCooldown)
+		{
+			Score -= RecentlyUsedPenalty;
+		}
+
+		SpawnScores[i] = Score;
+
+		if (Score > BestScore)
+		{
+			BestScore = Score;
+			BestSpawn = i;
+		}
+	}
+
+	if (BestSpawn == INDEX_NONE || !PawnToFit)
+	{
+		return BestSpawn != INDEX_NONE ? Spawns[BestSpawn].Get() : nullptr;
+	}
+
+	// walk down the ranking until a spawn has room for the pawn. The best one is usually free, so this is one overlap test
+	for (int32 Candidate = BestSpawn; Candidate != INDEX_NONE;)
+	{
+		const APlayerStart* Spawn = Spawns[Candidate].Get();
+
+		if (!GetWorld()->EncroachingBlockingGeometry(PawnToFit, Spawn->GetActorLocation(), Spawn->GetActorRotation()))
+		{
+			return Spawns[Candidate].Get();
+		}
+
+		SpawnScores[Candidate] = -TNumericLimits<float>::Max();
+
+		// find the next best spawn that hasn't been tested
+		float NextScore = -TNumericLimits<float>::Max();
+		Candidate = INDEX_NONE;
+
+		for (int32 i = 0; i < NumSpawns; ++i)
+		{
+			if (SpawnScores[i] > NextScore)
+			{
+				NextScore = SpawnScores[i];
+				Candidate = i;
+			}
+		}
+	}
+
+	// every spawn is blocked. Hand out the safest one and let the spawn adjust the location
+	return Spawns[BestSpawn].Get();
+}
+
+void UShooterSpawnRegistrySubsystem::MarkSpawnUsed(const APlayerStart* Spawn)
+{
+	const int32 Index = Spawns.IndexOfByKey(Spawn);
+
+	if (Index != INDEX_NONE)
+	{
+		LastUsedTimes[Index] = GetWorld()->GetTimeSeconds();
+	}
+}
+
+void UShooterSpawnRegistrySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// spawns are only picked by the game mode, which only exists on the server
+	if (InWorld.GetNetMode() != NM_Client)
+	{
+		BuildRegistry();
+	}
+}
+
+bool UShooterSpawnRegistrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterSpawnRegistrySubsystem::BuildRegistry()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterSpawnRegistryBuild);
+
+	UWorld* World = GetWorld();
+
+	Spawns.Reset();
+	SpawnX.Reset();
+	SpawnY.Reset();
+	SpawnZ.Reset();
+
+	for (TActorIterator<APlayerStart> It(World); It; ++It)
+	{
+		// the play-from-here start is only for players
+		if (It->IsA<APlayerStartPIE>())
+		{
+			PlayInEditorStart = *It;
+			continue;
+		}
+
+		const FVector Location = It->GetActorLocation();
+
+		Spawns.Add(*It);
+		SpawnX.Add(static_cast<float>(Location.X));
+		SpawnY.Add(static_cast<float>(Location.Y));
+		SpawnZ.Add(static_cast<float>(Location.Z));
+	}
+
+	const int32 NumSpawns = Spawns.Num();
+
+	LastUsedTimes.Init(-UE_BIG_NUMBER, NumSpawns);
+
+	// size the pick scratch once, so picks never allocate
+	WordsPerRow = FMath::DivideAndRoundUp(NumSpawns, 64);
+
+	MinDistSq.SetNumUninitialized(NumSpawns);
+	SpawnScores.SetNumUninitialized(NumSpawns);
+	VisibleMask.SetNumZeroed(WordsPerRow);
+	VisibilityRows.SetNumZeroed(NumSpawns * WordsPerRow);
+	ThreatLocations.Reserve(64);
+
+	// visibility is symmetric, so trace each pair once
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterSpawnVisibility), false);
+
+	int32 NumVisiblePairs = 0;
+
+	for (int32 i = 0; i < NumSpawns; ++i)
+	{
+		// a spawn always sees itself
+		VisibilityRows[i * WordsPerRow + (i >> 6)] |= 1ull << (i & 63);
+
+		const FVector ViewI(SpawnX[i], SpawnY[i], SpawnZ[i] + GShooterSpawnEyeHeight);
+
+		for (int32 j = i + 1; j < NumSpawns; ++j)
+		{
+			const FVector ViewJ(SpawnX[j], SpawnY[j], SpawnZ[j] + GShooterSpawnEyeHeight);
+
+			if (!World->LineTraceTestByChannel(ViewI, ViewJ, ECC_Visibility, QueryParams))
+			{
+				VisibilityRows[i * WordsPerRow + (j >> 6)] |= 1ull << (j & 63);
+				VisibilityRows[j * WordsPerRow + (i >> 6)] |= 1ull << (i & 63);
+
+				++NumVisiblePairs;
+			}
+		}
+	}
+
+	UE_LOG(LogFPS251106, Log, TEXT("Spawn registry indexed %d spawn points, %d of %d pairs in sight of each other"), NumSpawns, NumVisiblePairs, NumSpawns * (NumSpawns - 1) / 2);
+}
+
+void UShooterSpawnRegistrySubsystem::GatherThreats(TFunctionRef<bool(const APawn*)> IsThreat)
+{
+	ThreatLocations.Reset();
+
+	for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+	{
+		const APawn* Pawn = *It;
+
+		// NPCs parked in the pool are hidden
+		if (Pawn->IsHidden() || UShooterDamageSubsystem::IsTargetDead(Pawn) || !IsThreat(Pawn))
+		{
+			continue;
+		}
+
+		ThreatLocations.Add(Pawn->GetActorLocation());
+	}
+}
@@ -0,0 +1,93 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterSpawnRegistry.generated.h"
+
+class APlayerStart;
+class APawn;
+
+/**
+ *  World subsystem that picks safe spawn points for enemies and respawning players
+ *  Every APlayerStart is indexed once when the world begins play, along with a spawn-to-spawn visibility
+ *  matrix traced at eye height. A pick scores every spawn against every living threat in a single pass
+ *  over structure-of-arrays data: distance to the nearest threat, whether the spawn can be seen from the spawn
+ *  nearest to any threat, and whether it was used recently. The caller decides which pawns are threats to the
+ *  pawn being spawned. Picks don't allocate once the registry is built.
+ */
+UCLASS()
+class FPS251106_API UShooterSpawnRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Indexed spawn points */
+	TArray<TWeakObjectPtr<APlayerStart>> Spawns;
+
+	/** Spawn point placed by play-from-here in the editor. Not indexed */
+	TWeakObjectPtr<APlayerStart> PlayInEditorStart;
+
+	/** Spawn locations, one array per axis */
+	TArray<float> SpawnX, SpawnY, SpawnZ;
+
+	/** Game time each spawn was last handed out at */
+	TArray<double> LastUsedTimes;
+
+	/** Visibility matrix. Bit j of row i is set if spawn j can be seen from spawn i */
+	TArray<uint64> VisibilityRows;
+
+	/** Number of 64 bit words per visibility row */
+	int32 WordsPerRow = 0;
+
+	/** Pick scratch: locations of the pawns to avoid */
+	TArray<FVector> ThreatLocations;
+
+	/** Pick scratch: squared distance from each spawn to the nearest threat */
+	TArray<float> MinDistSq;
+
+	/** Pick scratch: spawns seen from any threat */
+	TArray<uint64> VisibleMask;
+
+	/** Pick scratch: score of each spawn */
+	TArray<float> SpawnScores;
+
+public:
+
+	/**
+	 *  Returns the safest spawn point, or nullptr if the world has none
+	 *  @param MinDistance Spawns closer than this to a living threat are only used if there's nothing else
+	 *  @param IsThreat Returns true if a living pawn is a threat to the pawn being spawned, like enemies for players
+	 *  @param PawnToFit If set, spawns where this pawn would encroach on blocking geometry are skipped for the next best
+	 *  free one. Only the safest spawn is returned anyway if every spawn is blocked
+	 */
+	APlayerStart* FindSafestSpawn(float MinDistance, TFunctionRef<bool(const APawn*)> IsThreat, const APawn* PawnToFit = nullptr);
+
+	/** Records that a spawn point was just used, so the next picks prefer other ones */
+	void MarkSpawnUsed(const APlayerStart* Spawn);
+
+	/** Returns the spawn point placed by play-from-here in the editor, if any */
+	APlayerStart* GetPlayInEditorStart() const { return PlayInEditorStart.Get(); }
+
+	/** Returns the number of indexed spawn points */
+	int32 GetNumSpawns() const { return Spawns.Num(); }
+
+	/** Indexes the spawn points and traces the visibility matrix */
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Indexes every spawn point in the world and traces the visibility between each pair */
+	void BuildRegistry();
+
+	/** Returns true if spawn Viewer can see spawn Target */
+	bool IsVisible(int32 Viewer, int32 Target) const { return (VisibilityRows[Viewer * WordsPerRow + (Target >> 6)] >> (Target & 63)) & 1; }
+
+	/** Gathers the locations of the living, visible pawns the predicate picks as threats */
+	void GatherThreats(TFunctionRef<bool(const APawn*)> IsThreat);
+};
@@ -0,0 +1,105 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterStatsCollector.h"
+
+#if STATS
+
+#include "Async/TaskGraphInterfaces.h"
+
+FShooterStatsCollector::FShooterStatsCollector(int32 InNumSystems, TArray<FSystemStat> InSystemStats)
+	: SystemStats(MoveTemp(InSystemStats))
+{
+	Sums.SetNumZeroed(InNumSystems);
+	FrameSums.SetNumZeroed(InNumSystems);
+}
+
+void FShooterStatsCollector::Start()
+{
+	if (bStarted)
+	{
+		return;
+	}
+
+	bStarted = true;
+
+	// the delegate is broadcast on the stats thread, so it's only changed there. Tasks on it run in order
+	FFunctionGraphTask::CreateAndDispatchWhenReady([Collector = AsShared()]()
+	{
+		Collector->NewFrameHandle = FStatsThreadState::GetLocalState().NewFrameDelegate.AddThreadSafeSP(Collector, &FShooterStatsCollector::OnNewStatsFrame);
+
+	}, TStatId(), nullptr, ENamedThreads::GetStatsThread());
+}
+
+void FShooterStatsCollector::Stop()
+{
+	if (!bStarted)
+	{
+		return;
+	}
+
+	bStarted = false;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([Collector = AsShared()]()
+	{
+		FStatsThreadState::GetLocalState().NewFrameDelegate.Remove(Collector->NewFrameHandle);
+		Collector->NewFrameHandle.Reset();
+
+	}, TStatId(), nullptr, ENamedThreads::GetStatsThread());
+}
+
+void FShooterStatsCollector::Drain(TArrayView<double> OutSums, int32& OutNumFrames)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	for (int32 i = 0; i < Sums.Num() && i < OutSums.Num(); ++i)
+	{
+		OutSums[i] += Sums[i];
+		Sums[i] = 0.0;
+	}
+
+	OutNumFrames += NumFrames;
+	NumFrames = 0;
+}
+
+void FShooterStatsCollector::OnNewStatsFrame(int64 Frame)
+{
+	const FStatsThreadState& StatsState = FStatsThreadState::GetLocalState();
+
+	if (!StatsState.IsFrameValid(Frame))
+	{
+		return;
+	}
+
+	Messages.Reset();
+	StatsState.GetInclusiveAggregateStackStats(Frame, Messages);
+
+	for (double& FrameSum : FrameSums)
+	{
+		FrameSum = 0.0;
+	}
+
+	for (const FStatMessage& Message : Messages)
+	{
+		const FName ShortName = Message.NameAndInfo.GetShortName();
+
+		for (const FSystemStat& SystemStat : SystemStats)
+		{
+			if (ShortName == SystemStat.StatName)
+			{
+				FrameSums[SystemStat.System] += FPlatformTime::ToMilliseconds(Message.GetValue_Duration());
+			}
+		}
+	}
+
+	FScopeLock ScopeLock(&Lock);
+
+	for (int32 i = 0; i < Sums.Num(); ++i)
+	{
+		Sums[i] += FrameSums[i];
+	}
+
+	++NumFrames;
+}
+
+#endif
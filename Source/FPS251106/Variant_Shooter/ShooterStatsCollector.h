@@ -0,0 +1,68 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if STATS
+
+#include "Stats/StatsData.h"
+
+/**
+ *  Sums the inclusive times of named stats over every stats frame, grouped into systems
+ *  Stats frames are only safe to read on the stats thread, so the sums are kept here and drained by the game thread.
+ *  Frames only arrive while stats are being collected, e.g. while a stat group is displayed.
+ */
+class FPS251106_API FShooterStatsCollector : public TSharedFromThis<FShooterStatsCollector, ESPMode::ThreadSafe>
+{
+public:
+
+	/** A stat summed into a system. A system can sum several stats, as long as they don't nest */
+	struct FSystemStat
+	{
+		int32 System = 0;
+		FName StatName;
+	};
+
+	FShooterStatsCollector(int32 InNumSystems, TArray<FSystemStat> InSystemStats);
+
+	/** Starts receiving stats frames. Called on the game thread, the binding is made on the stats thread */
+	void Start();
+
+	/** Stops receiving stats frames. The stats thread holds on to the collector until it has unbound it */
+	void Stop();
+
+	/** Adds the per-system times summed since the last drain to the given ones, in ms, and resets them. Called on the game thread */
+	void Drain(TArrayView<double> OutSums, int32& OutNumFrames);
+
+protected:
+
+	/** Adds the times of a finished stats frame. Called on the stats thread */
+	void OnNewStatsFrame(int64 Frame);
+
+	/** Stats summed into each system */
+	TArray<FSystemStat> SystemStats;
+
+	/** Guards the sums */
+	FCriticalSection Lock;
+
+	/** Per-system time summed since the last drain, in ms */
+	TArray<double> Sums;
+
+	/** Number of stats frames summed since the last drain */
+	int32 NumFrames = 0;
+
+	/** Stat messages, reused between frames. Only touched on the stats thread */
+	TArray<FStatMessage> Messages;
+
+	/** Frame scratch: per-system times of the frame being summed. Only touched on the stats thread */
+	TArray<double> FrameSums;
+
+	/** Handle of the new stats frame binding. Only touched on the stats thread */
+	FDelegateHandle NewFrameHandle;
+
+	/** If true, we've asked to receive stats frames. Only touched on the game thread */
+	bool bStarted = false;
+};
+
+#endif
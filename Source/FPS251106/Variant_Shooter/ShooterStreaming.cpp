@@ -0,0 +1,41 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterStreaming.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Synchronous Loads"), STAT_ShooterSyncLoads, STATGROUP_Shooter);
+
+/** Number of blocking loads triggered by the shooter code this session */
+static int32 GShooterNumSyncLoads = 0;
+
+static FAutoConsoleCommand ShooterStreamingSyncLoadsCommand(
+	TEXT("Shooter.Streaming.SyncLoads"),
+	TEXT("Logs the number of synchronous asset loads triggered by the shooter code this session"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		UE_LOG(LogFPS251106, Log, TEXT("Shooter synchronous loads this session: %d"), GShooterNumSyncLoads);
+	})
+);
+
+FStreamableManager& ShooterStreaming::GetStreamableManager()
+{
+	return UAssetManager::GetStreamableManager();
+}
+
+void ShooterStreaming::RecordSyncLoad(const FSoftObjectPath& AssetPath)
+{
+	++GShooterNumSyncLoads;
+	INC_DWORD_STAT(STAT_ShooterSyncLoads);
+
+	// blocking loads hitch the game thread, so make them easy to find
+	UE_LOG(LogFPS251106, Warning, TEXT("Synchronous load of %s (%d this session)"), *AssetPath.ToString(), GShooterNumSyncLoads);
+}
+
+int32 ShooterStreaming::GetNumSyncLoads()
+{
+	return GShooterNumSyncLoads;
+}
@@ -0,0 +1,62 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/SoftObjectPtr.h"
+#include "Templates/SubclassOf.h"
+
+struct FStreamableManager;
+
+/**
+ *  Helpers for loading shooter assets
+ *  Assets should be requested asynchronously through the shared streamable manager.
+ *  Blocking loads go through LoadSynchronous so they're counted and logged, and can be tracked down.
+ */
+namespace ShooterStreaming
+{
+	/** Returns the streamable manager shooter assets are requested through */
+	FPS251106_API FStreamableManager& GetStreamableManager();
+
+	/** Records a blocking load of the given asset */
+	FPS251106_API void RecordSyncLoad(const FSoftObjectPath& AssetPath);
+
+	/** Returns the number of blocking loads triggered by the shooter code this session */
+	FPS251106_API int32 GetNumSyncLoads();
+
+	/** Returns the asset, loading and counting it synchronously if it's not resident yet */
+	template<typename T>
+	T* LoadSynchronous(const TSoftObjectPtr<T>& Asset)
+	{
+		if (T* Loaded = Asset.Get())
+		{
+			return Loaded;
+		}
+
+		if (Asset.IsNull())
+		{
+			return nullptr;
+		}
+
+		RecordSyncLoad(Asset.ToSoftObjectPath());
+		return Asset.LoadSynchronous();
+	}
+
+	/** Returns the class, loading and counting it synchronously if it's not resident yet */
+	template<typename T>
+	TSubclassOf<T> LoadSynchronous(const TSoftClassPtr<T>& Class)
+	{
+		if (UClass* Loaded = Class.Get())
+		{
+			return Loaded;
+		}
+
+		if (Class.IsNull())
+		{
+			return nullptr;
+		}
+
+		RecordSyncLoad(Class.ToSoftObjectPath());
+		return Class.LoadSynchronous();
+	}
+}
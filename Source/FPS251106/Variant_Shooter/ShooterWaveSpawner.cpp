@@ -0,0 +1,391 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Variant_Shooter/ShooterWaveSpawner.h"
+#include "Variant_Shooter/AI/ShooterNPC.h"
+#include "Variant_Shooter/AI/ShooterNPCPool.h"
+#include "Variant_Shooter/ShooterGameState.h"
+#include "MultiplayerGameMode.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "HAL/PlatformTime.h"
+#include "Algo/Reverse.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Wave Spawner Tick"), STAT_ShooterWaveSpawnerTick, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wave Spawns"), STAT_ShooterWaveSpawns, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wave Prewarms"), STAT_ShooterWavePrewarms, STATGROUP_Shooter);
+
+int32 FShooterWaveDefinition::GetEnemyCount() const
+{
+	int32 Count = 0;
+
+	for (const FShooterWaveGroup& Group : Groups)
+	{
+		Count += FMath::Max(Group.Count, 0);
+	}
+
+	return Count;
+}
+
+UShooterWaveSpawnerComponent::UShooterWaveSpawnerComponent()
+{
+	// only tick while there's queued work
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+void UShooterWaveSpawnerComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// waves are only spawned by the server
+	if (bStartOnBeginPlay && Waves.Num() > 0 && GetOwner()->HasAuthority())
+	{
+		StartWaves();
+	}
+}
+
+void UShooterWaveSpawnerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// clear the wave delay timer
+	GetWorld()->GetTimerManager().ClearTimer(WaveDelayTimer);
+}
+
+void UShooterWaveSpawnerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterWaveSpawnerTick);
+
+	const int32 ProcessedBefore = NumProcessed;
+	const double StartTime = FPlatformTime::Seconds();
+
+	// always process one request, so the queue drains even if a single spawn costs more than the budget
+	do
+	{
+		// the current wave takes priority over prewarming for the later ones
+		if (PendingSpawns.Num() > 0)
+		{
+			ProcessSpawn();
+
+		} else if (PendingPrewarms.Num() > 0) {
+
+			ProcessPrewarm();
+
+		} else {
+
+			break;
+
+		}
+
+	} while ((FPlatformTime::Seconds() - StartTime) * 1000.0 < SpawnBudgetMs);
+
+	if (CurrentWave != INDEX_NONE)
+	{
+		// report the frame's progress once
+		if (NumProcessed != ProcessedBefore)
+		{
+			OnWaveProgress.Broadcast(CurrentWave, NumProcessed, NumInWave);
+
+			WaveState.NumSpawned = NumProcessed;
+			PublishWaveState();
+		}
+
+		if (PendingSpawns.Num() == 0)
+		{
+			FinishWave();
+		}
+	}
+
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::StartWaves()
+{
+	StopWaves();
+
+	NextWave = 0;
+
+	// grow the pool for every wave, during the first delay
+	if (bPrewarm)
+	{
+		for (const FShooterWaveDefinition& Wave : Waves)
+		{
+			QueuePrewarm(Wave);
+		}
+	}
+
+	BeginNextWave();
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::StopWaves()
+{
+	GetWorld()->GetTimerManager().ClearTimer(WaveDelayTimer);
+
+	PendingSpawns.Reset();
+	PendingPrewarms.Reset();
+
+	CurrentWave = INDEX_NONE;
+	NextWave = Waves.Num();
+	NumProcessed = NumInWave = 0;
+
+	WaveState.IncomingWave = INDEX_NONE;
+	WaveState.CurrentWave = INDEX_NONE;
+	PublishWaveState();
+
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::QueueWave(const FShooterWaveDefinition& Wave)
+{
+	// if every other wave is done, the new one starts right away
+	const bool bWasIdle = !IsRunning();
+
+	Waves.Add(Wave);
+
+	if (bPrewarm)
+	{
+		QueuePrewarm(Wave);
+	}
+
+	if (bWasIdle)
+	{
+		NextWave = Waves.Num() - 1;
+		BeginNextWave();
+	}
+
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::QueueNextWave(const FShooterWaveDefinition& Wave)
+{
+	// if every other wave is done, this is the same as queueing it last
+	if (!IsRunning())
+	{
+		QueueWave(Wave);
+		return;
+	}
+
+	Waves.Insert(Wave, NextWave);
+
+	if (bPrewarm)
+	{
+		QueuePrewarm(Wave);
+	}
+
+	// the wave waiting for its delay is announced again once this one is spawned
+	if (GetWorld()->GetTimerManager().IsTimerActive(WaveDelayTimer))
+	{
+		GetWorld()->GetTimerManager().ClearTimer(WaveDelayTimer);
+		BeginNextWave();
+	}
+
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::BeginNextWave()
+{
+	// a wave is already waiting for its delay
+	if (GetWorld()->GetTimerManager().IsTimerActive(WaveDelayTimer))
+	{
+		return;
+	}
+
+	if (NextWave >= Waves.Num())
+	{
+		OnAllWavesSpawned.Broadcast();
+
+		WaveState.IncomingWave = INDEX_NONE;
+		WaveState.bAllWavesSpawned = true;
+		PublishWaveState();
+
+		return;
+	}
+
+	const FShooterWaveDefinition& Wave = Waves[NextWave];
+
+	// let the UI show the incoming wave
+	OnWaveIncoming.Broadcast(NextWave, Wave.GetEnemyCount(), Wave.Delay);
+
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+
+	WaveState.IncomingWave = NextWave;
+	WaveState.IncomingEnemyCount = Wave.GetEnemyCount();
+	WaveState.IncomingStartTime = (GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) + Wave.Delay;
+	WaveState.bAllWavesSpawned = false;
+	PublishWaveState();
+
+	if (Wave.Delay > 0.0f)
+	{
+		GetWorld()->GetTimerManager().SetTimer(WaveDelayTimer, this, &UShooterWaveSpawnerComponent::StartWave, Wave.Delay, false);
+
+	} else {
+
+		StartWave();
+
+	}
+}
+
+void UShooterWaveSpawnerComponent::StartWave()
+{
+	if (!Waves.IsValidIndex(NextWave))
+	{
+		return;
+	}
+
+	CurrentWave = NextWave++;
+
+	const FShooterWaveDefinition& Wave = Waves[CurrentWave];
+
+	NumProcessed = 0;
+	NumInWave = Wave.GetEnemyCount();
+
+	// interleave the groups, so a mixed wave arrives mixed
+	PendingSpawns.Reset();
+	PendingSpawns.Reserve(NumInWave);
+
+	for (int32 Round = 0; PendingSpawns.Num() < NumInWave; ++Round)
+	{
+		for (const FShooterWaveGroup& Group : Wave.Groups)
+		{
+			if (Round < Group.Count)
+			{
+				PendingSpawns.Add(ResolveClass(Group));
+			}
+		}
+	}
+
+	// spawns are popped from the back
+	Algo::Reverse(PendingSpawns);
+
+	UE_LOG(LogFPS251106, Log, TEXT("Starting wave %d with %d enemies"), CurrentWave, NumInWave);
+
+	OnWaveStarted.Broadcast(CurrentWave);
+
+	WaveState.IncomingWave = INDEX_NONE;
+	WaveState.CurrentWave = CurrentWave;
+	WaveState.NumSpawned = 0;
+	WaveState.NumTotal = NumInWave;
+	PublishWaveState();
+
+	// an empty wave is done right away
+	if (PendingSpawns.Num() == 0)
+	{
+		FinishWave();
+	}
+
+	UpdateTickEnabled();
+}
+
+void UShooterWaveSpawnerComponent::FinishWave()
+{
+	const int32 SpawnedWave = CurrentWave;
+	CurrentWave = INDEX_NONE;
+
+	OnWaveSpawned.Broadcast(SpawnedWave);
+
+	WaveState.CurrentWave = INDEX_NONE;
+	WaveState.LastSpawnedWave = SpawnedWave;
+	++WaveState.NumWavesSpawned;
+	PublishWaveState();
+
+	// move on to the next one
+	BeginNextWave();
+}
+
+void UShooterWaveSpawnerComponent::QueuePrewarm(const FShooterWaveDefinition& Wave)
+{
+	// the pool is grown to the size of each group. Sizes already reached are skipped
+	for (const FShooterWaveGroup& Group : Wave.Groups)
+	{
+		if (Group.Count > 0)
+		{
+			PendingPrewarms.Emplace(ResolveClass(Group), Group.Count);
+		}
+	}
+}
+
+TSubclassOf<AShooterNPC> UShooterWaveSpawnerComponent::ResolveClass(const FShooterWaveGroup& Group) const
+{
+	if (Group.NPCClass)
+	{
+		return Group.NPCClass;
+	}
+
+	const AMultiplayerGameMode* GM = Cast<AMultiplayerGameMode>(GetWorld()->GetAuthGameMode());
+
+	return GM ? GM->GetNPCClass() : nullptr;
+}
+
+void UShooterWaveSpawnerComponent::ProcessSpawn()
+{
+	const TSubclassOf<AShooterNPC> NPCClass = PendingSpawns.Pop(EAllowShrinking::No);
+	++NumProcessed;
+
+	AMultiplayerGameMode* GM = Cast<AMultiplayerGameMode>(GetWorld()->GetAuthGameMode());
+
+	if (GM && GM->SpawnEnemyAtRandomLocation(NPCClass))
+	{
+		INC_DWORD_STAT(STAT_ShooterWaveSpawns);
+
+	} else {
+
+		UE_LOG(LogFPS251106, Warning, TEXT("Wave %d could not spawn an enemy of class %s"), CurrentWave, *GetNameSafe(NPCClass));
+
+	}
+}
+
+void UShooterWaveSpawnerComponent::ProcessPrewarm()
+{
+	UShooterNPCPoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterNPCPoolSubsystem>();
+	const TPair<TSubclassOf<AShooterNPC>, int32>& Prewarm = PendingPrewarms.Last();
+
+	int32 Hits = 0, Misses = 0, HighWater = 0, Active = 0, Free = 0;
+
+	if (Pool)
+	{
+		Pool->GetPoolStats(Prewarm.Key, Hits, Misses, HighWater, Active, Free);
+	}
+
+	// the pool is big enough for this group
+	if (!Pool || !Prewarm.Key || Active + Free >= Prewarm.Value)
+	{
+		PendingPrewarms.Pop(EAllowShrinking::No);
+		return;
+	}
+
+	// grow the pool by a single NPC, so prewarming is sliced like spawning
+	const int32 PoolSize = Active + Free;
+	Pool->Prewarm(Prewarm.Key, PoolSize + 1);
+
+	Pool->GetPoolStats(Prewarm.Key, Hits, Misses, HighWater, Active, Free);
+
+	if (Active + Free > PoolSize)
+	{
+		INC_DWORD_STAT(STAT_ShooterWavePrewarms);
+
+	} else {
+
+		// the spawn failed, so don't keep retrying every frame
+		UE_LOG(LogFPS251106, Warning, TEXT("Could not prewarm enemy class %s"), *GetNameSafe(Prewarm.Key));
+		PendingPrewarms.Pop(EAllowShrinking::No);
+
+	}
+}
+
+void UShooterWaveSpawnerComponent::UpdateTickEnabled()
+{
+	SetComponentTickEnabled(PendingSpawns.Num() > 0 || PendingPrewarms.Num() > 0);
+}
+
+void UShooterWaveSpawnerComponent::PublishWaveState()
+{
+	if (AShooterGameState* GameState = GetWorld()->GetGameState<AShooterGameState>())
+	{
+		GameState->SetWaveState(WaveState);
+	}
+}
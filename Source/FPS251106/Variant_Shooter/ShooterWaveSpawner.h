@@ -0,0 +1,250 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ShooterWaveSpawner.generated.h"
+
+class AShooterNPC;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FShooterWaveIncomingDelegate, int32, WaveIndex, int32, EnemyCount, float, Delay);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FShooterWaveStartedDelegate, int32, WaveIndex);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FShooterWaveProgressDelegate, int32, WaveIndex, int32, NumSpawned, int32, NumTotal);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FShooterWaveSpawnedDelegate, int32, WaveIndex);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FShooterAllWavesSpawnedDelegate);
+
+/**
+ *  A number of enemies of a single class within a wave
+ */
+USTRUCT(BlueprintType)
+struct FShooterWaveGroup
+{
+	GENERATED_BODY()
+
+	/** Enemy class to spawn. Uses the game mode NPC class if not set */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Wave")
+	TSubclassOf<AShooterNPC> NPCClass;
+
+	/** Number of enemies to spawn */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Wave", meta = (ClampMin = 0))
+	int32 Count = 5;
+};
+
+/**
+ *  A single wave of enemies
+ */
+USTRUCT(BlueprintType)
+struct FShooterWaveDefinition
+{
+	GENERATED_BODY()
+
+	/** Enemies in this wave. Groups are interleaved while spawning, so a mixed wave arrives mixed */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Wave")
+	TArray<FShooterWaveGroup> Groups;
+
+	/** Time between the previous wave finishing spawning and this one starting */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Wave", meta = (ClampMin = 0, Units = "s"))
+	float Delay = 5.0f;
+
+	/** Returns the number of enemies in this wave */
+	int32 GetEnemyCount() const;
+};
+
+/**
+ *  Replicated progress of the enemy waves
+ */
+USTRUCT(BlueprintType)
+struct FShooterWaveState
+{
+	GENERATED_BODY()
+
+	/** Index of the wave announced as incoming, or INDEX_NONE */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 IncomingWave = INDEX_NONE;
+
+	/** Number of enemies in the incoming wave */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 IncomingEnemyCount = 0;
+
+	/** Server world time the incoming wave starts at */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	double IncomingStartTime = 0.0;
+
+	/** Index of the wave being spawned, or INDEX_NONE between waves */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 CurrentWave = INDEX_NONE;
+
+	/** Number of enemies of the current wave processed so far */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 NumSpawned = 0;
+
+	/** Number of enemies in the current wave */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 NumTotal = 0;
+
+	/** Index of the last wave that finished spawning, or INDEX_NONE */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	int32 LastSpawnedWave = INDEX_NONE;
+
+	/** Number of waves that finished spawning. Tells repeated spawns of the same index apart */
+	UPROPERTY()
+	int32 NumWavesSpawned = 0;
+
+	/** If true, every queued wave has been spawned */
+	UPROPERTY(BlueprintReadOnly, Category="Waves")
+	bool bAllWavesSpawned = false;
+};
+
+/**
+ *  Spawns enemy waves for the multiplayer game mode without stalling the frame
+ *  Spawn requests are queued and processed under a per-frame time budget, at least one per frame.
+ *  The NPC classes the waves need are prewarmed into the NPC pool the same way, during the first delay,
+ *  so most wave spawns recycle a parked NPC instead of spawning a new actor, controller and weapon.
+ *  Progress events can drive UI for incoming waves. Only runs on the server, like the game mode, so the
+ *  progress is also published to AShooterGameState, which replicates it and raises the same events on clients.
+ */
+UCLASS(ClassGroup=(Shooter), meta=(BlueprintSpawnableComponent))
+class FPS251106_API UShooterWaveSpawnerComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Waves to spawn, in order */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Waves")
+	TArray<FShooterWaveDefinition> Waves;
+
+	/** If true, the waves start when play begins */
+	UPROPERTY(EditAnywhere, Category="Waves")
+	bool bStartOnBeginPlay = true;
+
+	/** If true, the NPC classes the waves need are prewarmed into the NPC pool before the first wave */
+	UPROPERTY(EditAnywhere, Category="Waves")
+	bool bPrewarm = true;
+
+	/** Time per frame spent on spawning and prewarming. At least one spawn is processed every frame */
+	UPROPERTY(EditAnywhere, Category="Waves", meta = (ClampMin = 0, Units = "ms"))
+	float SpawnBudgetMs = 2.0f;
+
+	/** Enemy classes left to spawn for the current wave, in spawn order */
+	TArray<TSubclassOf<AShooterNPC>> PendingSpawns;
+
+	/** NPC classes left to prewarm, each with the pool size to grow to. Processed from the back */
+	TArray<TPair<TSubclassOf<AShooterNPC>, int32>> PendingPrewarms;
+
+	/** Index of the wave being spawned, or INDEX_NONE between waves */
+	int32 CurrentWave = INDEX_NONE;
+
+	/** Index of the next wave to start */
+	int32 NextWave = 0;
+
+	/** Number of enemies of the current wave processed so far, including the ones that failed to spawn */
+	int32 NumProcessed = 0;
+
+	/** Number of enemies in the current wave */
+	int32 NumInWave = 0;
+
+	/** Delay before the next wave */
+	FTimerHandle WaveDelayTimer;
+
+	/** Wave progress published to the game state for clients */
+	FShooterWaveState WaveState;
+
+public:
+
+	/** Called when a wave is about to start after its delay */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveIncomingDelegate OnWaveIncoming;
+
+	/** Called when a wave starts spawning */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveStartedDelegate OnWaveStarted;
+
+	/** Called at most once per frame while a wave is spawning */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveProgressDelegate OnWaveProgress;
+
+	/** Called when every enemy of a wave has been spawned */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterWaveSpawnedDelegate OnWaveSpawned;
+
+	/** Called when the last wave has been spawned */
+	UPROPERTY(BlueprintAssignable, Category="Waves")
+	FShooterAllWavesSpawnedDelegate OnAllWavesSpawned;
+
+public:
+
+	/** Constructor */
+	UShooterWaveSpawnerComponent();
+
+protected:
+
+	/** Gameplay initialization */
+	virtual void BeginPlay() override;
+
+	/** Gameplay cleanup */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+
+	/** Processes queued spawns and prewarms under the frame budget */
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Starts spawning the waves from the first one, prewarming their NPC classes first */
+	UFUNCTION(BlueprintCallable, Category="Waves")
+	void StartWaves();
+
+	/** Stops spawning and drops any queued work. Enemies already spawned are left alone */
+	UFUNCTION(BlueprintCallable, Category="Waves")
+	void StopWaves();
+
+	/** Adds a wave after the defined ones. It's started right away if every other wave has been spawned */
+	UFUNCTION(BlueprintCallable, Category="Waves")
+	void QueueWave(const FShooterWaveDefinition& Wave);
+
+	/** Adds a wave that starts before the remaining ones. A wave waiting for its delay is pushed back behind it */
+	UFUNCTION(BlueprintCallable, Category="Waves")
+	void QueueNextWave(const FShooterWaveDefinition& Wave);
+
+	/** Returns true if there are waves left to spawn, or one is spawning */
+	UFUNCTION(BlueprintPure, Category="Waves")
+	bool IsRunning() const { return CurrentWave != INDEX_NONE || NextWave < Waves.Num(); }
+
+	/** Returns the index of the wave being spawned, or INDEX_NONE between waves */
+	UFUNCTION(BlueprintPure, Category="Waves")
+	int32 GetCurrentWave() const { return CurrentWave; }
+
+	/** Returns the number of defined waves */
+	UFUNCTION(BlueprintPure, Category="Waves")
+	int32 GetNumWaves() const { return Waves.Num(); }
+
+protected:
+
+	/** Announces the next wave and starts it after its delay, or reports that every wave has been spawned */
+	void BeginNextWave();
+
+	/** Queues the spawns of the next wave */
+	void StartWave();
+
+	/** Reports the current wave as spawned and moves on to the next one */
+	void FinishWave();
+
+	/** Queues the pool growth needed by a wave */
+	void QueuePrewarm(const FShooterWaveDefinition& Wave);
+
+	/** Returns the NPC class a wave group spawns */
+	TSubclassOf<AShooterNPC> ResolveClass(const FShooterWaveGroup& Group) const;
+
+	/** Spawns the next queued enemy */
+	void ProcessSpawn();
+
+	/** Grows the NPC pool by a single NPC of the last queued class, or drops the class once its size is reached */
+	void ProcessPrewarm();
+
+	/** Turns the tick on while there's queued work */
+	void UpdateTickEnabled();
+
+	/** Sends the wave progress to the game state, if it's a shooter game state */
+	void PublishWaveState();
+};
@@ -0,0 +1,29 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterBatchedTrace.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 GShooterParallelTraces = 1;
+static FAutoConsoleVariableRef CVarShooterParallelTraces(
+	TEXT("Shooter.Traces.Parallel"),
+	GShooterParallelTraces,
+	TEXT("If non-zero, batched projectile sweeps, hitscan traces and explosion occlusion traces are spread across worker threads"),
+	ECVF_Default
+);
+
+static int32 GShooterParallelTraceMinBatch = 8;
+static FAutoConsoleVariableRef CVarShooterParallelTraceMinBatch(
+	TEXT("Shooter.Traces.ParallelMinBatch"),
+	GShooterParallelTraceMinBatch,
+	TEXT("Minimum number of queries in a batch before it's spread across worker threads"),
+	ECVF_Default
+);
+
+void ShooterBatchedTrace::ForEachQuery(int32 NumQueries, TFunctionRef<void(int32)> Query)
+{
+	const bool bParallel = GShooterParallelTraces != 0 && NumQueries >= GShooterParallelTraceMinBatch;
+
+	ParallelFor(NumQueries, Query, bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
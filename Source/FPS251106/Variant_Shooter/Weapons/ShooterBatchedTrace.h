@@ -0,0 +1,17 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Function.h"
+
+/**
+ *  Runs a frame's batch of scene queries for the shooter trace subsystems
+ *  Scene queries only read the physics scene, so once a batch is large enough it's spread across worker threads.
+ *  Set Shooter.Traces.Parallel to 0 to keep every batch on the game thread.
+ */
+namespace ShooterBatchedTrace
+{
+	/** Calls Query once for each index in [0, NumQueries). Each call may only read the scene and write its own slot of the results */
+	FPS251106_API void ForEachQuery(int32 NumQueries, TFunctionRef<void(int32)> Query);
+}
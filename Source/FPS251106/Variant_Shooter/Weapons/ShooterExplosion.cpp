@@ -0,0 +1,196 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterExplosion.h"
+#include "Engine/World.h"
+#include "Engine/OverlapResult.h"
+#include "GameFramework/Pawn.h"
+#include "ShooterBatchedTrace.h"
+#include "Variant_Shooter/ShooterDamage.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Explosion Resolve"), STAT_ShooterExplosionResolve, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Explosion Occlusion"), STAT_ShooterExplosionOcclusion, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion Victims"), STAT_ShooterExplosionVictims, STATGROUP_Shooter);
+
+void UShooterExplosionSubsystem::QueueExplosion(const FVector& Center, const FShooterExplosionParams& ExplosionParams, const FShooterHitParams& HitParams)
+{
+	// look for pawns and dynamic objects in range
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterExplosionOverlap), false, HitParams.Causer);
+
+	if (!HitParams.bDamageOwner)
+	{
+		QueryParams.AddIgnoredActor(HitParams.Instigator);
+	}
+
+	FShooterExplosionRequest& Request = PendingExplosions.AddDefaulted_GetRef();
+	Request.Center = Center;
+	Request.ExplosionParams = ExplosionParams;
+	Request.HitParams = HitParams;
+
+	// the results come back on a later frame, so the game thread never waits on the overlap
+	Request.OverlapHandle = GetWorld()->AsyncOverlapByObjectType(Center, FQuat::Identity, ObjectParams, FCollisionShape::MakeSphere(ExplosionParams.Radius), QueryParams);
+}
+
+void UShooterExplosionSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (PendingExplosions.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterExplosionResolve);
+
+	UWorld* World = GetWorld();
+
+	// collect the explosions whose overlaps are ready
+	for (int32 i = PendingExplosions.Num() - 1; i >= 0; --i)
+	{
+		const FTraceHandle& Handle = PendingExplosions[i].OverlapHandle;
+
+		if (World->QueryOverlapData(Handle, OverlapData))
+		{
+			const int32 ExplosionIndex = ResolvingExplosions.Add(PendingExplosions[i]);
+			GatherVictims(ExplosionIndex, OverlapData.OutOverlaps);
+
+			PendingExplosions.RemoveAtSwap(i, EAllowShrinking::No);
+
+		} else if (!World->IsTraceHandleValid(Handle, true)) {
+
+			// the query was dropped, so don't wait on it forever
+			PendingExplosions.RemoveAtSwap(i, EAllowShrinking::No);
+
+		}
+	}
+
+	if (ResolvingExplosions.Num() > 0)
+	{
+		INC_DWORD_STAT_BY(STAT_ShooterExplosionVictims, Victims.Num());
+
+		// check which victims are shielded from their explosion
+		TraceOcclusion();
+
+		// damage everyone in a single pass
+		ApplyDamage();
+	}
+
+	// reset the frame scratch, keeping the allocations
+	ResolvingExplosions.Reset();
+	Victims.Reset();
+	VictimOccluded.Reset();
+}
+
+TStatId UShooterExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterExplosionSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterExplosionSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterExplosionSubsystem::GatherVictims(int32 ExplosionIndex, const TArray<FOverlapResult>& Overlaps)
+{
+	const FShooterExplosionRequest& Explosion = ResolvingExplosions[ExplosionIndex];
+	const FShooterExplosionParams& ExplosionParams = Explosion.ExplosionParams;
+
+	// overlaps may return the same actor once per overlapped component, so only keep the first one
+	SeenActors.Reset();
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		AActor* Actor = Overlap.GetActor();
+
+		if (!Actor)
+		{
+			continue;
+		}
+
+		bool bAlreadySeen = false;
+		SeenActors.Add(Actor, &bAlreadySeen);
+
+		if (bAlreadySeen)
+		{
+			continue;
+		}
+
+		// scale damage down between the inner radius and the edge of the explosion, if the explosion falls off
+		const FVector Location = Actor->GetActorLocation();
+		const float Distance = FVector::Dist(Location, Explosion.Center);
+
+		float Scale = 1.0f;
+
+		if (ExplosionParams.bFalloff && Distance > ExplosionParams.InnerRadius)
+		{
+			const float FalloffRange = FMath::Max(ExplosionParams.Radius - ExplosionParams.InnerRadius, UE_KINDA_SMALL_NUMBER);
+			const float FalloffAlpha = FMath::Clamp((Distance - ExplosionParams.InnerRadius) / FalloffRange, 0.0f, 1.0f);
+
+			Scale = FMath::Lerp(1.0f, ExplosionParams.MinDamageScale, FMath::Pow(FalloffAlpha, ExplosionParams.FalloffExponent));
+		}
+
+		FShooterExplosionVictim& Victim = Victims.AddDefaulted_GetRef();
+		Victim.ExplosionIndex = ExplosionIndex;
+		Victim.Actor = Actor;
+		Victim.Component = Overlap.GetComponent();
+		Victim.Location = Location;
+		Victim.Scale = Scale;
+	}
+}
+
+void UShooterExplosionSubsystem::TraceOcclusion()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterExplosionOcclusion);
+
+	VictimOccluded.SetNumZeroed(Victims.Num(), EAllowShrinking::No);
+
+	const UWorld* World = GetWorld();
+
+	ShooterBatchedTrace::ForEachQuery(Victims.Num(), [this, World](int32 i)
+	{
+		const FShooterExplosionVictim& Victim = Victims[i];
+		const FShooterExplosionRequest& Explosion = ResolvingExplosions[Victim.ExplosionIndex];
+
+		if (!Explosion.ExplosionParams.bOcclusion)
+		{
+			return;
+		}
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterExplosionOcclusion), false, Victim.Actor);
+		QueryParams.AddIgnoredActor(Explosion.HitParams.Causer);
+
+		VictimOccluded[i] = World->LineTraceTestByChannel(Explosion.Center, Victim.Location, ECC_Visibility, QueryParams) ? 1 : 0;
+
+	});
+}
+
+void UShooterExplosionSubsystem::ApplyDamage()
+{
+	// look up the damage subsystem once for the whole batch
+	UShooterDamageSubsystem* DamageSubsystem = GetWorld()->GetSubsystem<UShooterDamageSubsystem>();
+
+	for (int32 i = 0; i < Victims.Num(); ++i)
+	{
+		const FShooterExplosionVictim& Victim = Victims[i];
+
+		// skip shielded victims, and any destroyed by an earlier victim's damage
+		if (VictimOccluded[i] || !IsValid(Victim.Actor))
+		{
+			continue;
+		}
+
+		const FShooterExplosionRequest& Explosion = ResolvingExplosions[Victim.ExplosionIndex];
+
+		// push and/or damage the victim away from the explosion
+		const FVector ExplosionDir = (Victim.Location - Explosion.Center).GetSafeNormal();
+
+		Explosion.HitParams.ApplyScaledHit(Victim.Actor, Victim.Component, Explosion.Center, ExplosionDir, Victim.Scale, DamageSubsystem);
+	}
+}
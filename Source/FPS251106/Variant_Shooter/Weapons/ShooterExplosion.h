@@ -0,0 +1,144 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "ShooterHitParams.h"
+#include "ShooterExplosion.generated.h"
+
+/**
+ *  Radius and falloff settings for an explosion
+ */
+USTRUCT(BlueprintType)
+struct FShooterExplosionParams
+{
+	GENERATED_BODY()
+
+	/** Max distance for actors to be affected by the explosion */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion", meta = (ClampMin = 0, ClampMax = 5000, Units = "cm"))
+	float Radius = 500.0f;
+
+	/** If true, damage falls off between the inner radius and the radius. Otherwise every actor in the radius takes full damage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion")
+	bool bFalloff = false;
+
+	/** Actors within this distance take full damage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion", meta = (EditCondition = "bFalloff", ClampMin = 0, ClampMax = 5000, Units = "cm"))
+	float InnerRadius = 100.0f;
+
+	/** Exponent of the damage falloff between the inner radius and the radius */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion", meta = (EditCondition = "bFalloff", ClampMin = 0, ClampMax = 10))
+	float FalloffExponent = 1.0f;
+
+	/** Fraction of the damage still applied at the edge of the radius */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion", meta = (EditCondition = "bFalloff", ClampMin = 0, ClampMax = 1))
+	float MinDamageScale = 0.0f;
+
+	/** If true, actors behind blocking geometry aren't damaged */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Explosion")
+	bool bOcclusion = false;
+};
+
+/**
+ *  An explosion waiting for its overlap results
+ */
+USTRUCT()
+struct FShooterExplosionRequest
+{
+	GENERATED_BODY()
+
+	/** Center of the explosion */
+	FVector Center = FVector::ZeroVector;
+
+	/** Radius and falloff settings */
+	UPROPERTY()
+	FShooterExplosionParams ExplosionParams;
+
+	/** Damage and scoring settings, copied from the source so it can be recycled before the explosion resolves */
+	UPROPERTY()
+	FShooterHitParams HitParams;
+
+	/** Handle of the async overlap query */
+	FTraceHandle OverlapHandle;
+};
+
+/**
+ *  An actor caught in an explosion
+ */
+struct FShooterExplosionVictim
+{
+	/** Index of the explosion in the batch */
+	int32 ExplosionIndex = INDEX_NONE;
+
+	/** Damaged actor */
+	AActor* Actor = nullptr;
+
+	/** First overlapped component of the actor */
+	UPrimitiveComponent* Component = nullptr;
+
+	/** Location damage and impulses are aimed at */
+	FVector Location = FVector::ZeroVector;
+
+	/** Falloff scale for damage and impulse */
+	float Scale = 1.0f;
+};
+
+/**
+ *  World subsystem that resolves explosion damage in batches
+ *  Explosions issue an async overlap query and are resolved once the results come back on a later frame.
+ *  Overlaps are deduplicated per actor with frame-scratch storage, occlusion is traced for all victims at once,
+ *  and then damage and impulses with distance falloff are applied for every victim in a single pass.
+ */
+UCLASS()
+class FPS251106_API UShooterExplosionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Explosions waiting for their overlap results */
+	UPROPERTY()
+	TArray<FShooterExplosionRequest> PendingExplosions;
+
+	/** Explosions being resolved this frame */
+	UPROPERTY()
+	TArray<FShooterExplosionRequest> ResolvingExplosions;
+
+	/** Frame scratch: actors already caught by the explosion being gathered */
+	TSet<const AActor*> SeenActors;
+
+	/** Frame scratch: victims of every explosion being resolved */
+	TArray<FShooterExplosionVictim> Victims;
+
+	/** Frame scratch: non-zero if the victim is shielded from the explosion */
+	TArray<uint8> VictimOccluded;
+
+	/** Frame scratch: overlap results */
+	FOverlapDatum OverlapData;
+
+public:
+
+	/** Queues an explosion. Damage is applied once its async overlap query completes */
+	void QueueExplosion(const FVector& Center, const FShooterExplosionParams& ExplosionParams, const FShooterHitParams& HitParams);
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only resolve explosions in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Deduplicates the overlaps of an explosion into victims with distance falloff */
+	void GatherVictims(int32 ExplosionIndex, const TArray<FOverlapResult>& Overlaps);
+
+	/** Traces occlusion for every victim */
+	void TraceOcclusion();
+
+	/** Applies damage and impulses to every victim */
+	void ApplyDamage();
+};
@@ -0,0 +1,37 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "ShooterFireEvent.generated.h"
+
+/**
+ *  Compact description of a single shot, replicated instead of the projectile it spawns
+ *  Remote machines rebuild the shot from it to play cosmetic-only effects
+ */
+USTRUCT(BlueprintType)
+struct FShooterFireEvent
+{
+	GENERATED_BODY()
+
+	/** World location the shot starts at, quantized to 1cm */
+	UPROPERTY(BlueprintReadOnly, Category="Fire Event")
+	FVector_NetQuantize Origin = FVector::ZeroVector;
+
+	/** Aim direction of the shot before spread, quantized to 16 bits per component */
+	UPROPERTY(BlueprintReadOnly, Category="Fire Event")
+	FVector_NetQuantizeNormal Direction = FVector::ForwardVector;
+
+	/** Index of the shot in the weapon's sequence. Seeds the shot's spread so every machine computes the same one */
+	UPROPERTY()
+	uint16 ShotIndex = 0;
+
+	/** Index of the firing weapon in its owner's weapon list, so every machine fires the shot from the same weapon */
+	UPROPERTY()
+	uint8 WeaponIndex = 0;
+
+	/** Estimated server time the shot was fired at */
+	UPROPERTY(BlueprintReadOnly, Category="Fire Event")
+	float Timestamp = 0.0f;
+};
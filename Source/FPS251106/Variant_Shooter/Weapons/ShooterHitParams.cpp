@@ -0,0 +1,45 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterHitParams.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/Pawn.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "Variant_Shooter/ShooterDamage.h"
+
+void FShooterHitParams::ApplyHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection) const
+{
+	ApplyScaledHit(HitActor, HitComp, HitLocation, HitDirection, 1.0f, FindDamageSubsystem());
+}
+
+void FShooterHitParams::ApplyScaledHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection, float Scale, UShooterDamageSubsystem* DamageSubsystem) const
+{
+	// have we hit a character?
+	if (ACharacter* HitCharacter = Cast<ACharacter>(HitActor))
+	{
+		// ignore the owner of the shot
+		if (HitCharacter != Owner || bDamageOwner)
+		{
+			// queue the damage. The damage subsystem applies and scores it with the rest of the frame's hits
+			if (DamageSubsystem)
+			{
+				DamageSubsystem->QueueHit(HitCharacter, Damage * Scale, Instigator, Causer, DamageType);
+			}
+		}
+	}
+
+	// have we hit a physics object?
+	if (HitComp && HitComp->IsSimulatingPhysics())
+	{
+		// give some physics impulse to the object
+		HitComp->AddImpulseAtLocation(HitDirection * PhysicsForce * Scale, HitLocation);
+	}
+}
+
+UShooterDamageSubsystem* FShooterHitParams::FindDamageSubsystem() const
+{
+	const UWorld* World = Causer ? Causer->GetWorld() : nullptr;
+
+	return World ? World->GetSubsystem<UShooterDamageSubsystem>() : nullptr;
+}
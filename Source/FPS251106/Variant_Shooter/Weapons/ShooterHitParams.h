@@ -0,0 +1,59 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/DamageType.h"
+#include "ShooterHitParams.generated.h"
+
+class AActor;
+class APawn;
+class UPrimitiveComponent;
+class UShooterDamageSubsystem;
+
+/**
+ *  Damage and scoring settings for a single shot
+ *  Shared by projectiles and hitscan weapons so both go through the same damage and scoring path
+ */
+USTRUCT(BlueprintType)
+struct FShooterHitParams
+{
+	GENERATED_BODY()
+
+	/** Damage to apply on hit */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hit")
+	float Damage = 25.0f;
+
+	/** Type of damage to apply */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hit")
+	TSubclassOf<UDamageType> DamageType;
+
+	/** Physics impulse to apply to simulating components */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hit")
+	float PhysicsForce = 100.0f;
+
+	/** If true, the shot can damage the character that fired it */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Hit")
+	bool bDamageOwner = false;
+
+	/** Actor that owns the shot */
+	UPROPERTY()
+	TObjectPtr<AActor> Owner;
+
+	/** Pawn that fired the shot */
+	UPROPERTY()
+	TObjectPtr<APawn> Instigator;
+
+	/** Actor that deals the damage, either the projectile or the weapon */
+	UPROPERTY()
+	TObjectPtr<AActor> Causer;
+
+	/** Queues damage on the given actor, and pushes the hit component if it simulates physics */
+	void ApplyHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection) const;
+
+	/** Applies a hit with scaled damage and impulse through an already resolved damage subsystem. Used to apply hits in batches */
+	void ApplyScaledHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection, float Scale, UShooterDamageSubsystem* DamageSubsystem) const;
+
+	/** Returns the damage subsystem hits should be queued with, if any */
+	UShooterDamageSubsystem* FindDamageSubsystem() const;
+};
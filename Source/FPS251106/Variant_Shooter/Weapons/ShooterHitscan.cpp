@@ -0,0 +1,139 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterHitscan.h"
+#include "ShooterWeapon.h"
+#include "ShooterLagCompensation.h"
+#include "Variant_Shooter/ShooterDamage.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "ShooterBatchedTrace.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hitscan Batch"), STAT_ShooterHitscanBatch, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Hitscan Traces"), STAT_ShooterHitscanTraces, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hitscan Shots"), STAT_ShooterHitscanShots, STATGROUP_Shooter);
+
+void UShooterHitscanSubsystem::QueueTrace(AShooterWeapon* Weapon, const FVector& Start, const FVector& End, ECollisionChannel Channel, const FShooterHitParams& HitParams, double RewindTime, bool bCosmeticOnly)
+{
+	FShooterHitscanRequest& Request = QueuedRequests.AddDefaulted_GetRef();
+	Request.Start = Start;
+	Request.End = End;
+	Request.Channel = Channel;
+	Request.HitParams = HitParams;
+	Request.Weapon = Weapon;
+	Request.RewindTime = RewindTime;
+	Request.bCosmeticOnly = bCosmeticOnly;
+}
+
+void UShooterHitscanSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (QueuedRequests.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterHitscanBatch);
+	INC_DWORD_STAT_BY(STAT_ShooterHitscanShots, QueuedRequests.Num());
+
+	// take the queued shots. Shots fired while resolving go into the next batch
+	Swap(QueuedRequests, ResolvingRequests);
+
+	// trace all shots together
+	TraceRequests();
+
+	// damage and score the hits
+	ResolveRequests();
+
+	ResolvingRequests.Reset();
+}
+
+TStatId UShooterHitscanSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterHitscanSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterHitscanSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterHitscanSubsystem::TraceRequests()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterHitscanTraces);
+
+	const int32 NumRequests = ResolvingRequests.Num();
+
+	TraceHits.SetNum(NumRequests, EAllowShrinking::No);
+	TraceBlocked.SetNumZeroed(NumRequests, EAllowShrinking::No);
+
+	const UWorld* World = GetWorld();
+
+	// gather the lag compensated characters on the game thread
+	RewoundActors.Reset();
+
+	if (const UShooterLagCompensationSubsystem* LagCompensation = World->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		RewoundActors.Append(LagCompensation->GetTrackedActors());
+	}
+
+	ShooterBatchedTrace::ForEachQuery(NumRequests, [this, World](int32 i)
+	{
+		const FShooterHitscanRequest& Request = ResolvingRequests[i];
+
+		// ignore the shooter and its weapon
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterHitscanTrace), false, Request.HitParams.Instigator);
+		QueryParams.AddIgnoredActor(Request.HitParams.Causer);
+
+		// lag compensated shots only trace the world here. The characters are tested at their rewound location later
+		if (Request.RewindTime >= 0.0)
+		{
+			QueryParams.AddIgnoredActors(RewoundActors);
+		}
+
+		TraceHits[i] = FHitResult();
+		TraceBlocked[i] = World->LineTraceSingleByChannel(TraceHits[i], Request.Start, Request.End, Request.Channel, QueryParams) ? 1 : 0;
+
+	});
+}
+
+void UShooterHitscanSubsystem::ResolveRequests()
+{
+	const UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>();
+
+	// look up the damage subsystem once for the whole batch
+	UShooterDamageSubsystem* DamageSubsystem = GetWorld()->GetSubsystem<UShooterDamageSubsystem>();
+
+	for (int32 i = 0; i < ResolvingRequests.Num(); ++i)
+	{
+		const FShooterHitscanRequest& Request = ResolvingRequests[i];
+		FHitResult& Hit = TraceHits[i];
+		bool bBlocked = TraceBlocked[i] != 0;
+
+		// test the rewound characters in front of whatever world geometry the trace hit
+		if (Request.RewindTime >= 0.0 && LagCompensation)
+		{
+			FHitResult RewoundHit;
+
+			if (LagCompensation->TraceRewound(Request.Start, bBlocked ? Hit.Location : Request.End, Request.RewindTime, Request.HitParams.Instigator, RewoundHit))
+			{
+				Hit = RewoundHit;
+				bBlocked = true;
+			}
+		}
+
+		// damage and score the hit through the shared hit path
+		if (bBlocked && !Request.bCosmeticOnly)
+		{
+			Request.HitParams.ApplyScaledHit(Hit.GetActor(), Hit.GetComponent(), Hit.ImpactPoint, (Request.End - Request.Start).GetSafeNormal(), 1.0f, DamageSubsystem);
+		}
+
+		// let the weapon play any impact effects
+		if (AShooterWeapon* Weapon = Request.Weapon.Get())
+		{
+			Weapon->OnHitscanResolved(Request.Start, bBlocked ? Hit.ImpactPoint : Request.End, Hit, bBlocked);
+		}
+	}
+}
@@ -0,0 +1,96 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/HitResult.h"
+#include "ShooterHitParams.h"
+#include "ShooterHitscan.generated.h"
+
+class AShooterWeapon;
+
+/**
+ *  A hitscan shot waiting to be traced
+ */
+USTRUCT()
+struct FShooterHitscanRequest
+{
+	GENERATED_BODY()
+
+	/** Trace start location */
+	FVector Start = FVector::ZeroVector;
+
+	/** Trace end location */
+	FVector End = FVector::ZeroVector;
+
+	/** Channel to trace on */
+	TEnumAsByte<ECollisionChannel> Channel = ECC_Visibility;
+
+	/** Damage and scoring settings for the shot */
+	UPROPERTY()
+	FShooterHitParams HitParams;
+
+	/** Weapon that fired the shot. Notified once the shot is resolved */
+	TWeakObjectPtr<AShooterWeapon> Weapon;
+
+	/** Server time to evaluate characters at for lag compensated shots. Negative to use their current location */
+	double RewindTime = -1.0;
+
+	/** If true, the shot only drives effects and doesn't deal damage */
+	bool bCosmeticOnly = false;
+};
+
+/**
+ *  World subsystem that resolves all hitscan shots fired during a frame as a single batch
+ *  Weapons queue their traces as they fire. Once per frame the queued traces are run together,
+ *  optionally across worker threads, and the hits are then damaged and scored on the game thread.
+ */
+UCLASS()
+class FPS251106_API UShooterHitscanSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Shots queued since the last batch */
+	UPROPERTY()
+	TArray<FShooterHitscanRequest> QueuedRequests;
+
+	/** Shots in the batch being resolved */
+	UPROPERTY()
+	TArray<FShooterHitscanRequest> ResolvingRequests;
+
+	/** Per-batch scratch: trace results */
+	TArray<FHitResult> TraceHits;
+
+	/** Per-batch scratch: non-zero if the trace found a blocking hit */
+	TArray<uint8> TraceBlocked;
+
+	/** Per-batch scratch: characters that lag compensated shots test against their rewound hitboxes instead */
+	TArray<AActor*> RewoundActors;
+
+public:
+
+	/** Queues a hitscan shot to be resolved with the next batch */
+	void QueueTrace(AShooterWeapon* Weapon, const FVector& Start, const FVector& End, ECollisionChannel Channel, const FShooterHitParams& HitParams, double RewindTime = -1.0, bool bCosmeticOnly = false);
+
+	/** Returns the number of shots waiting for the next batch */
+	int32 GetNumQueuedTraces() const { return QueuedRequests.Num(); }
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only resolve hitscan shots in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Runs every trace in the batch */
+	void TraceRequests();
+
+	/** Applies damage for every blocking hit in the batch and notifies the weapons */
+	void ResolveRequests();
+};
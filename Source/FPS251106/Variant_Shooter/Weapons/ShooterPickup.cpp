@@ -8,11 +8,14 @@
 #include "ShooterWeaponHolder.h"
 #include "ShooterWeapon.h"
 #include "Engine/World.h"
-#include "TimerManager.h"
+#include "Engine/StreamableManager.h"
+#include "ShooterStreaming.h"
+#include "ShooterPickupSubsystem.h"
 
 AShooterPickup::AShooterPickup()
 {
- 	PrimaryActorTick.bCanEverTick = true;
+	// the pickup subsystem checks for pawns and drives respawns, so pickups don't need to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	// create the root
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
@@ -22,20 +25,19 @@ AShooterPickup::AShooterPickup()
 	SphereCollision->SetupAttachment(RootComponent);
 
 	SphereCollision->SetRelativeLocation(FVector(0.0f, 0.0f, 84.0f));
-	SphereCollision->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
-	SphereCollision->SetCollisionObjectType(ECC_WorldStatic);
-	SphereCollision->SetCollisionResponseToAllChannels(ECR_Ignore);
-	SphereCollision->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
-	SphereCollision->bFillCollisionUnderneathForNavmesh = true;
 
-	// subscribe to the collision overlap on the sphere
-	SphereCollision->OnComponentBeginOverlap.AddDynamic(this, &AShooterPickup::OnOverlap);
+	// the sphere only defines the trigger shape. The pickup subsystem tests pawns against it
+	SphereCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SphereCollision->SetGenerateOverlapEvents(false);
 
 	// create the mesh
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
 	Mesh->SetupAttachment(SphereCollision);
 
 	Mesh->SetCollisionProfileName(FName("NoCollision"));
+
+	// the mesh is swapped from the placeholder at runtime, so it can't be static
+	Mesh->SetMobility(EComponentMobility::Movable);
 }
 
 void AShooterPickup::OnConstruction(const FTransform& Transform)
@@ -44,8 +46,22 @@ void AShooterPickup::OnConstruction(const FTransform& Transform)
 
 	if (FWeaponTableRow* WeaponData = WeaponType.GetRow<FWeaponTableRow>(FString()))
 	{
-		// set the mesh
-		Mesh->SetStaticMesh(WeaponData->StaticMesh.LoadSynchronous());
+		if (UStaticMesh* LoadedMesh = WeaponData->StaticMesh.Get())
+		{
+			// the mesh is already resident, so use it right away
+			Mesh->SetStaticMesh(LoadedMesh);
+
+		} else if (GetWorld() && !GetWorld()->IsGameWorld()) {
+
+			// load the mesh in the editor so the pickup previews correctly
+			Mesh->SetStaticMesh(WeaponData->StaticMesh.LoadSynchronous());
+
+		} else {
+
+			// show the placeholder until the mesh streams in
+			Mesh->SetStaticMesh(PlaceholderMesh);
+
+		}
 	}
 }
 
@@ -55,8 +71,18 @@ void AShooterPickup::BeginPlay()
 
 	if (FWeaponTableRow* WeaponData = WeaponType.GetRow<FWeaponTableRow>(FString()))
 	{
-		// copy the weapon class
-		WeaponClass = WeaponData->WeaponToSpawn;
+		// copy the weapon assets
+		PickupMesh = WeaponData->StaticMesh;
+		PickupWeaponClass = WeaponData->WeaponToSpawn;
+
+		// stream them in the background
+		RequestWeaponAssets();
+	}
+
+	// let the pickup subsystem check for pawns touching us
+	if (UShooterPickupSubsystem* Pickups = GetWorld()->GetSubsystem<UShooterPickupSubsystem>())
+	{
+		Pickups->RegisterPickup(this);
 	}
 }
 
@@ -64,29 +90,70 @@ void AShooterPickup::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
-	// clear the respawn timer
-	GetWorld()->GetTimerManager().ClearTimer(RespawnTimer);
+	// leave the pickup subsystem
+	if (PickupSlot != INDEX_NONE)
+	{
+		if (UShooterPickupSubsystem* Pickups = GetWorld()->GetSubsystem<UShooterPickupSubsystem>())
+		{
+			Pickups->UnregisterPickup(this);
+		}
+	}
+
+	// stop streaming and release the weapon assets
+	if (AssetsHandle.IsValid())
+	{
+		AssetsHandle->CancelHandle();
+		AssetsHandle.Reset();
+	}
 }
 
-void AShooterPickup::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AShooterPickup::RequestWeaponAssets()
 {
-	// have we collided against a weapon holder?
-	if (IShooterWeaponHolder* WeaponHolder = Cast<IShooterWeaponHolder>(OtherActor))
+	TArray<FSoftObjectPath> AssetPaths;
+
+	if (!PickupMesh.IsNull())
 	{
-		WeaponHolder->AddWeaponClass(WeaponClass);
+		AssetPaths.Add(PickupMesh.ToSoftObjectPath());
+	}
 
-		// hide this mesh
-		SetActorHiddenInGame(true);
+	if (!PickupWeaponClass.IsNull())
+	{
+		AssetPaths.Add(PickupWeaponClass.ToSoftObjectPath());
+	}
 
-		// disable collision
-		SetActorEnableCollision(false);
+	if (AssetPaths.Num() == 0)
+	{
+		return;
+	}
 
-		// disable ticking
-		SetActorTickEnabled(false);
+	// prefetch the weapon class along with the mesh so picking it up never loads it
+	AssetsHandle = ShooterStreaming::GetStreamableManager().RequestAsyncLoad(AssetPaths, FStreamableDelegate::CreateUObject(this, &AShooterPickup::OnWeaponAssetsLoaded));
+}
 
-		// schedule the respawn
-		GetWorld()->GetTimerManager().SetTimer(RespawnTimer, this, &AShooterPickup::RespawnPickup, RespawnTime, false);
+void AShooterPickup::OnWeaponAssetsLoaded()
+{
+	// swap the placeholder for the weapon mesh
+	if (UStaticMesh* LoadedMesh = PickupMesh.Get())
+	{
+		Mesh->SetStaticMesh(LoadedMesh);
 	}
+
+	// the weapon class can now be granted
+	WeaponClass = PickupWeaponClass.Get();
+}
+
+void AShooterPickup::HandlePickedUp(IShooterWeaponHolder* WeaponHolder)
+{
+	// picked up before the weapon class streamed in. Load it now, and count the hitch
+	if (!WeaponClass)
+	{
+		WeaponClass = ShooterStreaming::LoadSynchronous(PickupWeaponClass);
+	}
+
+	WeaponHolder->AddWeaponClass(WeaponClass);
+
+	// hide this mesh. The pickup subsystem has already disabled us and scheduled the respawn
+	SetActorHiddenInGame(true);
 }
 
 void AShooterPickup::RespawnPickup()
@@ -100,9 +167,19 @@ void AShooterPickup::RespawnPickup()
 
 void AShooterPickup::FinishRespawn()
 {
-	// enable collision
-	SetActorEnableCollision(true);
+	// let pawns pick us up again
+	if (UShooterPickupSubsystem* Pickups = GetWorld()->GetSubsystem<UShooterPickupSubsystem>())
+	{
+		Pickups->SetPickupAvailable(this, true);
+	}
+}
 
-	// enable tick
-	SetActorTickEnabled(true);
+FVector AShooterPickup::GetPickupLocation() const
+{
+	return SphereCollision->GetComponentLocation();
+}
+
+float AShooterPickup::GetPickupRadius() const
+{
+	return SphereCollision->GetScaledSphereRadius();
 }
@@ -11,6 +11,8 @@
 class USphereComponent;
 class UPrimitiveComponent;
 class AShooterWeapon;
+class IShooterWeaponHolder;
+struct FStreamableHandle;
 
 /**
  *  Holds information about a type of weapon pickup
@@ -24,9 +26,9 @@ struct FWeaponTableRow : public FTableRowBase
 	UPROPERTY(EditAnywhere)
 	TSoftObjectPtr<UStaticMesh> StaticMesh;
 
-	/** Weapon class to grant on pickup */
+	/** Weapon class to grant on pickup. Streamed in by the pickup so it's resident before it's picked up */
 	UPROPERTY(EditAnywhere)
-	TSubclassOf<AShooterWeapon> WeaponToSpawn;
+	TSoftClassPtr<AShooterWeapon> WeaponToSpawn;
 };
 
 /**
@@ -37,7 +39,7 @@ class FPS251106_API AShooterPickup : public AActor
 {
 	GENERATED_BODY()
 
-	/** Collision sphere */
+	/** Trigger sphere. Has no collision, the pickup subsystem tests pawns against it */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
 	USphereComponent* SphereCollision;
 
@@ -51,15 +53,28 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Pickup")
 	FDataTableRowHandle WeaponType;
 
-	/** Type to weapon to grant on pickup. Set from the weapon data table. */
+	/** Mesh displayed while the weapon mesh is streaming in */
+	UPROPERTY(EditAnywhere, Category="Pickup")
+	TObjectPtr<UStaticMesh> PlaceholderMesh;
+
+	/** Type to weapon to grant on pickup. Set from the weapon data table once it's loaded */
 	TSubclassOf<AShooterWeapon> WeaponClass;
+
+	/** Weapon mesh to stream in. Set from the weapon data table */
+	TSoftObjectPtr<UStaticMesh> PickupMesh;
+
+	/** Weapon class to stream in. Set from the weapon data table */
+	TSoftClassPtr<AShooterWeapon> PickupWeaponClass;
+
+	/** Keeps the streamed weapon assets resident while this pickup is alive */
+	TSharedPtr<FStreamableHandle> AssetsHandle;
 	
 	/** Time to wait before respawning this pickup */
 	UPROPERTY(EditAnywhere, Category="Pickup", meta = (ClampMin = 0, ClampMax = 120, Units = "s"))
 	float RespawnTime = 4.0f;
 
-	/** Timer to respawn the pickup */
-	FTimerHandle RespawnTimer;
+	/** Slot of this pickup in the pickup subsystem */
+	int32 PickupSlot = INDEX_NONE;
 
 public:	
 	
@@ -77,15 +92,37 @@ protected:
 	/** Gameplay cleanup */
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	/** Handles collision overlap */
-	UFUNCTION()
-	virtual void OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+public:
 
-protected:
+	/** Called by the pickup subsystem when a weapon holder touches this pickup */
+	virtual void HandlePickedUp(IShooterWeaponHolder* WeaponHolder);
 
-	/** Called when it's time to respawn this pickup */
+	/** Called by the pickup subsystem when it's time to respawn this pickup */
 	void RespawnPickup();
 
+	/** Returns the center of the trigger sphere */
+	FVector GetPickupLocation() const;
+
+	/** Returns the radius of the trigger sphere */
+	float GetPickupRadius() const;
+
+	/** Returns the time to wait before respawning this pickup */
+	float GetRespawnTime() const { return RespawnTime; }
+
+	/** Returns the slot of this pickup in the pickup subsystem */
+	int32 GetPickupSlot() const { return PickupSlot; }
+
+	/** Sets the slot of this pickup in the pickup subsystem */
+	void SetPickupSlot(int32 InSlot) { PickupSlot = InSlot; }
+
+protected:
+
+	/** Requests the weapon mesh and class from the streamable manager */
+	void RequestWeaponAssets();
+
+	/** Called when the weapon mesh and class have finished streaming in */
+	void OnWeaponAssetsLoaded();
+
 	/** Passes control to Blueprint to animate the pickup respawn. Should end by calling FinishRespawn */
 	UFUNCTION(BlueprintImplementableEvent, Category="Pickup", meta = (DisplayName = "OnRespawn"))
 	void BP_OnRespawn();
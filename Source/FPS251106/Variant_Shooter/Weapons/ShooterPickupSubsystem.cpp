@@ -0,0 +1,240 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterPickupSubsystem.h"
+#include "ShooterPickup.h"
+#include "ShooterWeaponHolder.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pickups"), STAT_ShooterPickups, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Candidates"), STAT_ShooterPickupCandidates, STATGROUP_Shooter);
+
+static float GShooterPickupCellSize = 1000.0f;
+static FAutoConsoleVariableRef CVarShooterPickupCellSize(
+	TEXT("Shooter.Pickups.CellSize"),
+	GShooterPickupCellSize,
+	TEXT("Size of the pickup grid cells. Applies to worlds created after the change"),
+	ECVF_Default
+);
+
+void UShooterPickupSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CellSize = FMath::Max(GShooterPickupCellSize, 100.0f);
+}
+
+void UShooterPickupSubsystem::RegisterPickup(AShooterPickup* Pickup)
+{
+	if (!IsValid(Pickup) || Pickup->GetPickupSlot() != INDEX_NONE)
+	{
+		return;
+	}
+
+	// reuse a free slot if we have one
+	const int32 Slot = FreeSlots.Num() > 0 ? FreeSlots.Pop(EAllowShrinking::No) : Entries.AddDefaulted();
+
+	FShooterPickupEntry& Entry = Entries[Slot];
+	Entry.Pickup = Pickup;
+	Entry.Location = Pickup->GetPickupLocation();
+	Entry.Radius = Pickup->GetPickupRadius();
+	Entry.Cell = GetCell(Entry.Location);
+	Entry.Id = ++LastPickupId;
+	Entry.bAvailable = true;
+
+	Grid.FindOrAdd(Entry.Cell).Add(Slot);
+
+	// pawns search as many cells as it takes to reach the largest pickup
+	MaxPickupRadius = FMath::Max(MaxPickupRadius, Entry.Radius);
+
+	Pickup->SetPickupSlot(Slot);
+	++NumPickups;
+}
+
+void UShooterPickupSubsystem::UnregisterPickup(AShooterPickup* Pickup)
+{
+	const int32 Slot = Pickup->GetPickupSlot();
+
+	if (!Entries.IsValidIndex(Slot) || Entries[Slot].Pickup != Pickup)
+	{
+		return;
+	}
+
+	if (TArray<int32>* CellSlots = Grid.Find(Entries[Slot].Cell))
+	{
+		CellSlots->RemoveSingleSwap(Slot, EAllowShrinking::No);
+	}
+
+	// any respawn still scheduled for this slot is discarded by its id
+	Entries[Slot] = FShooterPickupEntry();
+	FreeSlots.Add(Slot);
+
+	Pickup->SetPickupSlot(INDEX_NONE);
+	--NumPickups;
+}
+
+void UShooterPickupSubsystem::SetPickupAvailable(AShooterPickup* Pickup, bool bAvailable)
+{
+	const int32 Slot = Pickup->GetPickupSlot();
+
+	if (Entries.IsValidIndex(Slot) && Entries[Slot].Pickup == Pickup)
+	{
+		Entries[Slot].bAvailable = bAvailable;
+	}
+}
+
+void UShooterPickupSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (NumPickups == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterPickups);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// bring back the pickups that are due
+	ProcessRespawns(Now);
+
+	// find the pickups touched by a pawn, then grant them outside of the pawn iteration
+	FindTouchedPickups();
+	ProcessTouchedPickups(Now);
+}
+
+TStatId UShooterPickupSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterPickupSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterPickupSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FIntPoint UShooterPickupSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+}
+
+void UShooterPickupSubsystem::ProcessRespawns(double Now)
+{
+	// the schedule is a heap, so we only ever look at the earliest respawn
+	while (RespawnSchedule.Num() > 0 && RespawnSchedule.HeapTop().RespawnTime <= Now)
+	{
+		FShooterPickupRespawn Respawn;
+		RespawnSchedule.HeapPop(Respawn, EAllowShrinking::No);
+
+		// skip respawns for pickups that were unregistered in the meantime
+		if (!Entries.IsValidIndex(Respawn.Slot) || Entries[Respawn.Slot].Id != Respawn.Id)
+		{
+			continue;
+		}
+
+		if (AShooterPickup* Pickup = Entries[Respawn.Slot].Pickup)
+		{
+			Pickup->RespawnPickup();
+		}
+	}
+}
+
+void UShooterPickupSubsystem::FindTouchedPickups()
+{
+	Touched.Reset();
+
+	int32 NumCandidates = 0;
+
+	for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+	{
+		APawn* Pawn = *It;
+
+		// only weapon holders can pick up weapons
+		if (!Cast<IShooterWeaponHolder>(Pawn))
+		{
+			continue;
+		}
+
+		float PawnRadius, PawnHalfHeight;
+		Pawn->GetSimpleCollisionCylinder(PawnRadius, PawnHalfHeight);
+
+		const FVector PawnLocation = Pawn->GetActorLocation();
+
+		// the pawn is a capsule. Find the segment running through its center
+		const float SegmentHalfLength = FMath::Max(PawnHalfHeight - PawnRadius, 0.0f);
+
+		// search every cell a pickup touching the pawn could be stored in
+		const float Reach = MaxPickupRadius + PawnRadius;
+		const FIntPoint MinCell = GetCell(PawnLocation - FVector(Reach, Reach, 0.0f));
+		const FIntPoint MaxCell = GetCell(PawnLocation + FVector(Reach, Reach, 0.0f));
+
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				const TArray<int32>* CellSlots = Grid.Find(FIntPoint(X, Y));
+
+				if (!CellSlots)
+				{
+					continue;
+				}
+
+				for (const int32 Slot : *CellSlots)
+				{
+					FShooterPickupEntry& Entry = Entries[Slot];
+
+					if (!Entry.bAvailable)
+					{
+						continue;
+					}
+
+					++NumCandidates;
+
+					// sphere against capsule: test against the closest point on the capsule segment
+					const float OffsetZ = FMath::Clamp(Entry.Location.Z - PawnLocation.Z, -SegmentHalfLength, SegmentHalfLength);
+					const FVector ClosestPoint(PawnLocation.X, PawnLocation.Y, PawnLocation.Z + OffsetZ);
+
+					if (FVector::DistSquared(ClosestPoint, Entry.Location) <= FMath::Square(Entry.Radius + PawnRadius))
+					{
+						// only the first pawn to touch the pickup gets it
+						Entry.bAvailable = false;
+						Touched.Emplace(Slot, Pawn);
+					}
+				}
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterPickupCandidates, NumCandidates);
+}
+
+void UShooterPickupSubsystem::ProcessTouchedPickups(double Now)
+{
+	for (const TPair<int32, APawn*>& Touch : Touched)
+	{
+		const FShooterPickupEntry& Entry = Entries[Touch.Key];
+		AShooterPickup* Pickup = Entry.Pickup;
+
+		if (!IsValid(Pickup) || !IsValid(Touch.Value))
+		{
+			continue;
+		}
+
+		// schedule the respawn before granting, in case the pickup is unregistered while it's granted
+		FShooterPickupRespawn Respawn;
+		Respawn.RespawnTime = Now + Pickup->GetRespawnTime();
+		Respawn.Slot = Touch.Key;
+		Respawn.Id = Entry.Id;
+
+		RespawnSchedule.HeapPush(Respawn);
+
+		Pickup->HandlePickedUp(Cast<IShooterWeaponHolder>(Touch.Value));
+	}
+
+	Touched.Reset();
+}
@@ -0,0 +1,137 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterPickupSubsystem.generated.h"
+
+class AShooterPickup;
+class APawn;
+
+/**
+ *  A pickup registered with the pickup subsystem
+ */
+USTRUCT()
+struct FShooterPickupEntry
+{
+	GENERATED_BODY()
+
+	/** Registered pickup actor */
+	UPROPERTY()
+	TObjectPtr<AShooterPickup> Pickup;
+
+	/** Center of the pickup's trigger sphere */
+	FVector Location = FVector::ZeroVector;
+
+	/** Radius of the pickup's trigger sphere */
+	float Radius = 0.0f;
+
+	/** Grid cell the pickup is stored in */
+	FIntPoint Cell = FIntPoint::ZeroValue;
+
+	/** Unique id of the registration, used to discard stale respawns after the slot is reused */
+	uint32 Id = 0;
+
+	/** If true, the pickup can be picked up */
+	bool bAvailable = false;
+};
+
+/**
+ *  A scheduled pickup respawn
+ */
+struct FShooterPickupRespawn
+{
+	/** Game time the pickup respawns at */
+	double RespawnTime = 0.0;
+
+	/** Slot of the pickup to respawn */
+	int32 Slot = INDEX_NONE;
+
+	/** Registration id of the pickup to respawn */
+	uint32 Id = 0;
+
+	/** Orders the schedule heap so the earliest respawn is on top */
+	bool operator<(const FShooterPickupRespawn& Other) const { return RespawnTime < Other.RespawnTime; }
+};
+
+/**
+ *  World subsystem that handles every weapon pickup in the world
+ *  Pickups are stored in a uniform 2D grid. Once per tick, each weapon holder pawn is checked against
+ *  the pickups in its neighboring cells, so pickups don't need overlap bodies or tick functions.
+ *  Respawns are driven from a single heap sorted by respawn time.
+ */
+UCLASS()
+class FPS251106_API UShooterPickupSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Registered pickups by slot. Freed slots are reused */
+	UPROPERTY()
+	TArray<FShooterPickupEntry> Entries;
+
+	/** Slots free for reuse */
+	TArray<int32> FreeSlots;
+
+	/** Slots of the pickups in each grid cell */
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	/** Pending respawns, kept as a heap */
+	TArray<FShooterPickupRespawn> RespawnSchedule;
+
+	/** Frame scratch: pickups touched this tick, and the pawn that touched them */
+	TArray<TPair<int32, APawn*>> Touched;
+
+	/** Size of the grid cells, fixed when the subsystem is created */
+	float CellSize = 1000.0f;
+
+	/** Largest trigger radius of any registered pickup */
+	float MaxPickupRadius = 0.0f;
+
+	/** Number of registered pickups */
+	int32 NumPickups = 0;
+
+	/** Last registration id handed out */
+	uint32 LastPickupId = 0;
+
+public:
+
+	/** Subsystem initialization */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** Adds a pickup to the grid */
+	void RegisterPickup(AShooterPickup* Pickup);
+
+	/** Removes a pickup from the grid */
+	void UnregisterPickup(AShooterPickup* Pickup);
+
+	/** Sets whether a registered pickup can be picked up */
+	void SetPickupAvailable(AShooterPickup* Pickup, bool bAvailable);
+
+	/** Returns the number of registered pickups */
+	int32 GetNumPickups() const { return NumPickups; }
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only handle pickups in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Returns the grid cell containing the location */
+	FIntPoint GetCell(const FVector& Location) const;
+
+	/** Respawns every pickup whose respawn time has come */
+	void ProcessRespawns(double Now);
+
+	/** Checks every weapon holder pawn against the pickups in its neighboring cells */
+	void FindTouchedPickups();
+
+	/** Grants the touched pickups and schedules their respawns */
+	void ProcessTouchedPickups(double Now);
+};
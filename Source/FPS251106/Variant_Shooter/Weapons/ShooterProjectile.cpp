@@ -4,25 +4,23 @@
 #include "ShooterProjectile.h"
 #include "Components/SphereComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
-#include "GameFramework/Character.h"
-#include "Kismet/GameplayStatics.h"
 #include "GameFramework/DamageType.h"
 #include "GameFramework/Pawn.h"
-#include "GameFramework/Controller.h"
-#include "Engine/OverlapResult.h"
 #include "Engine/World.h"
 #include "TimerManager.h"
-#include "Variant_Shooter/ShooterGameMode.h"
-#include "Variant_Shooter/ShooterCharacter.h"
-#include "Variant_Shooter/AI/ShooterNPC.h"
+#include "ShooterProjectilePool.h"
+#include "ShooterProjectileSimulation.h"
+#include "ShooterHitParams.h"
+#include "ShooterExplosion.h"
+#include "ShooterLagCompensation.h"
 
 AShooterProjectile::AShooterProjectile()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
-	// Enable replication
-	bReplicates = true;
-	SetReplicateMovement(true);
+	// projectiles don't replicate. The server fires the authoritative projectile,
+	// and every other machine spawns its own cosmetic-only copy from the weapon's fire event
+	bReplicates = false;
 
 	// create the collision component and assign it as the root
 	RootComponent = CollisionComponent = CreateDefaultSubobject<USphereComponent>(TEXT("Collision Component"));
@@ -49,6 +47,12 @@ void AShooterProjectile::BeginPlay()
 	
 	// ignore the pawn that shot this projectile
 	CollisionComponent->IgnoreActorWhenMoving(GetInstigator(), true);
+
+	// start moving. Pooled projectiles are parked right away and only launch when they're handed out
+	if (!bPooled)
+	{
+		LaunchProjectile();
+	}
 }
 
 void AShooterProjectile::EndPlay(EEndPlayReason::Type EndPlayReason)
@@ -57,9 +61,177 @@ void AShooterProjectile::EndPlay(EEndPlayReason::Type EndPlayReason)
 
 	// clear the destruction timer
 	GetWorld()->GetTimerManager().ClearTimer(DestructionTimer);
+
+	// leave the batched simulation
+	if (SimulationIndex != INDEX_NONE)
+	{
+		if (UShooterProjectileSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UShooterProjectileSimulationSubsystem>())
+		{
+			Simulation->RemoveProjectile(this);
+		}
+	}
+
+	// if we were destroyed while handed out by the pool, let it know we won't come back
+	if (bPooled && bActiveFromPool && EndPlayReason == EEndPlayReason::Destroyed)
+	{
+		if (UShooterProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>())
+		{
+			Pool->NotifyProjectileDestroyed(this);
+		}
+	}
+}
+
+void AShooterProjectile::OnAcquiredFromPool(const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bInCosmeticOnly)
+{
+	bActiveFromPool = true;
+	bCosmeticOnly = bInCosmeticOnly;
+
+	// reset the hit state
+	bHit = false;
+
+	// take on the new owner and instigator
+	SetOwner(NewOwner);
+	SetInstigator(NewInstigator);
+
+	// teleport to the spawn transform
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+
+	// ignore the pawn that shot this projectile
+	CollisionComponent->ClearMoveIgnoreActors();
+
+	if (NewInstigator)
+	{
+		CollisionComponent->IgnoreActorWhenMoving(NewInstigator, true);
+	}
+
+	// restore visibility
+	SetActorHiddenInGame(false);
+	SetActorTickEnabled(true);
+
+	// restart the projectile movement along the new facing
+	ProjectileMovement->Velocity = SpawnTransform.GetRotation().GetForwardVector() * ProjectileMovement->InitialSpeed;
+	LaunchProjectile();
+
+	// pass control to BP to restart any effects
+	BP_OnProjectileActivated();
+}
+
+void AShooterProjectile::OnReturnedToPool()
+{
+	bActiveFromPool = false;
+
+	// cancel any pending destruction
+	GetWorld()->GetTimerManager().ClearTimer(DestructionTimer);
+
+	// stop moving
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+
+	if (SimulationIndex != INDEX_NONE)
+	{
+		if (UShooterProjectileSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UShooterProjectileSimulationSubsystem>())
+		{
+			Simulation->RemoveProjectile(this);
+		}
+	}
+
+	// hide the projectile and disable collision
+	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetActorHiddenInGame(true);
+	SetActorTickEnabled(false);
+
+	// drop the references to the last shooter
+	SetOwner(nullptr);
+	SetInstigator(nullptr);
+
+	// pass control to BP to stop any effects
+	BP_OnProjectileReturnedToPool();
+}
+
+void AShooterProjectile::LaunchProjectile()
+{
+	// move the projectile in the batched simulation
+	if (bUseBatchedSimulation)
+	{
+		if (UShooterProjectileSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UShooterProjectileSimulationSubsystem>())
+		{
+			// capture the collision and movement settings
+			FShooterProjectileSimParams SimParams;
+			SimParams.Radius = CollisionComponent->GetScaledSphereRadius();
+			SimParams.GravityZ = ProjectileMovement->ProjectileGravityScale * GetWorld()->GetGravityZ();
+			SimParams.Lifetime = MaxFlightTime;
+			SimParams.Bounciness = ProjectileMovement->Bounciness;
+			SimParams.Friction = ProjectileMovement->Friction;
+			SimParams.StopSpeed = ProjectileMovement->BounceVelocityStopSimulatingThreshold;
+			SimParams.MaxBounces = MaxSimulatedBounces;
+			SimParams.Channel = CollisionComponent->GetCollisionObjectType();
+			SimParams.Responses = FCollisionResponseParams(CollisionComponent->GetCollisionResponseToChannels());
+			SimParams.bShouldBounce = ProjectileMovement->bShouldBounce;
+			SimParams.bRotationFollowsVelocity = ProjectileMovement->bRotationFollowsVelocity;
+
+			const FVector LaunchVelocity = ProjectileMovement->Velocity;
+
+			// the simulation sweeps for us, so the components can stay idle
+			ProjectileMovement->Deactivate();
+			CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+			// the first step catches up on the time since the shot was fired
+			Simulation->AddProjectile(this, LaunchVelocity, SimParams, LaunchAge, LaunchRewindTime);
+			LaunchAge = 0.0f;
+			LaunchRewindTime = -1.0;
+			return;
+		}
+	}
+
+	// move with the projectile movement component
+	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+
+	ProjectileMovement->SetUpdatedComponent(CollisionComponent);
+	ProjectileMovement->Activate(true);
+	ProjectileMovement->UpdateComponentVelocity();
+
+	// catch up on the time since the shot was fired. The sweep still reports anything in the way
+	if (LaunchAge > 0.0f)
+	{
+		const FVector CatchUpOffset = ProjectileMovement->Velocity * LaunchAge;
+
+		// that part of the flight happened in the past, so test it against the characters as they were then
+		const UShooterLagCompensationSubsystem* LagCompensation = LaunchRewindTime >= 0.0 ? GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>() : nullptr;
+		FHitResult RewoundHit;
+
+		if (LagCompensation && LagCompensation->TraceRewound(GetActorLocation(), GetActorLocation() + CatchUpOffset, LaunchRewindTime, GetInstigator(), RewoundHit))
+		{
+			SetActorLocation(RewoundHit.Location);
+			HandleProjectileHit(RewoundHit.GetActor(), RewoundHit.GetComponent(), RewoundHit);
+
+		} else {
+
+			AddActorWorldOffset(CatchUpOffset, true);
+
+		}
+	}
+
+	LaunchAge = 0.0f;
+	LaunchRewindTime = -1.0;
 }
 
 void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit)
+{
+	HandleProjectileHit(Other, OtherComp, Hit);
+}
+
+void AShooterProjectile::HandleSimulatedHit(const FHitResult& Hit)
+{
+	HandleProjectileHit(Hit.GetActor(), Hit.GetComponent(), Hit);
+}
+
+void AShooterProjectile::OnSimulationExpired()
+{
+	// release the projectile without a hit
+	ReleaseProjectile();
+}
+
+void AShooterProjectile::HandleProjectileHit(AActor* Other, UPrimitiveComponent* OtherComp, const FHitResult& Hit)
 {
 	// ignore if we've already hit something else
 	if (bHit)
@@ -72,20 +244,24 @@ void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Ot
 	// disable collision on the projectile
 	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 
-	// make AI perception noise
-	MakeNoise(NoiseLoudness, GetInstigator(), GetActorLocation(), NoiseRange, NoiseTag);
-
-	if (bExplodeOnHit)
+	// cosmetic projectiles only play effects. The authoritative projectile deals the damage
+	if (!bCosmeticOnly)
 	{
-		
-		// apply explosion damage centered on the projectile
-		ExplosionCheck(GetActorLocation());
+		// make AI perception noise
+		MakeNoise(NoiseLoudness, GetInstigator(), GetActorLocation(), NoiseRange, NoiseTag);
 
-	} else {
+		if (bExplodeOnHit)
+		{
+			
+			// apply explosion damage centered on the projectile
+			ExplosionCheck(GetActorLocation());
+
+		} else {
 
-		// single hit projectile. Process the collided actor
-		ProcessHit(Other, OtherComp, Hit.ImpactPoint, -Hit.ImpactNormal);
+			// single hit projectile. Process the collided actor
+			ProcessHit(Other, OtherComp, Hit.ImpactPoint, -Hit.ImpactNormal);
 
+		}
 	}
 
 	// pass control to BP for any extra effects
@@ -98,100 +274,70 @@ void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Ot
 
 	} else {
 
-		// destroy the projectile right away
-		Destroy();
+		// release the projectile right away
+		ReleaseProjectile();
 	}
 }
 
 void AShooterProjectile::ExplosionCheck(const FVector& ExplosionCenter)
 {
-	// do a sphere overlap check look for nearby actors to damage
-	TArray<FOverlapResult> Overlaps;
-
-	FCollisionShape OverlapShape;
-	OverlapShape.SetSphere(ExplosionRadius);
+	UShooterExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<UShooterExplosionSubsystem>();
 
-	FCollisionObjectQueryParams ObjectParams;
-	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
-	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
-	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
-
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
-	if (!bDamageOwner)
+	if (!Explosions)
 	{
-		QueryParams.AddIgnoredActor(GetInstigator());
+		return;
 	}
 
-	GetWorld()->OverlapMultiByObjectType(Overlaps, ExplosionCenter, FQuat::Identity, ObjectParams, OverlapShape, QueryParams);
-
-	TArray<AActor*> DamagedActors;
+	FShooterExplosionParams ExplosionParams;
+	ExplosionParams.Radius = ExplosionRadius;
+	ExplosionParams.bFalloff = bExplosionFalloff;
+	ExplosionParams.InnerRadius = ExplosionInnerRadius;
+	ExplosionParams.FalloffExponent = ExplosionFalloffExponent;
+	ExplosionParams.MinDamageScale = ExplosionMinDamageScale;
+	ExplosionParams.bOcclusion = bExplosionOcclusion;
+
+	// the explosion resolves on a later frame, so hand it a copy of the hit settings
+	// this lets the projectile go back to the pool right away
+	Explosions->QueueExplosion(ExplosionCenter, ExplosionParams, MakeHitParams());
+}
 
-	// process the overlap results
-	for (const FOverlapResult& CurrentOverlap : Overlaps)
-	{
-		// overlaps may return the same actor multiple times per each component overlapped
-		// ensure we only damage each actor once by adding it to a damaged list
-		if (DamagedActors.Find(CurrentOverlap.GetActor()) == INDEX_NONE)
-		{
-			DamagedActors.Add(CurrentOverlap.GetActor());
+void AShooterProjectile::ProcessHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection)
+{
+	// damage and score the hit through the shared hit path
+	MakeHitParams().ApplyHit(HitActor, HitComp, HitLocation, HitDirection);
+}
 
-			// apply physics force away from the explosion
-			const FVector& ExplosionDir = CurrentOverlap.GetActor()->GetActorLocation() - GetActorLocation();
+FShooterHitParams AShooterProjectile::MakeHitParams()
+{
+	FShooterHitParams HitParams;
+	HitParams.Damage = HitDamage;
+	HitParams.DamageType = HitDamageType;
+	HitParams.PhysicsForce = PhysicsForce;
+	HitParams.bDamageOwner = bDamageOwner;
+	HitParams.Owner = GetOwner();
+	HitParams.Instigator = GetInstigator();
+	HitParams.Causer = this;
+
+	return HitParams;
+}
 
-			// push and/or damage the overlapped actor
-			ProcessHit(CurrentOverlap.GetActor(), CurrentOverlap.GetComponent(), GetActorLocation(), ExplosionDir.GetSafeNormal());
-		}
-			
-	}
+void AShooterProjectile::OnDeferredDestruction()
+{
+	// release this projectile
+	ReleaseProjectile();
 }
 
-void AShooterProjectile::ProcessHit(AActor* HitActor, UPrimitiveComponent* HitComp, const FVector& HitLocation, const FVector& HitDirection)
+void AShooterProjectile::ReleaseProjectile()
 {
-	// have we hit a character?
-	if (ACharacter* HitCharacter = Cast<ACharacter>(HitActor))
+	// pooled projectiles go back to the pool so they can be reused
+	if (bPooled)
 	{
-		// ignore the owner of this projectile
-		if (HitCharacter != GetOwner() || bDamageOwner)
+		if (UShooterProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>())
 		{
-			// apply damage to the character
-			UGameplayStatics::ApplyDamage(HitCharacter, HitDamage, GetInstigator()->GetController(), this, HitDamageType);
-
-			// scoring logic: player <-> enemy hits
-			if (AShooterGameMode* GM = Cast<AShooterGameMode>(GetWorld()->GetAuthGameMode()))
-			{
-				APawn* InstigatorPawn = GetInstigator();
-
-				AShooterCharacter* PlayerInstigator = Cast<AShooterCharacter>(InstigatorPawn);
-				AShooterNPC* EnemyInstigator = Cast<AShooterNPC>(InstigatorPawn);
-
-				AShooterCharacter* PlayerTarget = Cast<AShooterCharacter>(HitCharacter);
-				AShooterNPC* EnemyTarget = Cast<AShooterNPC>(HitCharacter);
-
-				// player hits an enemy: +10
-				if (PlayerInstigator && EnemyTarget)
-				{
-					GM->AddScore(10);
-				}
-				// enemy hits the player: -15
-				else if (EnemyInstigator && PlayerTarget)
-				{
-					GM->AddScore(-15);
-				}
-			}
+			Pool->ReleaseProjectile(this);
+			return;
 		}
 	}
 
-	// have we hit a physics object?
-	if (HitComp->IsSimulatingPhysics())
-	{
-		// give some physics impulse to the object
-		HitComp->AddImpulseAtLocation(HitDirection * PhysicsForce, HitLocation);
-	}
-}
-
-void AShooterProjectile::OnDeferredDestruction()
-{
-	// destroy this actor
 	Destroy();
 }
@@ -10,6 +10,8 @@ class USphereComponent;
 class UProjectileMovementComponent;
 class ACharacter;
 class UPrimitiveComponent;
+class APawn;
+struct FShooterHitParams;
 
 /**
  *  Simple projectile class for a first person shooter game
@@ -65,6 +67,26 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Projectile|Explosion", meta = (ClampMin = 0, ClampMax = 5000, Units = "cm"))
 	float ExplosionRadius = 500.0f;	
 
+	/** If true, explosion damage falls off between the inner radius and the explosion radius. Otherwise every actor in range takes full damage */
+	UPROPERTY(EditAnywhere, Category="Projectile|Explosion")
+	bool bExplosionFalloff = false;
+
+	/** Actors within this distance of the explosion take full damage */
+	UPROPERTY(EditAnywhere, Category="Projectile|Explosion", meta = (EditCondition = "bExplosionFalloff", ClampMin = 0, ClampMax = 5000, Units = "cm"))
+	float ExplosionInnerRadius = 100.0f;
+
+	/** Exponent of the explosion damage falloff between the inner radius and the explosion radius */
+	UPROPERTY(EditAnywhere, Category="Projectile|Explosion", meta = (EditCondition = "bExplosionFalloff", ClampMin = 0, ClampMax = 10))
+	float ExplosionFalloffExponent = 1.0f;
+
+	/** Fraction of the explosion damage still applied at the edge of the explosion radius */
+	UPROPERTY(EditAnywhere, Category="Projectile|Explosion", meta = (EditCondition = "bExplosionFalloff", ClampMin = 0, ClampMax = 1))
+	float ExplosionMinDamageScale = 0.0f;
+
+	/** If true, actors behind blocking geometry are shielded from the explosion */
+	UPROPERTY(EditAnywhere, Category="Projectile|Explosion")
+	bool bExplosionOcclusion = false;
+
 	/** If true, this projectile has already hit another surface */
 	bool bHit = false;
 
@@ -75,11 +97,74 @@ protected:
 	/** Timer to handle deferred destruction of this projectile */
 	FTimerHandle DestructionTimer;
 
+	/** If true, this projectile belongs to the projectile pool and is returned to it instead of being destroyed */
+	bool bPooled = false;
+
+	/** If true, this pooled projectile is currently handed out by the pool */
+	bool bActiveFromPool = false;
+
+	/** If true, this is a local copy of a shot fired on another machine and only plays effects */
+	bool bCosmeticOnly = false;
+
+	/** If true, the server moves this projectile through the batched projectile simulation instead of its movement component */
+	UPROPERTY(EditAnywhere, Category="Projectile|Simulation")
+	bool bUseBatchedSimulation = true;
+
+	/** Max time the projectile can fly without hitting anything before it's released */
+	UPROPERTY(EditAnywhere, Category="Projectile|Simulation", meta = (ClampMin = 0, ClampMax = 60, Units = "s"))
+	float MaxFlightTime = 10.0f;
+
+	/** Max number of bounces simulated after the first hit */
+	UPROPERTY(EditAnywhere, Category="Projectile|Simulation", meta = (ClampMin = 0, ClampMax = 10))
+	int32 MaxSimulatedBounces = 3;
+
+	/** Index of this projectile in the batched simulation, or INDEX_NONE if it's not being simulated */
+	int32 SimulationIndex = INDEX_NONE;
+
+	/** Time since the shot was fired. The projectile flies this far ahead when it's launched */
+	float LaunchAge = 0.0f;
+
+	/** Server time the first flight segment is tested against lag compensated characters at, or negative if it isn't */
+	double LaunchRewindTime = -1.0;
+
 public:	
 
 	/** Constructor */
 	AShooterProjectile();
 
+	/** Flags this projectile as owned by the projectile pool. Must be set before the projectile begins play */
+	void SetPooled(bool bInPooled) { bPooled = bInPooled; }
+
+	/** Returns true if this projectile is handed out by the projectile pool, as opposed to parked in it */
+	bool IsActiveFromPool() const { return bActiveFromPool; }
+
+	/** Flags this projectile as a cosmetic-only copy. Must be set before the projectile begins play */
+	void SetCosmeticOnly(bool bInCosmeticOnly) { bCosmeticOnly = bInCosmeticOnly; }
+
+	/** Sets how long ago the shot was fired, and the rewind time for its first flight segment. Must be set before the projectile is launched */
+	void SetLaunchTime(float InLaunchAge, double InRewindTime = -1.0) { LaunchAge = FMath::Max(InLaunchAge, 0.0f); LaunchRewindTime = InRewindTime; }
+
+	/** Resets and launches this projectile when it's handed out by the projectile pool */
+	void OnAcquiredFromPool(const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bInCosmeticOnly);
+
+	/** Deactivates and hides this projectile when it's returned to the projectile pool */
+	void OnReturnedToPool();
+
+	/** Returns the index of this projectile in the batched simulation */
+	int32 GetSimulationIndex() const { return SimulationIndex; }
+
+	/** Sets the index of this projectile in the batched simulation */
+	void SetSimulationIndex(int32 NewIndex) { SimulationIndex = NewIndex; }
+
+	/** Returns true if this projectile has already hit something */
+	bool HasHit() const { return bHit; }
+
+	/** Handles a blocking hit found by the batched simulation */
+	void HandleSimulatedHit(const FHitResult& Hit);
+
+	/** Called by the batched simulation when this projectile runs out of flight time */
+	void OnSimulationExpired();
+
 protected:
 	
 	/** Gameplay initialization */
@@ -91,9 +176,20 @@ protected:
 	/** Handles collision */
 	virtual void NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
 
+public:
+
+	/** Builds the damage and scoring settings for this projectile's hits */
+	FShooterHitParams MakeHitParams();
+
 protected:
 
-	/** Looks up actors within the explosion radius and damages them */
+	/** Hands the projectile over to the batched simulation, or starts its movement component */
+	void LaunchProjectile();
+
+	/** Processes the first hit of this projectile */
+	void HandleProjectileHit(AActor* Other, UPrimitiveComponent* OtherComp, const FHitResult& Hit);
+
+	/** Queues an explosion that damages all actors within the explosion radius */
 	void ExplosionCheck(const FVector& ExplosionCenter);
 
 	/** Processes a projectile hit for the given actor */
@@ -103,7 +199,18 @@ protected:
 	UFUNCTION(BlueprintImplementableEvent, Category="Projectile", meta = (DisplayName = "On Projectile Hit"))
 	void BP_OnProjectileHit(const FHitResult& Hit);
 
+	/** Passes control to Blueprint to restart any effects when this projectile is launched from the pool */
+	UFUNCTION(BlueprintImplementableEvent, Category="Projectile", meta = (DisplayName = "On Projectile Activated"))
+	void BP_OnProjectileActivated();
+
+	/** Passes control to Blueprint to stop any effects when this projectile is returned to the pool */
+	UFUNCTION(BlueprintImplementableEvent, Category="Projectile", meta = (DisplayName = "On Projectile Returned To Pool"))
+	void BP_OnProjectileReturnedToPool();
+
 	/** Called from the destruction timer to destroy this projectile */
 	void OnDeferredDestruction();
 
+	/** Returns this projectile to the pool, or destroys it if it wasn't pooled */
+	void ReleaseProjectile();
+
 };
@@ -0,0 +1,195 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterProjectilePool.h"
+#include "ShooterProjectile.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Pool Hits"), STAT_ShooterProjectilePoolHits, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Pool Misses"), STAT_ShooterProjectilePoolMisses, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Projectiles Active"), STAT_ShooterProjectilePoolActive, STATGROUP_Shooter);
+
+static FAutoConsoleCommandWithWorld ShooterProjectilePoolStatsCommand(
+	TEXT("Shooter.ProjectilePool.Stats"),
+	TEXT("Logs the hit, miss and high-water counters of the projectile pool for the current world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterProjectilePoolSubsystem* Pool = World ? World->GetSubsystem<UShooterProjectilePoolSubsystem>() : nullptr)
+		{
+			Pool->LogPoolStats();
+		}
+	})
+);
+
+void UShooterProjectilePoolSubsystem::Deinitialize()
+{
+	// report the final counters so the pool can be sized for this map
+	LogPoolStats();
+
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UShooterProjectilePoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterProjectilePoolSubsystem::Prewarm(TSubclassOf<AShooterProjectile> ProjectileClass, int32 Count)
+{
+	if (!ProjectileClass)
+	{
+		return;
+	}
+
+	FShooterProjectilePoolEntry& Entry = Pools.FindOrAdd(ProjectileClass);
+
+	// only spawn the projectiles we're missing. Weapons sharing a projectile class share the pool
+	const int32 NumToSpawn = Count - (Entry.FreeProjectiles.Num() + Entry.NumActive);
+
+	for (int32 i = 0; i < NumToSpawn; ++i)
+	{
+		if (AShooterProjectile* Projectile = SpawnPooledProjectile(ProjectileClass))
+		{
+			Entry.FreeProjectiles.Add(Projectile);
+		}
+	}
+}
+
+AShooterProjectile* UShooterProjectilePoolSubsystem::AcquireProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bCosmeticOnly, float LaunchAge, double RewindTime)
+{
+	if (!ProjectileClass)
+	{
+		return nullptr;
+	}
+
+	FShooterProjectilePoolEntry& Entry = Pools.FindOrAdd(ProjectileClass);
+
+	// pop the free list until we find a projectile that is still alive
+	AShooterProjectile* Projectile = nullptr;
+
+	while (!Projectile && Entry.FreeProjectiles.Num() > 0)
+	{
+		AShooterProjectile* Candidate = Entry.FreeProjectiles.Pop(EAllowShrinking::No);
+
+		if (IsValid(Candidate))
+		{
+			Projectile = Candidate;
+		}
+	}
+
+	if (Projectile)
+	{
+		++Entry.Hits;
+		INC_DWORD_STAT(STAT_ShooterProjectilePoolHits);
+
+	} else {
+
+		// the pool ran dry, so grow it
+		++Entry.Misses;
+		INC_DWORD_STAT(STAT_ShooterProjectilePoolMisses);
+
+		Projectile = SpawnPooledProjectile(ProjectileClass);
+
+		if (!Projectile)
+		{
+			return nullptr;
+		}
+	}
+
+	// update the usage counters
+	++Entry.NumActive;
+	Entry.HighWater = FMath::Max(Entry.HighWater, Entry.NumActive);
+	INC_DWORD_STAT(STAT_ShooterProjectilePoolActive);
+
+	// launch the projectile
+	Projectile->SetLaunchTime(LaunchAge, RewindTime);
+	Projectile->OnAcquiredFromPool(SpawnTransform, NewOwner, NewInstigator, bCosmeticOnly);
+
+	return Projectile;
+}
+
+void UShooterProjectilePoolSubsystem::ReleaseProjectile(AShooterProjectile* Projectile)
+{
+	if (!IsValid(Projectile))
+	{
+		return;
+	}
+
+	// a projectile that is already parked is on the free list. Adding it again would hand it out twice
+	if (!ensureMsgf(Projectile->IsActiveFromPool(), TEXT("Projectile %s was released to the pool twice"), *Projectile->GetName()))
+	{
+		return;
+	}
+
+	// deactivate the projectile
+	Projectile->OnReturnedToPool();
+
+	// add it back to the free list
+	FShooterProjectilePoolEntry& Entry = Pools.FindOrAdd(Projectile->GetClass());
+	Entry.FreeProjectiles.Add(Projectile);
+
+	Entry.NumActive = FMath::Max(0, Entry.NumActive - 1);
+	DEC_DWORD_STAT(STAT_ShooterProjectilePoolActive);
+}
+
+void UShooterProjectilePoolSubsystem::NotifyProjectileDestroyed(AShooterProjectile* Projectile)
+{
+	if (FShooterProjectilePoolEntry* Entry = Pools.Find(Projectile->GetClass()))
+	{
+		// the projectile will never be released, so stop counting it as active
+		Entry->NumActive = FMath::Max(0, Entry->NumActive - 1);
+		DEC_DWORD_STAT(STAT_ShooterProjectilePoolActive);
+	}
+}
+
+void UShooterProjectilePoolSubsystem::GetPoolStats(TSubclassOf<AShooterProjectile> ProjectileClass, int32& OutHits, int32& OutMisses, int32& OutHighWater, int32& OutActive, int32& OutFree) const
+{
+	OutHits = OutMisses = OutHighWater = OutActive = OutFree = 0;
+
+	if (const FShooterProjectilePoolEntry* Entry = Pools.Find(ProjectileClass))
+	{
+		OutHits = Entry->Hits;
+		OutMisses = Entry->Misses;
+		OutHighWater = Entry->HighWater;
+		OutActive = Entry->NumActive;
+		OutFree = Entry->FreeProjectiles.Num();
+	}
+}
+
+void UShooterProjectilePoolSubsystem::LogPoolStats() const
+{
+	for (const TPair<TObjectPtr<UClass>, FShooterProjectilePoolEntry>& Pair : Pools)
+	{
+		const FShooterProjectilePoolEntry& Entry = Pair.Value;
+
+		UE_LOG(LogFPS251106, Log, TEXT("Projectile pool [%s] in %s: Hits %d, Misses %d, High-water %d, Active %d, Free %d"),
+			*GetNameSafe(Pair.Key), *GetNameSafe(GetWorld()), Entry.Hits, Entry.Misses, Entry.HighWater, Entry.NumActive, Entry.FreeProjectiles.Num());
+	}
+}
+
+AShooterProjectile* UShooterProjectilePoolSubsystem::SpawnPooledProjectile(TSubclassOf<AShooterProjectile> ProjectileClass)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.TransformScaleMethod = ESpawnActorScaleMethod::OverrideRootScale;
+	SpawnParams.bDeferConstruction = true;
+
+	AShooterProjectile* Projectile = GetWorld()->SpawnActor<AShooterProjectile>(ProjectileClass, FTransform::Identity, SpawnParams);
+
+	if (Projectile)
+	{
+		// flag the projectile before it begins play, so it releases itself back to us instead of being destroyed,
+		// and doesn't launch from where it was spawned
+		Projectile->SetPooled(true);
+		Projectile->FinishSpawning(FTransform::Identity);
+
+		// park it until it's needed
+		Projectile->OnReturnedToPool();
+	}
+
+	return Projectile;
+}
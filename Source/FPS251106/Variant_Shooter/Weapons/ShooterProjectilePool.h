@@ -0,0 +1,92 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterProjectilePool.generated.h"
+
+class AShooterProjectile;
+class APawn;
+
+/**
+ *  Holds the pooled instances and usage counters for a single projectile class
+ */
+USTRUCT()
+struct FShooterProjectilePoolEntry
+{
+	GENERATED_BODY()
+
+	/** Inactive projectiles ready to be handed out */
+	UPROPERTY()
+	TArray<TObjectPtr<AShooterProjectile>> FreeProjectiles;
+
+	/** Number of projectiles currently handed out */
+	int32 NumActive = 0;
+
+	/** Number of requests served from the free list */
+	int32 Hits = 0;
+
+	/** Number of requests that had to spawn a new projectile */
+	int32 Misses = 0;
+
+	/** Highest number of projectiles handed out at the same time */
+	int32 HighWater = 0;
+};
+
+/**
+ *  World subsystem that recycles shooter projectiles instead of spawning and destroying them on every shot
+ *  Keeps a free list per projectile class, pre-warmed by the weapons that use them
+ *  Tracks hit, miss and high-water counters so the pool can be sized per map
+ */
+UCLASS()
+class FPS251106_API UShooterProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Pools by projectile class */
+	UPROPERTY()
+	TMap<TObjectPtr<UClass>, FShooterProjectilePoolEntry> Pools;
+
+public:
+
+	/** Subsystem cleanup */
+	virtual void Deinitialize() override;
+
+protected:
+
+	/** Only create the pool for game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Ensures at least Count projectiles of the given class exist in the pool */
+	void Prewarm(TSubclassOf<AShooterProjectile> ProjectileClass, int32 Count);
+
+	/**
+	 *  Hands out a projectile of the given class, spawning a new one if the pool is empty
+	 *  @param LaunchAge Time since the shot was fired
+	 *  @param RewindTime Server time the first flight segment is tested against lag compensated characters at, or negative
+	 */
+	AShooterProjectile* AcquireProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bCosmeticOnly = false, float LaunchAge = 0.0f, double RewindTime = -1.0);
+
+	/** Returns a projectile to its pool */
+	void ReleaseProjectile(AShooterProjectile* Projectile);
+
+	/** Removes a pooled projectile that was destroyed while handed out */
+	void NotifyProjectileDestroyed(AShooterProjectile* Projectile);
+
+	/** Returns the usage counters for the given projectile class */
+	UFUNCTION(BlueprintPure, Category="Projectile Pool")
+	void GetPoolStats(TSubclassOf<AShooterProjectile> ProjectileClass, int32& OutHits, int32& OutMisses, int32& OutHighWater, int32& OutActive, int32& OutFree) const;
+
+	/** Writes the usage counters for every pooled class to the log */
+	void LogPoolStats() const;
+
+protected:
+
+	/** Spawns a new inactive projectile for the pool */
+	AShooterProjectile* SpawnPooledProjectile(TSubclassOf<AShooterProjectile> ProjectileClass);
+};
@@ -0,0 +1,321 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterProjectileSimulation.h"
+#include "ShooterProjectile.h"
+#include "Engine/World.h"
+#include "ShooterBatchedTrace.h"
+#include "ShooterLagCompensation.h"
+#include "FPS251106.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Simulation"), STAT_ShooterProjectileSimulation, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Projectile Sweeps"), STAT_ShooterProjectileSweeps, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Simulated Projectiles"), STAT_ShooterSimulatedProjectiles, STATGROUP_Shooter);
+
+void UShooterProjectileSimulationSubsystem::AddProjectile(AShooterProjectile* Projectile, const FVector& Velocity, const FShooterProjectileSimParams& SimParams, float FlightAge, double RewindTime)
+{
+	// ignore projectiles already in the simulation
+	if (!IsValid(Projectile) || Projectile->GetSimulationIndex() != INDEX_NONE)
+	{
+		return;
+	}
+
+	Projectile->SetSimulationIndex(Projectiles.Num());
+
+	Projectiles.Add(Projectile);
+	Positions.Add(Projectile->GetActorLocation());
+	Velocities.Add(Velocity);
+	GravityZ.Add(SimParams.GravityZ);
+	RemainingLifetimes.Add(SimParams.Lifetime);
+	CatchUpTimes.Add(FMath::Max(FlightAge, 0.0f));
+	RewindTimes.Add(RewindTime);
+	BounceCounts.Add(0);
+	Instigators.Add(Projectile->GetInstigator());
+	Params.Add(SimParams);
+}
+
+void UShooterProjectileSimulationSubsystem::RemoveProjectile(AShooterProjectile* Projectile)
+{
+	const int32 Index = Projectile->GetSimulationIndex();
+
+	if (Projectiles.IsValidIndex(Index) && Projectiles[Index] == Projectile)
+	{
+		MarkForRemoval(Index);
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Projectiles.Num() == 0 || DeltaTime <= 0.0f)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterProjectileSimulation);
+	INC_DWORD_STAT_BY(STAT_ShooterSimulatedProjectiles, Projectiles.Num());
+
+	bIsSimulating = true;
+
+	// move and sweep every projectile
+	SimulateProjectiles(DeltaTime);
+
+	// process hits and update the actors
+	ResolveProjectiles();
+
+	bIsSimulating = false;
+
+	// compact the arrays. Remove from the back so swapped elements are never pending themselves
+	if (PendingRemovals.Num() > 0)
+	{
+		PendingRemovals.Sort(TGreater<int32>());
+
+		int32 LastRemoved = INDEX_NONE;
+
+		for (const int32 Index : PendingRemovals)
+		{
+			if (Index != LastRemoved)
+			{
+				RemoveAtSwap(Index);
+				LastRemoved = Index;
+			}
+		}
+
+		PendingRemovals.Reset();
+	}
+}
+
+TStatId UShooterProjectileSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterProjectileSimulationSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterProjectileSimulationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterProjectileSimulationSubsystem::SimulateProjectiles(float DeltaTime)
+{
+	const int32 NumProjectiles = Projectiles.Num();
+
+	TargetPositions.SetNumUninitialized(NumProjectiles, EAllowShrinking::No);
+	SweepBlocked.SetNumZeroed(NumProjectiles, EAllowShrinking::No);
+	SweepHits.SetNum(NumProjectiles, EAllowShrinking::No);
+	IgnoredActors.SetNumUninitialized(NumProjectiles, EAllowShrinking::No);
+
+	// integrate all projectiles in a single pass over the hot arrays
+	for (int32 i = 0; i < NumProjectiles; ++i)
+	{
+		// newly added projectiles also cover the time they were already flying for
+		const float StepTime = DeltaTime + CatchUpTimes[i];
+		CatchUpTimes[i] = 0.0f;
+
+		Velocities[i].Z += GravityZ[i] * StepTime;
+		TargetPositions[i] = Positions[i] + Velocities[i] * StepTime;
+		RemainingLifetimes[i] -= StepTime;
+	}
+
+	// resolve the weak pointers on the game thread before going wide
+	for (int32 i = 0; i < NumProjectiles; ++i)
+	{
+		IgnoredActors[i] = Instigators[i].Get();
+	}
+
+	const UWorld* World = GetWorld();
+
+	// gather the lag compensated characters on the game thread
+	RewoundActors.Reset();
+
+	if (const UShooterLagCompensationSubsystem* LagCompensation = World->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		RewoundActors.Append(LagCompensation->GetTrackedActors());
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterProjectileSweeps);
+
+	// sweep every projectile along its step
+	ShooterBatchedTrace::ForEachQuery(NumProjectiles, [this, World](int32 i)
+	{
+		const FShooterProjectileSimParams& SimParams = Params[i];
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ShooterProjectileSweep), false, Projectiles[i]);
+
+		if (IgnoredActors[i])
+		{
+			QueryParams.AddIgnoredActor(IgnoredActors[i]);
+		}
+
+		// rewound steps only sweep the world here. The characters are tested at their rewound location later
+		if (RewindTimes[i] >= 0.0)
+		{
+			QueryParams.AddIgnoredActors(RewoundActors);
+		}
+
+		SweepBlocked[i] = World->SweepSingleByChannel(SweepHits[i], Positions[i], TargetPositions[i], FQuat::Identity, SimParams.Channel, FCollisionShape::MakeSphere(SimParams.Radius), QueryParams, SimParams.Responses) ? 1 : 0;
+
+	});
+}
+
+void UShooterProjectileSimulationSubsystem::ResolveProjectiles()
+{
+	const UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>();
+
+	// only resolve the projectiles that were swept this frame. Hit handlers may add new ones
+	const int32 NumProjectiles = TargetPositions.Num();
+
+	for (int32 i = 0; i < NumProjectiles; ++i)
+	{
+		AShooterProjectile* Projectile = Projectiles[i];
+
+		// drop projectiles that were destroyed behind our back
+		if (!IsValid(Projectile))
+		{
+			MarkForRemoval(i);
+			continue;
+		}
+
+		// skip projectiles released during this frame
+		if (Projectile->GetSimulationIndex() != i)
+		{
+			continue;
+		}
+
+		const FShooterProjectileSimParams& SimParams = Params[i];
+
+		// test the rewound characters in front of whatever the sweep hit. Only the first step is rewound
+		if (RewindTimes[i] >= 0.0)
+		{
+			FHitResult RewoundHit;
+
+			if (LagCompensation && LagCompensation->TraceRewound(Positions[i], SweepBlocked[i] ? SweepHits[i].Location : TargetPositions[i], RewindTimes[i], IgnoredActors[i], RewoundHit))
+			{
+				SweepHits[i] = RewoundHit;
+				SweepBlocked[i] = 1;
+			}
+
+			RewindTimes[i] = -1.0;
+		}
+
+		if (SweepBlocked[i])
+		{
+			const FHitResult& Hit = SweepHits[i];
+
+			// move to the impact location
+			Positions[i] = Hit.Location;
+			Projectile->SetActorLocation(Hit.Location);
+
+			// only the first hit deals damage. Later hits are cosmetic bounces
+			if (!Projectile->HasHit())
+			{
+				Projectile->HandleSimulatedHit(Hit);
+
+				// the hit may have released the projectile
+				if (Projectile->GetSimulationIndex() != i)
+				{
+					continue;
+				}
+			}
+
+			// bounce off the surface
+			if (SimParams.bShouldBounce && BounceCounts[i] < SimParams.MaxBounces)
+			{
+				const FVector NormalVelocity = FVector::DotProduct(Velocities[i], Hit.ImpactNormal) * Hit.ImpactNormal;
+				const FVector TangentVelocity = Velocities[i] - NormalVelocity;
+
+				Velocities[i] = TangentVelocity * (1.0f - SimParams.Friction) - NormalVelocity * SimParams.Bounciness;
+
+				++BounceCounts[i];
+
+				// come to rest if we're too slow to keep bouncing
+				if (Velocities[i].SizeSquared() < FMath::Square(SimParams.StopSpeed))
+				{
+					MarkForRemoval(i);
+				}
+
+			} else {
+
+				// stop simulating. The projectile stays at the impact point until it's released
+				MarkForRemoval(i);
+			}
+
+		} else {
+
+			// advance to the end of the step
+			Positions[i] = TargetPositions[i];
+
+			if (SimParams.bRotationFollowsVelocity)
+			{
+				Projectile->SetActorLocationAndRotation(Positions[i], Velocities[i].Rotation());
+
+			} else {
+
+				Projectile->SetActorLocation(Positions[i]);
+
+			}
+
+			// release projectiles that flew for too long without hitting anything
+			if (RemainingLifetimes[i] <= 0.0f)
+			{
+				MarkForRemoval(i);
+
+				if (!Projectile->HasHit())
+				{
+					Projectile->OnSimulationExpired();
+				}
+			}
+		}
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::MarkForRemoval(int32 Index)
+{
+	// detach the actor right away so it can re-enter the simulation if it's relaunched
+	if (AShooterProjectile* Projectile = Projectiles[Index])
+	{
+		if (Projectile->GetSimulationIndex() == Index)
+		{
+			Projectile->SetSimulationIndex(INDEX_NONE);
+		}
+	}
+
+	if (bIsSimulating)
+	{
+		// the arrays are being iterated, so defer the compaction
+		PendingRemovals.Add(Index);
+
+	} else {
+
+		RemoveAtSwap(Index);
+
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::RemoveAtSwap(int32 Index)
+{
+	const int32 LastIndex = Projectiles.Num() - 1;
+
+	Projectiles.RemoveAtSwap(Index, EAllowShrinking::No);
+	Positions.RemoveAtSwap(Index, EAllowShrinking::No);
+	Velocities.RemoveAtSwap(Index, EAllowShrinking::No);
+	GravityZ.RemoveAtSwap(Index, EAllowShrinking::No);
+	RemainingLifetimes.RemoveAtSwap(Index, EAllowShrinking::No);
+	CatchUpTimes.RemoveAtSwap(Index, EAllowShrinking::No);
+	RewindTimes.RemoveAtSwap(Index, EAllowShrinking::No);
+	BounceCounts.RemoveAtSwap(Index, EAllowShrinking::No);
+	Instigators.RemoveAtSwap(Index, EAllowShrinking::No);
+	Params.RemoveAtSwap(Index, EAllowShrinking::No);
+
+	// fix up the index of the projectile we swapped in
+	if (Index != LastIndex)
+	{
+		if (AShooterProjectile* Moved = Projectiles[Index])
+		{
+			if (Moved->GetSimulationIndex() == LastIndex)
+			{
+				Moved->SetSimulationIndex(Index);
+			}
+		}
+	}
+}
@@ -0,0 +1,153 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CollisionQueryParams.h"
+#include "Engine/HitResult.h"
+#include "ShooterProjectileSimulation.generated.h"
+
+class AShooterProjectile;
+
+/**
+ *  Collision and bounce settings captured from a projectile when it enters the batched simulation
+ */
+struct FShooterProjectileSimParams
+{
+	/** Radius of the projectile sweep */
+	float Radius = 16.0f;
+
+	/** Vertical acceleration applied every step */
+	float GravityZ = 0.0f;
+
+	/** Time the projectile can fly without hitting anything before it's released */
+	float Lifetime = 10.0f;
+
+	/** Fraction of the normal velocity kept after a bounce */
+	float Bounciness = 0.6f;
+
+	/** Fraction of the tangential velocity lost on a bounce */
+	float Friction = 0.2f;
+
+	/** Speed under which a bouncing projectile comes to rest */
+	float StopSpeed = 5.0f;
+
+	/** Max number of cosmetic bounces after the first hit */
+	int32 MaxBounces = 3;
+
+	/** Collision channel to sweep on */
+	ECollisionChannel Channel = ECC_WorldDynamic;
+
+	/** Collision responses to sweep with */
+	FCollisionResponseParams Responses;
+
+	/** If true, the projectile bounces off surfaces after hitting */
+	bool bShouldBounce = true;
+
+	/** If true, the projectile actor is rotated to face its velocity */
+	bool bRotationFollowsVelocity = false;
+};
+
+/**
+ *  World subsystem that simulates all in-flight shooter projectiles in one pass
+ *  Keeps projectile state as structure-of-arrays, integrates it and sweeps every projectile as a single batch,
+ *  optionally across worker threads. Projectile actors are only moved to act as the visual representation,
+ *  and hits are handed back to them to run the usual damage and explosion logic.
+ */
+UCLASS()
+class FPS251106_API UShooterProjectileSimulationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Projectile actors acting as the visual representation and hit handlers of each simulated projectile */
+	UPROPERTY()
+	TArray<TObjectPtr<AShooterProjectile>> Projectiles;
+
+	/** Current world location of each projectile */
+	TArray<FVector> Positions;
+
+	/** Current velocity of each projectile */
+	TArray<FVector> Velocities;
+
+	/** Vertical acceleration of each projectile */
+	TArray<float> GravityZ;
+
+	/** Remaining flight time of each projectile */
+	TArray<float> RemainingLifetimes;
+
+	/** Flight time each projectile still has to catch up on. Added to its next step */
+	TArray<float> CatchUpTimes;
+
+	/** Server time the next step of each projectile is tested against lag compensated characters at, or negative if it isn't */
+	TArray<double> RewindTimes;
+
+	/** Number of bounces done by each projectile */
+	TArray<int32> BounceCounts;
+
+	/** Pawn that shot each projectile. Ignored by the sweeps */
+	TArray<TWeakObjectPtr<AActor>> Instigators;
+
+	/** Cold collision and bounce settings of each projectile */
+	TArray<FShooterProjectileSimParams> Params;
+
+	/** Per-frame scratch: sweep end locations */
+	TArray<FVector> TargetPositions;
+
+	/** Per-frame scratch: sweep results */
+	TArray<FHitResult> SweepHits;
+
+	/** Per-frame scratch: non-zero if the sweep found a blocking hit */
+	TArray<uint8> SweepBlocked;
+
+	/** Per-frame scratch: resolved instigators to ignore in the sweeps */
+	TArray<const AActor*> IgnoredActors;
+
+	/** Per-frame scratch: lag compensated characters, left out of rewound sweeps */
+	TArray<AActor*> RewoundActors;
+
+	/** Indices removed while the simulation was running. Compacted at the end of the frame */
+	TArray<int32> PendingRemovals;
+
+	/** If true, we're in the middle of a simulation step */
+	bool bIsSimulating = false;
+
+public:
+
+	/**
+	 *  Adds a projectile to the simulation
+	 *  @param FlightAge Time the projectile has already been flying for. Its first step covers it, so shots fired within one frame stay spaced apart
+	 *  @param RewindTime Server time the first step is tested against lag compensated characters at. Negative to test them where they are
+	 */
+	void AddProjectile(AShooterProjectile* Projectile, const FVector& Velocity, const FShooterProjectileSimParams& SimParams, float FlightAge = 0.0f, double RewindTime = -1.0);
+
+	/** Removes a projectile from the simulation */
+	void RemoveProjectile(AShooterProjectile* Projectile);
+
+	/** Returns the number of projectiles currently in flight */
+	int32 GetNumProjectiles() const { return Projectiles.Num(); }
+
+	//~Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	//~End FTickableGameObject interface
+
+protected:
+
+	/** Only simulate projectiles in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/** Integrates all projectiles and sweeps them as one batch */
+	void SimulateProjectiles(float DeltaTime);
+
+	/** Hands blocking hits back to the projectiles and updates the visual actors */
+	void ResolveProjectiles();
+
+	/** Flags a projectile for removal, or removes it right away if we're not simulating */
+	void MarkForRemoval(int32 Index);
+
+	/** Removes the projectile at the given index by swapping the last one into its place */
+	void RemoveAtSwap(int32 Index);
+};
@@ -5,20 +5,113 @@
 #include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "ShooterProjectile.h"
+#include "ShooterProjectilePool.h"
+#include "ShooterHitscan.h"
+#include "ShooterCharacter.h"
+#include "Variant_Shooter/AI/ShooterNPC.h"
+#include "ShooterLagCompensation.h"
 #include "ShooterWeaponHolder.h"
 #include "Components/SceneComponent.h"
 #include "TimerManager.h"
 #include "Animation/AnimInstance.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "EngineUtils.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "HAL/IConsoleManager.h"
+#include "FPS251106.h"
 #include "GameFramework/Pawn.h"
+#include "GameFramework/GameStateBase.h"
+
+/** Adds up the component count, rendered and ticking components and memory of a weapon */
+static void AccumulateWeaponCost(const AShooterWeapon* Weapon, int32& OutComponents, int32& OutSkeletalMeshes, int32& OutRendered, int32& OutTicking, SIZE_T& OutBytes)
+{
+	TInlineComponentArray<UActorComponent*> Components(Weapon);
+
+	for (UActorComponent* Component : Components)
+	{
+		++OutComponents;
+
+		if (Component->IsA<USkeletalMeshComponent>())
+		{
+			++OutSkeletalMeshes;
+		}
+
+		const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+
+		if (Primitive && Primitive->SceneProxy)
+		{
+			++OutRendered;
+		}
+
+		if (Component->IsComponentTickEnabled())
+		{
+			++OutTicking;
+		}
+
+		// count the component object itself and the render resources it owns
+		FArchiveCountMem CountMem(Component);
+		OutBytes += CountMem.GetMax() + Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	}
+}
+
+static FAutoConsoleCommandWithWorld ShooterWeaponCostReportCommand(
+	TEXT("Shooter.Weapons.CostReport"),
+	TEXT("Logs the average component count, rendered and ticking components and memory of full and third person only weapons in the current world. Toggle Shooter.Weapons.NPCThirdPersonOnly to compare"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		// index 0 is full weapons, index 1 is third person only weapons
+		int32 Weapons[2] = {};
+		int32 Components[2] = {};
+		int32 SkeletalMeshes[2] = {};
+		int32 Rendered[2] = {};
+		int32 Ticking[2] = {};
+		SIZE_T Bytes[2] = {};
+
+		for (TActorIterator<AShooterWeapon> It(World); It; ++It)
+		{
+			const int32 Mode = It->IsThirdPersonOnly() ? 1 : 0;
+
+			++Weapons[Mode];
+			AccumulateWeaponCost(*It, Components[Mode], SkeletalMeshes[Mode], Rendered[Mode], Ticking[Mode], Bytes[Mode]);
+		}
+
+		const TCHAR* ModeNames[2] = { TEXT("Full"), TEXT("Third person only") };
+
+		for (int32 Mode = 0; Mode < 2; ++Mode)
+		{
+			if (Weapons[Mode] == 0)
+			{
+				continue;
+			}
+
+			UE_LOG(LogFPS251106, Log, TEXT("%s weapons: %d. Per weapon: %.1f components, %.1f skeletal meshes, %.1f rendered, %.1f ticking components, %.1f KB"),
+				ModeNames[Mode], Weapons[Mode],
+				static_cast<float>(Components[Mode]) / Weapons[Mode],
+				static_cast<float>(SkeletalMeshes[Mode]) / Weapons[Mode],
+				static_cast<float>(Rendered[Mode]) / Weapons[Mode],
+				static_cast<float>(Ticking[Mode]) / Weapons[Mode],
+				static_cast<float>(Bytes[Mode]) / Weapons[Mode] / 1024.0f);
+		}
+	})
+);
 
 AShooterWeapon::AShooterWeapon()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
-	// Enable replication
-	bReplicates = true;
-	SetReplicateMovement(true);
+	// the weapon only ticks to run the fire scheduler while firing full auto
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	// weapons are spawned locally on every machine by their owners, so they don't replicate
+	// shots are replicated as compact fire events through the owner instead
+	bReplicates = false;
 
 	// create the root
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
@@ -54,8 +147,24 @@ void AShooterWeapon::BeginPlay()
 	// fill the first ammo clip
 	CurrentBullets = MagazineSize;
 
+	// seed the spread from the owner's replicated seed so every machine's copy of this weapon agrees on it,
+	// mixed with the class name so an owner's weapons don't share a pattern
+	SpreadSeed = HashCombineFast(WeaponOwner->GetWeaponSeed(), FCrc::StrCrc32(*GetClass()->GetName()));
+
 	// attach the meshes to the owner
 	WeaponOwner->AttachWeaponMeshes(this);
+
+	// tick after the owner so the muzzle has its final location for the frame
+	AddTickPrerequisiteActor(GetOwner());
+
+	// pre-warm the projectile pool so the first shots don't spawn actors
+	if (FireMode == EShooterFireMode::Projectile)
+	{
+		if (UShooterProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>())
+		{
+			Pool->Prewarm(ProjectileClass, ProjectilePoolSize);
+		}
+	}
 }
 
 void AShooterWeapon::EndPlay(EEndPlayReason::Type EndPlayReason)
@@ -96,6 +205,14 @@ void AShooterWeapon::DeactivateWeapon()
 	WeaponOwner->OnWeaponDeactivated(this);
 }
 
+void AShooterWeapon::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// fire any full auto shots that came due during this frame
+	UpdateFireScheduler();
+}
+
 void AShooterWeapon::StartFiring()
 {
 	// don't allow firing while reloading
@@ -107,21 +224,22 @@ void AShooterWeapon::StartFiring()
 	// raise the firing flag
 	bIsFiring = true;
 
-	// check how much time has passed since we last shot
-	// this may be under the refire rate if the weapon shoots slow enough and the player is spamming the trigger
-	const float TimeSinceLastShot = GetWorld()->GetTimeSeconds() - TimeOfLastShot;
+	// check when the weapon is ready to fire again
+	// this may be in the future if the weapon shoots slow enough and the player is spamming the trigger
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double ReadyTime = TimeOfLastShot + RefireRate;
 
-	if (TimeSinceLastShot > RefireRate)
+	if (Now >= ReadyTime)
 	{
 		// fire the weapon right away
 		Fire();
 
 	} else {
 
-		// if we're full auto, schedule the next shot
+		// if we're full auto, start firing once the remaining cooldown has passed
 		if (bFullAuto)
 		{
-			GetWorld()->GetTimerManager().SetTimer(RefireTimer, this, &AShooterWeapon::Fire, TimeSinceLastShot, false);
+			StartFireScheduler(ReadyTime, GetMuzzleLocation(), WeaponOwner->GetWeaponTargetLocation());
 		}
 
 	}
@@ -134,6 +252,9 @@ void AShooterWeapon::StopFiring()
 
 	// clear the refire timer
 	GetWorld()->GetTimerManager().ClearTimer(RefireTimer);
+
+	// stop the fire scheduler
+	SetActorTickEnabled(false);
 }
 
 void AShooterWeapon::Fire()
@@ -157,20 +278,21 @@ void AShooterWeapon::Fire()
 		return;
 	}
 	
-	// fire a projectile at the target
-	FireProjectile(WeaponOwner->GetWeaponTargetLocation());
+	// fire at the target from the current muzzle location
+	const FVector MuzzleLocation = GetMuzzleLocation();
+	const FVector TargetLocation = WeaponOwner->GetWeaponTargetLocation();
 
-	// update the time of our last shot
-	TimeOfLastShot = GetWorld()->GetTimeSeconds();
-
-	// make noise so the AI perception system can hear us
-	MakeNoise(ShotLoudness, PawnOwner, PawnOwner->GetActorLocation(), ShotNoiseRange, ShotNoiseTag);
+	FireShotFrom(MuzzleLocation, TargetLocation, 0.0f);
 
 	// are we full auto?
 	if (bFullAuto)
 	{
 		// schedule the next shot
-		GetWorld()->GetTimerManager().SetTimer(RefireTimer, this, &AShooterWeapon::Fire, RefireRate, false);
+		if (bIsFiring)
+		{
+			StartFireScheduler(TimeOfLastShot + RefireRate, MuzzleLocation, TargetLocation);
+		}
+
 	} else {
 
 		// for semi-auto weapons, schedule the cooldown notification
@@ -179,26 +301,405 @@ void AShooterWeapon::Fire()
 	}
 }
 
+void AShooterWeapon::FireShotFrom(const FVector& MuzzleLocation, const FVector& TargetLocation, float ShotAge)
+{
+	// fire at the target
+	FireShot(MakeFireEvent(MuzzleLocation, TargetLocation, ShotAge));
+
+	// update the time of our last shot
+	TimeOfLastShot = GetWorld()->GetTimeSeconds() - ShotAge;
+
+	// make noise so the AI perception system can hear us
+	MakeNoise(ShotLoudness, PawnOwner, PawnOwner->GetActorLocation(), ShotNoiseRange, ShotNoiseTag);
+}
+
+void AShooterWeapon::StartFireScheduler(double FirstShotTime, const FVector& MuzzleLocation, const FVector& TargetLocation)
+{
+	NextShotTime = FirstShotTime;
+
+	// start interpolating from the current frame
+	LastFrameTime = GetWorld()->GetTimeSeconds();
+	LastMuzzleLocation = MuzzleLocation;
+	LastTargetLocation = TargetLocation;
+
+	SetActorTickEnabled(true);
+}
+
+void AShooterWeapon::UpdateFireScheduler()
+{
+	// stop the scheduler if we're no longer firing full auto
+	if (!bIsFiring || !bFullAuto)
+	{
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// nothing to do until the next shot is due. Keep the interpolation frame current
+	// so the next shot doesn't blend from a stale aim point
+	if (NextShotTime > Now)
+	{
+		LastFrameTime = Now;
+		LastMuzzleLocation = GetMuzzleLocation();
+		LastTargetLocation = WeaponOwner->GetWeaponTargetLocation();
+		return;
+	}
+
+	const FVector MuzzleLocation = GetMuzzleLocation();
+	const FVector TargetLocation = WeaponOwner->GetWeaponTargetLocation();
+
+	const double FrameLength = Now - LastFrameTime;
+	int32 ShotsThisFrame = 0;
+
+	// fire every shot that came due since the last frame, each at its exact time within the frame
+	while (bIsFiring && NextShotTime <= Now)
+	{
+		// drop the backlog after a long hitch instead of firing a burst
+		if (ShotsThisFrame >= MaxShotsPerFrame)
+		{
+			NextShotTime = Now;
+			break;
+		}
+
+		// don't fire if reloading
+		if (bIsReloading)
+		{
+			break;
+		}
+
+		// don't fire if out of ammo
+		if (CurrentBullets <= 0)
+		{
+			StopFiring();
+			break;
+		}
+
+		// interpolate the muzzle and aim between the last frame and this one
+		const float Alpha = FrameLength > 0.0 ? FMath::Clamp(static_cast<float>((NextShotTime - LastFrameTime) / FrameLength), 0.0f, 1.0f) : 1.0f;
+
+		const FVector ShotMuzzleLocation = FMath::Lerp(LastMuzzleLocation, MuzzleLocation, Alpha);
+		const FVector ShotTargetLocation = FMath::Lerp(LastTargetLocation, TargetLocation, Alpha);
+
+		FireShotFrom(ShotMuzzleLocation, ShotTargetLocation, static_cast<float>(Now - NextShotTime));
+
+		// advance by exactly one refire interval so the fire rate doesn't drift with the frame rate
+		NextShotTime += FMath::Max(RefireRate, UE_KINDA_SMALL_NUMBER);
+		++ShotsThisFrame;
+	}
+
+	LastFrameTime = Now;
+	LastMuzzleLocation = MuzzleLocation;
+	LastTargetLocation = TargetLocation;
+}
+
 void AShooterWeapon::FireCooldownExpired()
 {
 	// notify the owner
 	WeaponOwner->OnSemiWeaponRefire();
 }
 
-void AShooterWeapon::FireProjectile(const FVector& TargetLocation)
+FShooterFireEvent AShooterWeapon::MakeFireEvent(const FVector& MuzzleLocation, const FVector& TargetLocation, float ShotAge)
+{
+	// get the shot transform
+	const FTransform ShotTransform = CalculateProjectileSpawnTransform(MuzzleLocation, TargetLocation);
+
+	// only the aim direction is sent. The spread is rebuilt from the shot index wherever the shot is fired
+	FShooterFireEvent FireEvent;
+	FireEvent.Origin = ShotTransform.GetLocation();
+	FireEvent.Direction = ShotTransform.GetRotation().GetForwardVector();
+	FireEvent.ShotIndex = NextShotIndex++;
+	FireEvent.WeaponIndex = static_cast<uint8>(FMath::Clamp(WeaponOwner->GetWeaponIndex(this), 0, MAX_uint8));
+
+	// stamp the shot with our best estimate of the server time
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	FireEvent.Timestamp = (GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) - ShotAge;
+
+	return FireEvent;
+}
+
+FVector AShooterWeapon::GetSpreadDirection(const FShooterFireEvent& FireEvent) const
+{
+	if (AimVariance <= 0.0f)
+	{
+		return FireEvent.Direction;
+	}
+
+	// pick a direction within the variance cone from the shot's own stream
+	const FRandomStream SpreadStream = MakeShotRandomStream(FireEvent.ShotIndex);
+
+	return SpreadStream.VRandCone(FireEvent.Direction, FMath::DegreesToRadians(AimVariance));
+}
+
+FShooterHitParams AShooterWeapon::GetShotHitParams() const
+{
+	FShooterHitParams HitParams = HitscanHitParams;
+
+	// projectile weapons deal the damage of their projectile class
+	if (FireMode == EShooterFireMode::Projectile && ProjectileClass)
+	{
+		HitParams = ProjectileClass->GetDefaultObject<AShooterProjectile>()->MakeHitParams();
+	}
+
+	HitParams.Owner = nullptr;
+	HitParams.Instigator = nullptr;
+	HitParams.Causer = nullptr;
+
+	return HitParams;
+}
+
+FRandomStream AShooterWeapon::MakeShotRandomStream(uint16 ShotIndex, uint32 Salt) const
+{
+	return FRandomStream(static_cast<int32>(HashCombineFast(HashCombineFast(SpreadSeed, ShotIndex), Salt)));
+}
+
+void AShooterWeapon::FireShot(const FShooterFireEvent& FireEvent)
+{
+	if (GetNetMode() == NM_Client)
+	{
+		// show the shot right away, and let the server fire the authoritative one
+		FireFromEvent(FireEvent, true);
+
+		if (AShooterCharacter* ShooterOwner = Cast<AShooterCharacter>(PawnOwner))
+		{
+			ShooterOwner->ServerFire(FireEvent);
+		}
+
+	} else {
+
+		// fire the authoritative shot and show it to everyone else
+		FireFromEvent(FireEvent, false);
+		BroadcastFireEvent(FireEvent);
+
+	}
+
+	// play the firing feedback and consume the bullet
+	OnShotFired();
+}
+
+void AShooterWeapon::FireFromEvent(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime)
+{
+	// apply the seeded spread, so the cosmetic and authoritative shots fly the same way
+	FShooterFireEvent ShotEvent = FireEvent;
+	ShotEvent.Direction = GetSpreadDirection(FireEvent);
+
+	if (FireMode == EShooterFireMode::Hitscan)
+	{
+		FireHitscan(ShotEvent, bCosmeticOnly, RewindTime);
+
+	} else {
+
+		FireProjectile(ShotEvent, bCosmeticOnly, RewindTime);
+
+	}
+}
+
+void AShooterWeapon::FireProjectile(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime)
 {
 	// get the projectile transform
-	FTransform ProjectileTransform = CalculateProjectileSpawnTransform(TargetLocation);
+	const FTransform ProjectileTransform(FVector(FireEvent.Direction).Rotation(), FireEvent.Origin, FVector::OneVector);
+
+	// shots fired within one frame launch together, so fly each one as far as it got since it was due
+	const float LaunchAge = GetFireEventAge(FireEvent);
 	
-	// spawn the projectile
-	FActorSpawnParameters SpawnParams;
-	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-	SpawnParams.TransformScaleMethod = ESpawnActorScaleMethod::OverrideRootScale;
-	SpawnParams.Owner = GetOwner();
-	SpawnParams.Instigator = PawnOwner;
+	// get a projectile from the pool
+	if (UShooterProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>())
+	{
+		Pool->AcquireProjectile(ProjectileClass, ProjectileTransform, GetOwner(), PawnOwner, bCosmeticOnly, LaunchAge, RewindTime);
+
+	} else {
+
+		// no pool available, so spawn the projectile directly
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.TransformScaleMethod = ESpawnActorScaleMethod::OverrideRootScale;
+		SpawnParams.Owner = GetOwner();
+		SpawnParams.Instigator = PawnOwner;
+		SpawnParams.bDeferConstruction = true;
+
+		if (AShooterProjectile* Projectile = GetWorld()->SpawnActor<AShooterProjectile>(ProjectileClass, ProjectileTransform, SpawnParams))
+		{
+			Projectile->SetCosmeticOnly(bCosmeticOnly);
+			Projectile->SetLaunchTime(LaunchAge, RewindTime);
+			Projectile->FinishSpawning(ProjectileTransform);
+		}
+	}
+}
+
+void AShooterWeapon::FireHitscan(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime)
+{
+	// trace along the shot, which already includes the aim variance
+	const FVector TraceStart = FireEvent.Origin;
+	const FVector TraceEnd = TraceStart + FVector(FireEvent.Direction) * HitscanRange;
+
+	// queue the trace so it's resolved together with every other shot fired this frame
+	if (UShooterHitscanSubsystem* Hitscan = GetWorld()->GetSubsystem<UShooterHitscanSubsystem>())
+	{
+		FShooterHitParams HitParams = HitscanHitParams;
+		HitParams.Owner = GetOwner();
+		HitParams.Instigator = PawnOwner;
+		HitParams.Causer = this;
+
+		Hitscan->QueueTrace(this, TraceStart, TraceEnd, HitscanTraceChannel, HitParams, RewindTime, bCosmeticOnly);
+	}
+}
+
+void AShooterWeapon::BroadcastFireEvent(const FShooterFireEvent& FireEvent)
+{
+	// nobody to tell in standalone games
+	if (GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	// weapons are spawned locally on every machine, so the event goes through the replicated owner
+	if (AShooterCharacter* ShooterOwner = Cast<AShooterCharacter>(PawnOwner))
+	{
+		ShooterOwner->MulticastFireEvent(FireEvent);
+
+	} else if (AShooterNPC* NPCOwner = Cast<AShooterNPC>(PawnOwner)) {
+
+		NPCOwner->MulticastFireEvent(FireEvent);
+
+	}
+}
+
+void AShooterWeapon::HandleClientFireEvent(const FShooterFireEvent& ClientFireEvent)
+{
+	// the client picks its own timestamps, so keep them within the window we'd rewind to
+	FShooterFireEvent FireEvent = ClientFireEvent;
+	FireEvent.Timestamp = ClampClientTimestamp(ClientFireEvent.Timestamp);
+
+	if (!ValidateClientFireEvent(FireEvent) || !ConsumeClientShotToken() || !CheckClientAmmo())
+	{
+		return;
+	}
+
+	// the shot is accepted, so its seed can't be used again
+	NextClientShotIndex = FireEvent.ShotIndex + 1;
+	LastClientShotTimestamp = FireEvent.Timestamp;
+
+	// spend the bullet on our copy of the weapon. The client plays its own firing feedback
+	--CurrentBullets;
+
+	// rewind the targets to the time the client fired, if we're compensating for lag.
+	// Hitscan shots are traced against the past, projectiles only for the flight they catch up on
+	double RewindTime = -1.0;
+
+	if (const UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		if (LagCompensation->IsLagCompensationActive())
+		{
+			RewindTime = LagCompensation->GetRewindTime(FireEvent.Timestamp, PawnOwner);
+		}
+	}
+
+	// fire the authoritative shot and show it to the other clients
+	FireFromEvent(FireEvent, false, RewindTime);
+	BroadcastFireEvent(FireEvent);
+}
+
+bool AShooterWeapon::ValidateClientFireEvent(const FShooterFireEvent& FireEvent) const
+{
+	if (!PawnOwner)
+	{
+		return false;
+	}
+
+	// reject shots fired from too far away from where we have the shooter
+	if (FVector::DistSquared(FireEvent.Origin, PawnOwner->GetPawnViewLocation()) > FMath::Square(MaxClientShotOriginError))
+	{
+		return false;
+	}
+
+	// shot indices only move forward, so a client can't replay the seed of a shot with favorable spread
+	if (static_cast<int16>(FireEvent.ShotIndex - NextClientShotIndex) < 0)
+	{
+		return false;
+	}
+
+	// reject shots fired faster than the refire rate allows
+	if (LastClientShotTimestamp >= 0.0f && FireEvent.Timestamp - LastClientShotTimestamp < RefireRate * (1.0f - ClientRefireTolerance))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+float AShooterWeapon::GetFireEventAge(const FShooterFireEvent& FireEvent) const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const double Now = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+
+	// events from other machines also carry the trip here. Never catch up on more than we'd rewind
+	return static_cast<float>(FMath::Clamp(Now - FireEvent.Timestamp, 0.0, UShooterLagCompensationSubsystem::GetMaxRewindTime()));
+}
 
-	AShooterProjectile* Projectile = GetWorld()->SpawnActor<AShooterProjectile>(ProjectileClass, ProjectileTransform, SpawnParams);
+float AShooterWeapon::ClampClientTimestamp(float Timestamp) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	return static_cast<float>(FMath::Clamp(static_cast<double>(Timestamp), Now - UShooterLagCompensationSubsystem::GetMaxRewindTime(), Now + ClientTimestampTolerance));
+}
+
+bool AShooterWeapon::ConsumeClientShotToken()
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// timestamps only prove the spacing the client claims, so also limit the rate by when the shots actually reach us
+	if (ClientShotTokenTime < 0.0)
+	{
+		ClientShotTokens = ClientFireBurst;
+
+	} else {
+
+		ClientShotTokens = FMath::Min(ClientFireBurst, ClientShotTokens + static_cast<float>((Now - ClientShotTokenTime) / FMath::Max(RefireRate, UE_KINDA_SMALL_NUMBER)));
+
+	}
+
+	ClientShotTokenTime = Now;
+
+	if (ClientShotTokens < 1.0f)
+	{
+		return false;
+	}
+
+	ClientShotTokens -= 1.0f;
+	return true;
+}
+
+bool AShooterWeapon::CheckClientAmmo()
+{
+	// the client's reload started on the server one trip later, so let a shot finish it if it's nearly done
+	if (bIsReloading)
+	{
+		if (GetWorld()->GetTimerManager().GetTimerRemaining(ReloadTimer) > ClientReloadTolerance)
+		{
+			return false;
+		}
+
+		GetWorld()->GetTimerManager().ClearTimer(ReloadTimer);
+		OnReloadComplete();
+	}
+
+	return CurrentBullets > 0;
+}
+
+void AShooterWeapon::HandleRemoteFireEvent(const FShooterFireEvent& FireEvent)
+{
+	// rebuild the shot for effects only
+	FireFromEvent(FireEvent, true);
+}
+
+void AShooterWeapon::OnHitscanResolved(const FVector& TraceStart, const FVector& TraceEnd, const FHitResult& Hit, bool bBlockingHit)
+{
+	// pass control to BP to play any tracer or impact effects
+	BP_OnHitscanResolved(TraceStart, TraceEnd, Hit, bBlockingHit);
+}
 
+void AShooterWeapon::OnShotFired()
+{
 	// play the firing montage
 	WeaponOwner->PlayFiringMontage(FiringMontage);
 
@@ -219,16 +720,74 @@ void AShooterWeapon::FireProjectile(const FVector& TargetLocation)
 	}
 }
 
-FTransform AShooterWeapon::CalculateProjectileSpawnTransform(const FVector& TargetLocation) const
+FVector AShooterWeapon::GetMuzzleLocation() const
+{
+	// third person only weapons fire from their world representation
+	if (bThirdPersonOnly)
+	{
+		const USceneComponent* ThirdPersonComponent = GetThirdPersonComponent();
+		return ThirdPersonComponent ? ThirdPersonComponent->GetSocketLocation(MuzzleSocketName) : GetActorLocation();
+	}
+
+	return FirstPersonMesh->GetSocketLocation(MuzzleSocketName);
+}
+
+USceneComponent* AShooterWeapon::GetThirdPersonComponent() const
+{
+	if (ThirdPersonStaticMeshComponent)
+	{
+		return ThirdPersonStaticMeshComponent;
+	}
+
+	return ThirdPersonMesh;
+}
+
+void AShooterWeapon::SetThirdPersonOnly()
+{
+	// components are registered when the weapon finishes spawning, so swapping them after that would be too late
+	if (!ensure(!HasActorBegunPlay()) || bThirdPersonOnly)
+	{
+		return;
+	}
+
+	bThirdPersonOnly = true;
+
+	// nobody will ever see the first person mesh. Keep the component so the mesh getters stay valid,
+	// but without a scene proxy or a pose tick it costs next to nothing
+	DisableMeshComponent(FirstPersonMesh);
+
+	// swap the skeletal mesh for a static one if we have it
+	if (ThirdPersonStaticMesh)
+	{
+		ThirdPersonStaticMeshComponent = NewObject<UStaticMeshComponent>(this, TEXT("Third Person Static Mesh"));
+		ThirdPersonStaticMeshComponent->SetupAttachment(RootComponent);
+		ThirdPersonStaticMeshComponent->SetStaticMesh(ThirdPersonStaticMesh);
+		ThirdPersonStaticMeshComponent->SetCollisionProfileName(FName("NoCollision"));
+		ThirdPersonStaticMeshComponent->SetMobility(EComponentMobility::Movable);
+		AddInstanceComponent(ThirdPersonStaticMeshComponent);
+
+		DisableMeshComponent(ThirdPersonMesh);
+	}
+}
+
+void AShooterWeapon::DisableMeshComponent(USkeletalMeshComponent* MeshComponent)
 {
-	// find the muzzle location
-	const FVector MuzzleLoc = FirstPersonMesh->GetSocketLocation(MuzzleSocketName);
+	// invisible primitives aren't added to the scene
+	MeshComponent->SetVisibility(false);
+
+	// never evaluate the pose, even if something turns the tick back on
+	MeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+	MeshComponent->PrimaryComponentTick.bStartWithTickEnabled = false;
+	MeshComponent->SetComponentTickEnabled(false);
+}
 
+FTransform AShooterWeapon::CalculateProjectileSpawnTransform(const FVector& MuzzleLoc, const FVector& TargetLocation) const
+{
 	// calculate the spawn location ahead of the muzzle
 	const FVector SpawnLoc = MuzzleLoc + ((TargetLocation - MuzzleLoc).GetSafeNormal() * MuzzleOffset);
 
-	// find the aim rotation vector while applying some variance to the target 
-	const FRotator AimRot = UKismetMathLibrary::FindLookAtRotation(SpawnLoc, TargetLocation + (UKismetMathLibrary::RandomUnitVector() * AimVariance));
+	// find the aim rotation vector. The variance is applied later from the shot's seed
+	const FRotator AimRot = UKismetMathLibrary::FindLookAtRotation(SpawnLoc, TargetLocation);
 
 	// return the built transform
 	return FTransform(AimRot, SpawnLoc, FVector::OneVector);
@@ -271,6 +830,18 @@ void AShooterWeapon::StartReload()
 	GetWorld()->GetTimerManager().SetTimer(ReloadTimer, this, &AShooterWeapon::OnReloadComplete, ReloadDuration, false);
 }
 
+void AShooterWeapon::ResetWeapon()
+{
+	// stop the trigger and the fire scheduler
+	StopFiring();
+
+	// cancel any reload in progress
+	GetWorld()->GetTimerManager().ClearTimer(ReloadTimer);
+
+	// fill the magazine and update the HUD
+	OnReloadComplete();
+}
+
 void AShooterWeapon::OnReloadComplete()
 {
 	// Fill the magazine
@@ -6,14 +6,28 @@
 #include "GameFramework/Actor.h"
 #include "ShooterWeaponHolder.h"
 #include "Animation/AnimInstance.h"
+#include "ShooterHitParams.h"
+#include "ShooterFireEvent.h"
 #include "ShooterWeapon.generated.h"
 
 class IShooterWeaponHolder;
 class AShooterProjectile;
 class USkeletalMeshComponent;
+class UStaticMeshComponent;
+class UStaticMesh;
 class UAnimMontage;
 class UAnimInstance;
 
+/**
+ *  How a weapon resolves its shots
+ */
+UENUM(BlueprintType)
+enum class EShooterFireMode : uint8
+{
+	Projectile	UMETA(DisplayName = "Projectile"),
+	Hitscan		UMETA(DisplayName = "Hitscan")
+};
+
 /**
  *  Base class for a simple first person shooter weapon
  *  Provides both first person and third person perspective meshes
@@ -33,15 +47,59 @@ class FPS251106_API AShooterWeapon : public AActor
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
 	USkeletalMeshComponent* ThirdPersonMesh;
 
+	/** Static third person mesh used instead of the skeletal meshes in third person only mode */
+	UPROPERTY(Transient)
+	TObjectPtr<UStaticMeshComponent> ThirdPersonStaticMeshComponent;
+
 protected:
 
 	/** Cast pointer to the weapon owner */
 	IShooterWeaponHolder* WeaponOwner;
 
+	/** Determines if this weapon shoots physical projectiles or resolves its shots with a trace */
+	UPROPERTY(EditAnywhere, Category="Ammo")
+	EShooterFireMode FireMode = EShooterFireMode::Projectile;
+
 	/** Type of projectiles this weapon will shoot */
 	UPROPERTY(EditAnywhere, Category="Ammo")
 	TSubclassOf<AShooterProjectile> ProjectileClass;
 
+	/** Number of projectiles of this weapon's class to pre-warm in the projectile pool */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0, ClampMax = 500))
+	int32 ProjectilePoolSize = 20;
+
+	/** Max range of hitscan shots */
+	UPROPERTY(EditAnywhere, Category="Ammo|Hitscan", meta = (ClampMin = 0, ClampMax = 100000, Units = "cm"))
+	float HitscanRange = 10000.0f;
+
+	/** Collision channel hitscan shots are traced on */
+	UPROPERTY(EditAnywhere, Category="Ammo|Hitscan")
+	TEnumAsByte<ECollisionChannel> HitscanTraceChannel = ECC_Visibility;
+
+	/** Damage settings for hitscan shots */
+	UPROPERTY(EditAnywhere, Category="Ammo|Hitscan")
+	FShooterHitParams HitscanHitParams;
+
+	/** Fraction of the refire rate a client's shots may be early by before they're rejected, to absorb timestamp jitter */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0, ClampMax = 1))
+	float ClientRefireTolerance = 0.5f;
+
+	/** Number of a client's shots the server accepts back to back when they arrive bunched up by network jitter. Refilled at one shot per RefireRate of server time */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 1, ClampMax = 16))
+	float ClientFireBurst = 4.0f;
+
+	/** How far ahead of the server clock a client's shot timestamp may be, to absorb the error of its server time estimate */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0, ClampMax = 1, Units = "s"))
+	float ClientTimestampTolerance = 0.05f;
+
+	/** Time left on the server's reload of a client's weapon under which a shot from that client finishes the reload early, to absorb latency jitter */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0, ClampMax = 1, Units = "s"))
+	float ClientReloadTolerance = 0.2f;
+
+	/** Max distance between a client's reported shot origin and the shooter's server location before the shot is rejected */
+	UPROPERTY(EditAnywhere, Category="Ammo|Hitscan", meta = (ClampMin = 0, ClampMax = 1000, Units = "cm"))
+	float MaxClientShotOriginError = 250.0f;
+
 	/** Number of bullets in a magazine */
 	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0, ClampMax = 100))
 	int32 MagazineSize = 10;
@@ -69,6 +127,13 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Aim", meta = (ClampMin = 0, ClampMax = 100))
 	float FiringRecoil = 0.0f;
 
+	/** Optional static mesh to represent the weapon in third person only mode. Must have the muzzle socket */
+	UPROPERTY(EditAnywhere, Category="Third Person")
+	TObjectPtr<UStaticMesh> ThirdPersonStaticMesh;
+
+	/** If true, the weapon's first person mesh is disabled and it fires from its third person representation */
+	bool bThirdPersonOnly = false;
+
 	/** Name of the first person muzzle socket where projectiles will spawn */
 	UPROPERTY(EditAnywhere, Category="Aim")
 	FName MuzzleSocketName;
@@ -85,8 +150,42 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Refire", meta = (ClampMin = 0, ClampMax = 5, Units = "s"))
 	float RefireRate = 0.5f;
 
+	/** Max number of full auto shots fired in a single frame. Any backlog past this after a hitch is dropped */
+	UPROPERTY(EditAnywhere, Category="Refire", meta = (ClampMin = 1, ClampMax = 32))
+	int32 MaxShotsPerFrame = 8;
+
 	/** Game time of last shot fired, used to enforce refire rate on semi auto */
-	float TimeOfLastShot = 0.0f;
+	double TimeOfLastShot = 0.0;
+
+	/** Game time the next full auto shot is due at */
+	double NextShotTime = 0.0;
+
+	/** Game time of the last fire scheduler update */
+	double LastFrameTime = 0.0;
+
+	/** Muzzle location at the last fire scheduler update */
+	FVector LastMuzzleLocation = FVector::ZeroVector;
+
+	/** Aim target location at the last fire scheduler update */
+	FVector LastTargetLocation = FVector::ZeroVector;
+
+	/** Seed shared by every machine's copy of this weapon, from the owner's weapon seed. Combined with the shot index to seed each shot's spread */
+	uint32 SpreadSeed = 0;
+
+	/** Index of the next shot fired locally */
+	uint16 NextShotIndex = 0;
+
+	/** Index of the next shot expected from the owning client. Used to reject replayed seeds on the server */
+	uint16 NextClientShotIndex = 0;
+
+	/** Timestamp of the last shot accepted from the owning client */
+	float LastClientShotTimestamp = -1.0f;
+
+	/** Shots the owning client may still fire back to back. Refilled over server time */
+	float ClientShotTokens = 0.0f;
+
+	/** Server time the client shot tokens were last refilled at, or negative before the first shot */
+	double ClientShotTokenTime = -1.0;
 
 	/** If true, the weapon is currently firing */
 	bool bIsFiring = false;
@@ -128,6 +227,11 @@ protected:
 	/** Gameplay Cleanup */
 	virtual void EndPlay(EEndPlayReason::Type EndPlayReason) override;
 
+public:
+
+	/** Runs the fire scheduler */
+	virtual void Tick(float DeltaTime) override;
+
 protected:
 
 	/** Called when the weapon's owner is destroyed */
@@ -156,11 +260,82 @@ protected:
 	/** Called when the refire rate time has passed while shooting semi auto weapons */
 	void FireCooldownExpired();
 
-	/** Fire a projectile towards the target location */
-	virtual void FireProjectile(const FVector& TargetLocation);
+	/** Fires a shot from the muzzle location towards the target. ShotAge is how long ago within this frame the shot was due */
+	void FireShotFrom(const FVector& MuzzleLocation, const FVector& TargetLocation, float ShotAge);
+
+	/** Starts ticking the full auto fire scheduler */
+	void StartFireScheduler(double FirstShotTime, const FVector& MuzzleLocation, const FVector& TargetLocation);
+
+	/** Fires every full auto shot that came due since the last frame */
+	void UpdateFireScheduler();
+
+	/** Builds the fire event for the next shot from the muzzle location towards the target */
+	FShooterFireEvent MakeFireEvent(const FVector& MuzzleLocation, const FVector& TargetLocation, float ShotAge);
+
+	/** Returns the direction of the shot after applying its seeded spread */
+	FVector GetSpreadDirection(const FShooterFireEvent& FireEvent) const;
 
-	/** Calculates the spawn transform for projectiles shot by this weapon */
-	FTransform CalculateProjectileSpawnTransform(const FVector& TargetLocation) const;
+	/** Returns true if a fire event sent by the owning client is plausible */
+	bool ValidateClientFireEvent(const FShooterFireEvent& FireEvent) const;
+
+	/** Limits a client's shot timestamp to the window between the max rewind time and slightly ahead of the server clock */
+	float ClampClientTimestamp(float Timestamp) const;
+
+	/** Spends one of the owning client's shot tokens, refilled by the time the shots reach the server. Returns false if none are left */
+	bool ConsumeClientShotToken();
+
+	/** Returns true if the server's copy of the weapon has a bullet for a client's shot, finishing a nearly done reload if needed */
+	bool CheckClientAmmo();
+
+	/** Fires a locally triggered shot, and replicates it to the server or the other clients */
+	void FireShot(const FShooterFireEvent& FireEvent);
+
+	/** Fires the shot described by the fire event with the current fire mode */
+	void FireFromEvent(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime = -1.0);
+
+	/** Returns the time since the shot was fired, by the server clock. Limited to the max rewind time */
+	float GetFireEventAge(const FShooterFireEvent& FireEvent) const;
+
+	/** Fire a projectile along the fire event. A non-negative rewind time tests its first flight segment against the lag compensated characters */
+	virtual void FireProjectile(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime = -1.0);
+
+	/** Queue a hitscan shot along the fire event */
+	virtual void FireHitscan(const FShooterFireEvent& FireEvent, bool bCosmeticOnly, double RewindTime);
+
+	/** Sends the fire event to the remote machines through the replicated owner */
+	void BroadcastFireEvent(const FShooterFireEvent& FireEvent);
+
+	/** Plays the firing feedback and consumes a bullet after a shot */
+	void OnShotFired();
+
+	/** Returns the current world location of the muzzle socket */
+	FVector GetMuzzleLocation() const;
+
+	/** Calculates the spawn transform for projectiles shot by this weapon from the given muzzle location, before spread */
+	FTransform CalculateProjectileSpawnTransform(const FVector& MuzzleLoc, const FVector& TargetLocation) const;
+
+public:
+
+	/** Returns a random stream for the given shot, identical on every machine. Salt decorrelates separate uses of the same shot */
+	FRandomStream MakeShotRandomStream(uint16 ShotIndex, uint32 Salt = 0) const;
+
+	/** Returns the index of the next shot this weapon will fire */
+	uint16 GetNextShotIndex() const { return NextShotIndex; }
+
+	/** Fires the authoritative shot for a fire event sent by the owning client */
+	void HandleClientFireEvent(const FShooterFireEvent& ClientFireEvent);
+
+	/** Plays a cosmetic-only shot for a fire event replicated from another machine */
+	void HandleRemoteFireEvent(const FShooterFireEvent& FireEvent);
+
+	/** Called by the hitscan subsystem once a shot fired by this weapon has been traced */
+	void OnHitscanResolved(const FVector& TraceStart, const FVector& TraceEnd, const FHitResult& Hit, bool bBlockingHit);
+
+protected:
+
+	/** Passes control to Blueprint to play tracer and impact effects for a resolved hitscan shot */
+	UFUNCTION(BlueprintImplementableEvent, Category="Weapon", meta = (DisplayName = "On Hitscan Resolved"))
+	void BP_OnHitscanResolved(const FVector& TraceStart, const FVector& TraceEnd, const FHitResult& Hit, bool bBlockingHit);
 
 public:
 
@@ -172,6 +347,26 @@ public:
 	UFUNCTION(BlueprintPure, Category="Weapon")
 	USkeletalMeshComponent* GetThirdPersonMesh() const { return ThirdPersonMesh; };
 
+	/** Returns the component the weapon is represented by in third person */
+	USceneComponent* GetThirdPersonComponent() const;
+
+	/** Returns true if the weapon's first person mesh is disabled */
+	bool IsThirdPersonOnly() const { return bThirdPersonOnly; }
+
+	/**
+	 *  Hides the first person mesh and stops its ticks, and swaps the third person skeletal mesh for ThirdPersonStaticMesh if set
+	 *  The skeletal mesh components are kept, so their getters never return null.
+	 *  For owners that never render a first person view, like NPCs. Must be called before the weapon finishes spawning
+	 */
+	void SetThirdPersonOnly();
+
+protected:
+
+	/** Hides a mesh component and stops it from ticking, before it's registered */
+	static void DisableMeshComponent(USkeletalMeshComponent* MeshComponent);
+
+public:
+
 	/** Returns the first person anim instance class */
 	const TSubclassOf<UAnimInstance>& GetFirstPersonAnimInstanceClass() const;
 
@@ -184,12 +379,30 @@ public:
 	/** Returns the current bullet count */
 	int32 GetBulletCount() const { return CurrentBullets; }
 
+	/** Returns the time between shots */
+	float GetRefireRate() const { return RefireRate; }
+
+	/** Returns the cone half-angle for variance while aiming */
+	float GetAimVariance() const { return AimVariance; }
+
+	/** Returns the max range of hitscan shots */
+	float GetHitscanRange() const { return HitscanRange; }
+
+	/** Returns the channel hitscan shots trace on */
+	ECollisionChannel GetHitscanTraceChannel() const { return HitscanTraceChannel; }
+
+	/** Returns the damage and scoring settings of a single shot for either fire mode, without an owner, instigator or causer */
+	FShooterHitParams GetShotHitParams() const;
+
 	/** Start reloading the weapon */
 	void StartReload();
 
 	/** Returns true if the weapon is currently reloading */
 	bool IsReloading() const { return bIsReloading; }
 
+	/** Stops firing, cancels any reload and refills the magazine. Used when the owner is recycled */
+	void ResetWeapon();
+
 protected:
 
 	/** Duration of reload in seconds */
@@ -52,4 +52,10 @@ public:
 
 	/** Notifies the owner that the weapon cooldown has expired and it's ready to shoot again */
 	virtual void OnSemiWeaponRefire() = 0;
+
+	/** Returns a seed every machine's copy of this owner agrees on. Weapons mix it into their spread */
+	virtual uint32 GetWeaponSeed() const = 0;
+
+	/** Returns the index of the weapon in the owner's weapon list, or INDEX_NONE if it doesn't own it */
+	virtual int32 GetWeaponIndex(const AShooterWeapon* Weapon) const = 0;
 };